@@ -0,0 +1,1124 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "app_config.h"
+
+#define CHECK_ERROR(error) \
+  if (error) { \
+    g_printerr ("Error while parsing config file: %s\n", error->message); \
+    goto done; \
+  }
+
+void
+app_config_set_defaults (AppConfig * config)
+{
+  memset (config, 0, sizeof (AppConfig));
+
+  config->streammux_control.enable = FALSE;
+  config->streammux_control.min_timeout_usec = 4000;
+  config->streammux_control.max_latency_usec = 100000;
+  config->streammux_control.jitter_factor = 2.0;
+  config->streammux_control.update_interval_msec = 1000;
+  config->streammux_control.report_interval_sec = 10;
+
+  config->sharding.enable = FALSE;
+  config->sharding.num_workers = 2;
+  config->sharding.ring_slots = 256;
+  config->sharding.max_restarts = 5;
+  config->sharding.restart_delay_msec = 500;
+  config->sharding.hang_timeout_msec = 30000;
+  config->sharding.startup_timeout_msec = 0;
+  config->sharding.synthetic = FALSE;
+  config->sharding.synthetic_fps = 30;
+  config->sharding.synthetic_frames = 300;
+  config->sharding.synthetic_objects = 20;
+  config->sharding.synthetic_crash_after = 0;
+  config->sharding.synthetic_hang_after = 0;
+
+  config->recorder.enable = FALSE;
+  config->recorder.file = g_strdup ("metadata_recording.bin");
+
+  config->replay.enable = FALSE;
+  config->replay.file = g_strdup ("metadata_recording.bin");
+  config->replay.realtime = FALSE;
+  config->replay.num_loops = 1;
+
+  config->trace.enable = FALSE;
+  config->trace.file = g_strdup ("pipeline_trace.json");
+  config->trace.max_events = 1 << 20;
+
+  config->track_log.enable = FALSE;
+  config->track_log.file = g_strdup ("track_log.txt");
+  config->track_log.position_threshold = 4.0;
+  config->track_log.confidence_threshold = 0.1;
+  config->track_log.max_missed_batches = 30;
+  config->track_log.keyframe_interval = 300;
+
+  config->global_tracking.enable = FALSE;
+  config->global_tracking.file = g_strdup ("global_tracks.txt");
+  config->global_tracking.gate_radius = 0.75;
+  config->global_tracking.max_age_msec = 1500;
+  config->global_tracking.velocity_smoothing = 0.3;
+  config->global_tracking.camera_height = 3.0;
+  config->global_tracking.num_camera_poses = 0;
+  config->global_tracking.camera_poses = NULL;
+
+  config->heatmap.enable = FALSE;
+  config->heatmap.file = g_strdup ("heatmap.bin");
+  config->heatmap.grid_size = 256;
+  config->heatmap.class_id = 0;
+  config->heatmap.half_life_sec = 300.0;
+  config->heatmap.decay_interval_msec = 1000;
+  config->heatmap.snapshot_interval_sec = 60;
+
+  config->source_reconnect.enable = FALSE;
+  config->source_reconnect.initial_delay_msec = 500;
+  config->source_reconnect.max_delay_msec = 30000;
+  config->source_reconnect.max_retries = 0;
+  config->source_reconnect.stall_timeout_sec = 10;
+
+  config->panorama.enable = FALSE;
+  config->panorama.width = 1920;
+  config->panorama.height = 960;
+  config->panorama.ceiling = TRUE;
+  config->panorama.file_prefix = g_strdup ("panorama");
+  config->panorama.draw_detections = TRUE;
+
+  config->roi_analytics.enable = FALSE;
+  config->roi_analytics.file = g_strdup ("roi_events.txt");
+  config->roi_analytics.regions_file =
+      g_strdup ("app_config_files/roi_regions.txt");
+  config->roi_analytics.class_id = 0;
+  config->roi_analytics.cell_size = 32;
+  config->roi_analytics.max_missed_batches = 30;
+
+  config->startup_profile.enable = FALSE;
+
+  config->parallel_init.enable = FALSE;
+  config->parallel_init.num_threads = 0;
+}
+
+void
+app_config_clear (AppConfig * config)
+{
+  g_free (config->recorder.file);
+  config->recorder.file = NULL;
+  g_free (config->replay.file);
+  config->replay.file = NULL;
+  g_free (config->trace.file);
+  config->trace.file = NULL;
+  g_free (config->track_log.file);
+  config->track_log.file = NULL;
+  g_free (config->global_tracking.file);
+  config->global_tracking.file = NULL;
+  g_free (config->global_tracking.camera_poses);
+  config->global_tracking.camera_poses = NULL;
+  config->global_tracking.num_camera_poses = 0;
+  g_free (config->heatmap.file);
+  config->heatmap.file = NULL;
+  g_free (config->panorama.file_prefix);
+  config->panorama.file_prefix = NULL;
+  g_free (config->panorama.map_cache_dir);
+  config->panorama.map_cache_dir = NULL;
+  g_free (config->roi_analytics.file);
+  config->roi_analytics.file = NULL;
+  g_free (config->roi_analytics.regions_file);
+  config->roi_analytics.regions_file = NULL;
+}
+
+static gboolean
+parse_streammux_control (GKeyFile * key_file, StreammuxControlConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_STREAMMUX_CONTROL, NULL,
+      &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_STREAMMUX_CONTROL,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_STREAMMUX_CONTROL_MIN_TIMEOUT)) {
+      config->min_timeout_usec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_STREAMMUX_CONTROL,
+          CONFIG_STREAMMUX_CONTROL_MIN_TIMEOUT, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_STREAMMUX_CONTROL_MAX_LATENCY)) {
+      config->max_latency_usec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_STREAMMUX_CONTROL,
+          CONFIG_STREAMMUX_CONTROL_MAX_LATENCY, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_STREAMMUX_CONTROL_JITTER_FACTOR)) {
+      config->jitter_factor =
+          g_key_file_get_double (key_file, CONFIG_GROUP_STREAMMUX_CONTROL,
+          CONFIG_STREAMMUX_CONTROL_JITTER_FACTOR, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_STREAMMUX_CONTROL_UPDATE_INTERVAL)) {
+      config->update_interval_msec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_STREAMMUX_CONTROL,
+          CONFIG_STREAMMUX_CONTROL_UPDATE_INTERVAL, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_STREAMMUX_CONTROL_REPORT_INTERVAL)) {
+      config->report_interval_sec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_STREAMMUX_CONTROL,
+          CONFIG_STREAMMUX_CONTROL_REPORT_INTERVAL, &error);
+      CHECK_ERROR (error);
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_STREAMMUX_CONTROL);
+    }
+  }
+
+  if (config->min_timeout_usec <= 0 ||
+      config->max_latency_usec < config->min_timeout_usec) {
+    g_printerr ("Invalid timeout bounds in group [%s]\n",
+        CONFIG_GROUP_STREAMMUX_CONTROL);
+    goto done;
+  }
+  if (config->update_interval_msec == 0) {
+    g_printerr ("%s must be > 0 in group [%s]\n",
+        CONFIG_STREAMMUX_CONTROL_UPDATE_INTERVAL,
+        CONFIG_GROUP_STREAMMUX_CONTROL);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_sharding (GKeyFile * key_file, ShardingConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_SHARDING, NULL, &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SHARDING_NUM_WORKERS)) {
+      config->num_workers =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_SHARDING_NUM_WORKERS, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SHARDING_RING_SLOTS)) {
+      config->ring_slots =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_SHARDING_RING_SLOTS, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SHARDING_MAX_RESTARTS)) {
+      config->max_restarts =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_SHARDING_MAX_RESTARTS, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SHARDING_RESTART_DELAY)) {
+      config->restart_delay_msec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_SHARDING_RESTART_DELAY, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SHARDING_HANG_TIMEOUT)) {
+      config->hang_timeout_msec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_SHARDING_HANG_TIMEOUT, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SHARDING_STARTUP_TIMEOUT)) {
+      config->startup_timeout_msec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_SHARDING_STARTUP_TIMEOUT, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SHARDING_SYNTHETIC)) {
+      config->synthetic =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_SHARDING_SYNTHETIC, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SHARDING_SYNTHETIC_FPS)) {
+      config->synthetic_fps =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_SHARDING_SYNTHETIC_FPS, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SHARDING_SYNTHETIC_FRAMES)) {
+      config->synthetic_frames =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_SHARDING_SYNTHETIC_FRAMES, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SHARDING_SYNTHETIC_OBJECTS)) {
+      config->synthetic_objects =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_SHARDING_SYNTHETIC_OBJECTS, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SHARDING_SYNTHETIC_CRASH_AFTER)) {
+      config->synthetic_crash_after =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_SHARDING_SYNTHETIC_CRASH_AFTER, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SHARDING_SYNTHETIC_HANG_AFTER)) {
+      config->synthetic_hang_after =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SHARDING,
+          CONFIG_SHARDING_SYNTHETIC_HANG_AFTER, &error);
+      CHECK_ERROR (error);
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_SHARDING);
+    }
+  }
+
+  if (config->num_workers == 0 || config->ring_slots == 0) {
+    g_printerr ("%s and %s must be > 0 in group [%s]\n",
+        CONFIG_SHARDING_NUM_WORKERS, CONFIG_SHARDING_RING_SLOTS,
+        CONFIG_GROUP_SHARDING);
+    goto done;
+  }
+  if (config->synthetic && config->synthetic_fps == 0) {
+    g_printerr ("%s must be > 0 in group [%s]\n",
+        CONFIG_SHARDING_SYNTHETIC_FPS, CONFIG_GROUP_SHARDING);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_recorder (GKeyFile * key_file, RecorderConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_RECORDER, NULL, &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_RECORDER,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_FILE)) {
+      gchar *file = g_key_file_get_string (key_file, CONFIG_GROUP_RECORDER,
+          CONFIG_KEY_FILE, &error);
+      CHECK_ERROR (error);
+      g_free (config->file);
+      config->file = file;
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_RECORDER);
+    }
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_replay (GKeyFile * key_file, ReplayConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_REPLAY, NULL, &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_REPLAY,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_FILE)) {
+      gchar *file = g_key_file_get_string (key_file, CONFIG_GROUP_REPLAY,
+          CONFIG_KEY_FILE, &error);
+      CHECK_ERROR (error);
+      g_free (config->file);
+      config->file = file;
+    } else if (!g_strcmp0 (*key, CONFIG_REPLAY_REALTIME)) {
+      config->realtime =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_REPLAY,
+          CONFIG_REPLAY_REALTIME, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_REPLAY_NUM_LOOPS)) {
+      config->num_loops =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_REPLAY,
+          CONFIG_REPLAY_NUM_LOOPS, &error);
+      CHECK_ERROR (error);
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_REPLAY);
+    }
+  }
+
+  if (config->num_loops == 0) {
+    g_printerr ("%s must be > 0 in group [%s]\n", CONFIG_REPLAY_NUM_LOOPS,
+        CONFIG_GROUP_REPLAY);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_trace (GKeyFile * key_file, TraceConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_TRACE, NULL, &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_TRACE,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_FILE)) {
+      gchar *file = g_key_file_get_string (key_file, CONFIG_GROUP_TRACE,
+          CONFIG_KEY_FILE, &error);
+      CHECK_ERROR (error);
+      g_free (config->file);
+      config->file = file;
+    } else if (!g_strcmp0 (*key, CONFIG_TRACE_MAX_EVENTS)) {
+      config->max_events =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_TRACE,
+          CONFIG_TRACE_MAX_EVENTS, &error);
+      CHECK_ERROR (error);
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_TRACE);
+    }
+  }
+
+  if (config->max_events == 0 || config->max_events > G_MAXINT / 2) {
+    g_printerr ("Invalid %s in group [%s]\n", CONFIG_TRACE_MAX_EVENTS,
+        CONFIG_GROUP_TRACE);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_track_log (GKeyFile * key_file, TrackLogConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_TRACK_LOG, NULL, &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_TRACK_LOG,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_FILE)) {
+      gchar *file = g_key_file_get_string (key_file, CONFIG_GROUP_TRACK_LOG,
+          CONFIG_KEY_FILE, &error);
+      CHECK_ERROR (error);
+      g_free (config->file);
+      config->file = file;
+    } else if (!g_strcmp0 (*key, CONFIG_TRACK_LOG_POSITION_THRESHOLD)) {
+      config->position_threshold =
+          g_key_file_get_double (key_file, CONFIG_GROUP_TRACK_LOG,
+          CONFIG_TRACK_LOG_POSITION_THRESHOLD, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_TRACK_LOG_CONFIDENCE_THRESHOLD)) {
+      config->confidence_threshold =
+          g_key_file_get_double (key_file, CONFIG_GROUP_TRACK_LOG,
+          CONFIG_TRACK_LOG_CONFIDENCE_THRESHOLD, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_TRACK_LOG_MAX_MISSED_BATCHES)) {
+      config->max_missed_batches =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_TRACK_LOG,
+          CONFIG_TRACK_LOG_MAX_MISSED_BATCHES, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_TRACK_LOG_KEYFRAME_INTERVAL)) {
+      config->keyframe_interval =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_TRACK_LOG,
+          CONFIG_TRACK_LOG_KEYFRAME_INTERVAL, &error);
+      CHECK_ERROR (error);
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_TRACK_LOG);
+    }
+  }
+
+  if (config->position_threshold < 0 || config->confidence_threshold < 0) {
+    g_printerr ("Thresholds must be >= 0 in group [%s]\n",
+        CONFIG_GROUP_TRACK_LOG);
+    goto done;
+  }
+  if (config->keyframe_interval == 0) {
+    g_printerr ("%s must be > 0 in group [%s]\n",
+        CONFIG_TRACK_LOG_KEYFRAME_INTERVAL, CONFIG_GROUP_TRACK_LOG);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_camera_pose (GKeyFile * key_file, const gchar * key,
+    GlobalTrackingConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  CameraPoseConfig *pose;
+  gdouble *values = NULL;
+  gsize length = 0;
+  guint source_id;
+  gchar tail;
+
+  if (sscanf (key, CONFIG_GLOBAL_TRACKING_CAMERA_POSE "%u%c", &source_id,
+          &tail) != 1) {
+    g_printerr ("Invalid key '%s' for group [%s]\n", key,
+        CONFIG_GROUP_GLOBAL_TRACKING);
+    goto done;
+  }
+
+  values = g_key_file_get_double_list (key_file, CONFIG_GROUP_GLOBAL_TRACKING,
+      key, &length, &error);
+  CHECK_ERROR (error);
+  if (length != 5) {
+    g_printerr ("%s needs x;y;height;yaw;tilt in group [%s]\n", key,
+        CONFIG_GROUP_GLOBAL_TRACKING);
+    goto done;
+  }
+  if (values[2] <= 0) {
+    g_printerr ("Camera height of %s must be > 0 in group [%s]\n", key,
+        CONFIG_GROUP_GLOBAL_TRACKING);
+    goto done;
+  }
+
+  config->camera_poses = g_renew (CameraPoseConfig, config->camera_poses,
+      config->num_camera_poses + 1);
+  pose = &config->camera_poses[config->num_camera_poses++];
+  pose->source_id = source_id;
+  pose->x = values[0];
+  pose->y = values[1];
+  pose->height = values[2];
+  pose->yaw = values[3];
+  pose->tilt = values[4];
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  g_free (values);
+  return ret;
+}
+
+static gboolean
+parse_global_tracking (GKeyFile * key_file, GlobalTrackingConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_GLOBAL_TRACKING, NULL,
+      &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_GLOBAL_TRACKING,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_FILE)) {
+      gchar *file = g_key_file_get_string (key_file,
+          CONFIG_GROUP_GLOBAL_TRACKING, CONFIG_KEY_FILE, &error);
+      CHECK_ERROR (error);
+      g_free (config->file);
+      config->file = file;
+    } else if (!g_strcmp0 (*key, CONFIG_GLOBAL_TRACKING_GATE_RADIUS)) {
+      config->gate_radius =
+          g_key_file_get_double (key_file, CONFIG_GROUP_GLOBAL_TRACKING,
+          CONFIG_GLOBAL_TRACKING_GATE_RADIUS, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_GLOBAL_TRACKING_MAX_AGE)) {
+      config->max_age_msec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_GLOBAL_TRACKING,
+          CONFIG_GLOBAL_TRACKING_MAX_AGE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_GLOBAL_TRACKING_VELOCITY_SMOOTHING)) {
+      config->velocity_smoothing =
+          g_key_file_get_double (key_file, CONFIG_GROUP_GLOBAL_TRACKING,
+          CONFIG_GLOBAL_TRACKING_VELOCITY_SMOOTHING, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_GLOBAL_TRACKING_CAMERA_HEIGHT)) {
+      config->camera_height =
+          g_key_file_get_double (key_file, CONFIG_GROUP_GLOBAL_TRACKING,
+          CONFIG_GLOBAL_TRACKING_CAMERA_HEIGHT, &error);
+      CHECK_ERROR (error);
+    } else if (g_str_has_prefix (*key, CONFIG_GLOBAL_TRACKING_CAMERA_POSE)) {
+      if (!parse_camera_pose (key_file, *key, config))
+        goto done;
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_GLOBAL_TRACKING);
+    }
+  }
+
+  if (config->gate_radius <= 0 || config->camera_height <= 0) {
+    g_printerr ("%s and %s must be > 0 in group [%s]\n",
+        CONFIG_GLOBAL_TRACKING_GATE_RADIUS,
+        CONFIG_GLOBAL_TRACKING_CAMERA_HEIGHT, CONFIG_GROUP_GLOBAL_TRACKING);
+    goto done;
+  }
+  if (config->velocity_smoothing < 0 || config->velocity_smoothing > 1) {
+    g_printerr ("%s must be within [0, 1] in group [%s]\n",
+        CONFIG_GLOBAL_TRACKING_VELOCITY_SMOOTHING,
+        CONFIG_GROUP_GLOBAL_TRACKING);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_heatmap (GKeyFile * key_file, HeatmapConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_HEATMAP, NULL, &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_HEATMAP,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_FILE)) {
+      gchar *file = g_key_file_get_string (key_file, CONFIG_GROUP_HEATMAP,
+          CONFIG_KEY_FILE, &error);
+      CHECK_ERROR (error);
+      g_free (config->file);
+      config->file = file;
+    } else if (!g_strcmp0 (*key, CONFIG_HEATMAP_GRID_SIZE)) {
+      config->grid_size =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_HEATMAP,
+          CONFIG_HEATMAP_GRID_SIZE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_HEATMAP_CLASS_ID)) {
+      config->class_id =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_HEATMAP,
+          CONFIG_HEATMAP_CLASS_ID, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_HEATMAP_HALF_LIFE)) {
+      config->half_life_sec =
+          g_key_file_get_double (key_file, CONFIG_GROUP_HEATMAP,
+          CONFIG_HEATMAP_HALF_LIFE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_HEATMAP_DECAY_INTERVAL)) {
+      config->decay_interval_msec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_HEATMAP,
+          CONFIG_HEATMAP_DECAY_INTERVAL, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_HEATMAP_SNAPSHOT_INTERVAL)) {
+      config->snapshot_interval_sec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_HEATMAP,
+          CONFIG_HEATMAP_SNAPSHOT_INTERVAL, &error);
+      CHECK_ERROR (error);
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_HEATMAP);
+    }
+  }
+
+  if (config->grid_size < 16 || config->grid_size > 4096 ||
+      config->grid_size % 8) {
+    g_printerr ("%s must be a multiple of 8 within [16, 4096] in group [%s]\n",
+        CONFIG_HEATMAP_GRID_SIZE, CONFIG_GROUP_HEATMAP);
+    goto done;
+  }
+  if (config->half_life_sec <= 0 || config->decay_interval_msec == 0) {
+    g_printerr ("%s and %s must be > 0 in group [%s]\n",
+        CONFIG_HEATMAP_HALF_LIFE, CONFIG_HEATMAP_DECAY_INTERVAL,
+        CONFIG_GROUP_HEATMAP);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_source_reconnect (GKeyFile * key_file, SourceReconnectConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_SOURCE_RECONNECT, NULL,
+      &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SOURCE_RECONNECT,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SOURCE_RECONNECT_INITIAL_DELAY)) {
+      config->initial_delay_msec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SOURCE_RECONNECT,
+          CONFIG_SOURCE_RECONNECT_INITIAL_DELAY, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SOURCE_RECONNECT_MAX_DELAY)) {
+      config->max_delay_msec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SOURCE_RECONNECT,
+          CONFIG_SOURCE_RECONNECT_MAX_DELAY, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SOURCE_RECONNECT_MAX_RETRIES)) {
+      config->max_retries =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SOURCE_RECONNECT,
+          CONFIG_SOURCE_RECONNECT_MAX_RETRIES, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_SOURCE_RECONNECT_STALL_TIMEOUT)) {
+      config->stall_timeout_sec =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_SOURCE_RECONNECT,
+          CONFIG_SOURCE_RECONNECT_STALL_TIMEOUT, &error);
+      CHECK_ERROR (error);
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_SOURCE_RECONNECT);
+    }
+  }
+
+  if (config->initial_delay_msec == 0 ||
+      config->max_delay_msec < config->initial_delay_msec) {
+    g_printerr ("%s must be > 0 and <= %s in group [%s]\n",
+        CONFIG_SOURCE_RECONNECT_INITIAL_DELAY,
+        CONFIG_SOURCE_RECONNECT_MAX_DELAY, CONFIG_GROUP_SOURCE_RECONNECT);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_panorama (GKeyFile * key_file, PanoramaConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_PANORAMA, NULL, &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_PANORAMA,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_PANORAMA_WIDTH)) {
+      config->width =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_PANORAMA,
+          CONFIG_PANORAMA_WIDTH, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_PANORAMA_HEIGHT)) {
+      config->height =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_PANORAMA,
+          CONFIG_PANORAMA_HEIGHT, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_PANORAMA_CEILING)) {
+      config->ceiling =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_PANORAMA,
+          CONFIG_PANORAMA_CEILING, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_PANORAMA_FILE_PREFIX)) {
+      gchar *file_prefix = g_key_file_get_string (key_file,
+          CONFIG_GROUP_PANORAMA, CONFIG_PANORAMA_FILE_PREFIX, &error);
+      CHECK_ERROR (error);
+      g_free (config->file_prefix);
+      config->file_prefix = file_prefix;
+    } else if (!g_strcmp0 (*key, CONFIG_PANORAMA_DRAW_DETECTIONS)) {
+      config->draw_detections =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_PANORAMA,
+          CONFIG_PANORAMA_DRAW_DETECTIONS, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_PANORAMA_MAP_CACHE_DIR)) {
+      gchar *map_cache_dir = g_key_file_get_string (key_file,
+          CONFIG_GROUP_PANORAMA, CONFIG_PANORAMA_MAP_CACHE_DIR, &error);
+      CHECK_ERROR (error);
+      g_free (config->map_cache_dir);
+      config->map_cache_dir = map_cache_dir;
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_PANORAMA);
+    }
+  }
+
+  if (config->width < 16 || config->width > 8192 || config->width % 2 ||
+      config->height < 16 || config->height > 8192 || config->height % 2) {
+    g_printerr ("%s and %s must be even and within [16, 8192] in group [%s]\n",
+        CONFIG_PANORAMA_WIDTH, CONFIG_PANORAMA_HEIGHT, CONFIG_GROUP_PANORAMA);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_roi_analytics (GKeyFile * key_file, RoiAnalyticsConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_ROI_ANALYTICS, NULL,
+      &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_ROI_ANALYTICS,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_FILE)) {
+      gchar *file = g_key_file_get_string (key_file,
+          CONFIG_GROUP_ROI_ANALYTICS, CONFIG_KEY_FILE, &error);
+      CHECK_ERROR (error);
+      g_free (config->file);
+      config->file = file;
+    } else if (!g_strcmp0 (*key, CONFIG_ROI_ANALYTICS_REGIONS_FILE)) {
+      gchar *regions_file = g_key_file_get_string (key_file,
+          CONFIG_GROUP_ROI_ANALYTICS, CONFIG_ROI_ANALYTICS_REGIONS_FILE,
+          &error);
+      CHECK_ERROR (error);
+      g_free (config->regions_file);
+      config->regions_file = regions_file;
+    } else if (!g_strcmp0 (*key, CONFIG_ROI_ANALYTICS_CLASS_ID)) {
+      config->class_id =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_ROI_ANALYTICS,
+          CONFIG_ROI_ANALYTICS_CLASS_ID, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_ROI_ANALYTICS_CELL_SIZE)) {
+      config->cell_size =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_ROI_ANALYTICS,
+          CONFIG_ROI_ANALYTICS_CELL_SIZE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_ROI_ANALYTICS_MAX_MISSED_BATCHES)) {
+      config->max_missed_batches =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_ROI_ANALYTICS,
+          CONFIG_ROI_ANALYTICS_MAX_MISSED_BATCHES, &error);
+      CHECK_ERROR (error);
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_ROI_ANALYTICS);
+    }
+  }
+
+  if (config->cell_size < 4 || config->cell_size > 1024) {
+    g_printerr ("%s must be within [4, 1024] in group [%s]\n",
+        CONFIG_ROI_ANALYTICS_CELL_SIZE, CONFIG_GROUP_ROI_ANALYTICS);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_startup_profile (GKeyFile * key_file, StartupProfileConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_STARTUP_PROFILE, NULL,
+      &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_STARTUP_PROFILE,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_STARTUP_PROFILE);
+    }
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_parallel_init (GKeyFile * key_file, ParallelInitConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_PARALLEL_INIT, NULL,
+      &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
+      config->enable =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_PARALLEL_INIT,
+          CONFIG_KEY_ENABLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_PARALLEL_INIT_NUM_THREADS)) {
+      config->num_threads =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_PARALLEL_INIT,
+          CONFIG_PARALLEL_INIT_NUM_THREADS, &error);
+      CHECK_ERROR (error);
+    } else {
+      g_printerr ("Unknown key '%s' for group [%s]\n", *key,
+          CONFIG_GROUP_PARALLEL_INIT);
+    }
+  }
+
+  if (config->num_threads > 256) {
+    g_printerr ("%s must be within [0, 256] in group [%s]\n",
+        CONFIG_PARALLEL_INIT_NUM_THREADS, CONFIG_GROUP_PARALLEL_INIT);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+gboolean
+parse_app_config (AppConfig * config, const gchar * config_file_name)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  GKeyFile *key_file = g_key_file_new ();
+
+  if (!g_key_file_load_from_file (key_file, config_file_name, G_KEY_FILE_NONE,
+          &error)) {
+    g_printerr ("Failed to load config file: %s\n", error->message);
+    goto done;
+  }
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_STREAMMUX_CONTROL) &&
+      !parse_streammux_control (key_file, &config->streammux_control))
+    goto done;
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_SHARDING) &&
+      !parse_sharding (key_file, &config->sharding))
+    goto done;
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_RECORDER) &&
+      !parse_recorder (key_file, &config->recorder))
+    goto done;
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_REPLAY) &&
+      !parse_replay (key_file, &config->replay))
+    goto done;
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_TRACE) &&
+      !parse_trace (key_file, &config->trace))
+    goto done;
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_TRACK_LOG) &&
+      !parse_track_log (key_file, &config->track_log))
+    goto done;
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_GLOBAL_TRACKING) &&
+      !parse_global_tracking (key_file, &config->global_tracking))
+    goto done;
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_HEATMAP) &&
+      !parse_heatmap (key_file, &config->heatmap))
+    goto done;
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_SOURCE_RECONNECT) &&
+      !parse_source_reconnect (key_file, &config->source_reconnect))
+    goto done;
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_PANORAMA) &&
+      !parse_panorama (key_file, &config->panorama))
+    goto done;
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_ROI_ANALYTICS) &&
+      !parse_roi_analytics (key_file, &config->roi_analytics))
+    goto done;
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_STARTUP_PROFILE) &&
+      !parse_startup_profile (key_file, &config->startup_profile))
+    goto done;
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_PARALLEL_INIT) &&
+      !parse_parallel_init (key_file, &config->parallel_init))
+    goto done;
+
+  if (config->recorder.enable && config->replay.enable &&
+      !g_strcmp0 (config->recorder.file, config->replay.file)) {
+    g_printerr ("[%s] and [%s] must not use the same file\n",
+        CONFIG_GROUP_RECORDER, CONFIG_GROUP_REPLAY);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  g_key_file_free (key_file);
+  if (!ret) {
+    g_printerr ("%s failed\n", __func__);
+  }
+  return ret;
+}
@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __APP_CONFIG_H__
+#define __APP_CONFIG_H__
+
+#include <glib.h>
+
+/* Optional application config file. Every feature configured here is
+ * disabled unless its group sets enable=1, so the app behaves as before when
+ * the file is missing. */
+#define APP_CONFIG_FILE "app_config_files/app_config.txt"
+
+#define CONFIG_KEY_ENABLE "enable"
+#define CONFIG_KEY_FILE "file"
+
+/*  Define streammux controller group features */
+
+#define CONFIG_GROUP_STREAMMUX_CONTROL "streammux-control"
+#define CONFIG_STREAMMUX_CONTROL_MIN_TIMEOUT "min-timeout-usec"
+#define CONFIG_STREAMMUX_CONTROL_MAX_LATENCY "max-latency-usec"
+#define CONFIG_STREAMMUX_CONTROL_JITTER_FACTOR "jitter-factor"
+#define CONFIG_STREAMMUX_CONTROL_UPDATE_INTERVAL "update-interval-msec"
+#define CONFIG_STREAMMUX_CONTROL_REPORT_INTERVAL "report-interval-sec"
+
+/*  Define source sharding group features */
+
+#define CONFIG_GROUP_SHARDING "sharding"
+#define CONFIG_SHARDING_NUM_WORKERS "num-workers"
+#define CONFIG_SHARDING_RING_SLOTS "ring-slots"
+#define CONFIG_SHARDING_MAX_RESTARTS "max-restarts"
+#define CONFIG_SHARDING_RESTART_DELAY "restart-delay-msec"
+#define CONFIG_SHARDING_HANG_TIMEOUT "hang-timeout-msec"
+#define CONFIG_SHARDING_STARTUP_TIMEOUT "startup-timeout-msec"
+#define CONFIG_SHARDING_SYNTHETIC "synthetic"
+#define CONFIG_SHARDING_SYNTHETIC_FPS "synthetic-fps"
+#define CONFIG_SHARDING_SYNTHETIC_FRAMES "synthetic-frames"
+#define CONFIG_SHARDING_SYNTHETIC_OBJECTS "synthetic-objects"
+#define CONFIG_SHARDING_SYNTHETIC_CRASH_AFTER "synthetic-crash-after"
+#define CONFIG_SHARDING_SYNTHETIC_HANG_AFTER "synthetic-hang-after"
+
+/*  Define metadata recorder and replay group features */
+
+#define CONFIG_GROUP_RECORDER "metadata-recorder"
+#define CONFIG_GROUP_REPLAY "metadata-replay"
+#define CONFIG_REPLAY_REALTIME "realtime"
+#define CONFIG_REPLAY_NUM_LOOPS "num-loops"
+
+/*  Define pipeline trace group features */
+
+#define CONFIG_GROUP_TRACE "trace"
+#define CONFIG_TRACE_MAX_EVENTS "max-events"
+
+/*  Define track log group features */
+
+#define CONFIG_GROUP_TRACK_LOG "track-log"
+#define CONFIG_TRACK_LOG_POSITION_THRESHOLD "position-threshold"
+#define CONFIG_TRACK_LOG_CONFIDENCE_THRESHOLD "confidence-threshold"
+#define CONFIG_TRACK_LOG_MAX_MISSED_BATCHES "max-missed-batches"
+#define CONFIG_TRACK_LOG_KEYFRAME_INTERVAL "keyframe-interval"
+
+/*  Define global tracking group features */
+
+#define CONFIG_GROUP_GLOBAL_TRACKING "global-tracking"
+#define CONFIG_GLOBAL_TRACKING_GATE_RADIUS "gate-radius"
+#define CONFIG_GLOBAL_TRACKING_MAX_AGE "max-age-msec"
+#define CONFIG_GLOBAL_TRACKING_VELOCITY_SMOOTHING "velocity-smoothing"
+#define CONFIG_GLOBAL_TRACKING_CAMERA_HEIGHT "camera-height"
+/* Followed by the stream index, e.g. camera-pose-0. */
+#define CONFIG_GLOBAL_TRACKING_CAMERA_POSE "camera-pose-"
+
+/*  Define source reconnect group features */
+
+#define CONFIG_GROUP_SOURCE_RECONNECT "source-reconnect"
+#define CONFIG_SOURCE_RECONNECT_INITIAL_DELAY "initial-delay-msec"
+#define CONFIG_SOURCE_RECONNECT_MAX_DELAY "max-delay-msec"
+#define CONFIG_SOURCE_RECONNECT_MAX_RETRIES "max-retries"
+#define CONFIG_SOURCE_RECONNECT_STALL_TIMEOUT "stall-timeout-sec"
+
+#define CONFIG_GROUP_PANORAMA "panorama"
+#define CONFIG_PANORAMA_WIDTH "width"
+#define CONFIG_PANORAMA_HEIGHT "height"
+#define CONFIG_PANORAMA_CEILING "ceiling"
+#define CONFIG_PANORAMA_FILE_PREFIX "file-prefix"
+#define CONFIG_PANORAMA_DRAW_DETECTIONS "draw-detections"
+#define CONFIG_PANORAMA_MAP_CACHE_DIR "map-cache-dir"
+
+/*  Define heatmap group features */
+
+#define CONFIG_GROUP_HEATMAP "heatmap"
+#define CONFIG_HEATMAP_GRID_SIZE "grid-size"
+#define CONFIG_HEATMAP_CLASS_ID "class-id"
+#define CONFIG_HEATMAP_HALF_LIFE "half-life-sec"
+#define CONFIG_HEATMAP_DECAY_INTERVAL "decay-interval-msec"
+#define CONFIG_HEATMAP_SNAPSHOT_INTERVAL "snapshot-interval-sec"
+
+/*  Define ROI analytics group features */
+
+#define CONFIG_GROUP_ROI_ANALYTICS "roi-analytics"
+#define CONFIG_ROI_ANALYTICS_REGIONS_FILE "regions-file"
+#define CONFIG_ROI_ANALYTICS_CLASS_ID "class-id"
+#define CONFIG_ROI_ANALYTICS_CELL_SIZE "cell-size"
+#define CONFIG_ROI_ANALYTICS_MAX_MISSED_BATCHES "max-missed-batches"
+
+/*  Define startup group features */
+
+#define CONFIG_GROUP_STARTUP_PROFILE "startup-profile"
+#define CONFIG_GROUP_PARALLEL_INIT "parallel-init"
+#define CONFIG_PARALLEL_INIT_NUM_THREADS "num-threads"
+
+typedef struct _StreammuxControlConfig
+{
+  gboolean enable;
+  /* Lower and upper bound applied to batched-push-timeout. The upper bound is
+   * the extra latency we accept to get a fuller batch. */
+  gint min_timeout_usec;
+  gint max_latency_usec;
+  /* Number of jitter deviations added on top of the mean frame interval. */
+  gdouble jitter_factor;
+  guint update_interval_msec;
+  /* 0 disables the periodic report, stats are still printed at exit. */
+  guint report_interval_sec;
+} StreammuxControlConfig;
+
+typedef struct _ShardingConfig
+{
+  gboolean enable;
+  guint num_workers;
+  /* Slots per worker ring, one slot holds the metadata of one frame. */
+  guint ring_slots;
+  /* Restarts allowed per worker; the delay doubles on every restart. */
+  guint max_restarts;
+  guint restart_delay_msec;
+  /* A worker that publishes no frame for hang-timeout-msec, or no first
+   * frame for startup-timeout-msec after it started, is killed and
+   * restarted. 0 disables either. */
+  guint hang_timeout_msec;
+  guint startup_timeout_msec;
+  /* Workers generate moving boxes on the CPU instead of running a pipeline,
+   * for testing the transport and failure handling without a GPU. */
+  gboolean synthetic;
+  guint synthetic_fps;
+  guint synthetic_frames;
+  guint synthetic_objects;
+  /* Worker 0 aborts after this many frames on its first run, 0 disables. */
+  guint synthetic_crash_after;
+  /* Worker 0 stops publishing, without exiting, after this many frames on
+   * its first run, 0 disables. */
+  guint synthetic_hang_after;
+} ShardingConfig;
+
+typedef struct _RecorderConfig
+{
+  gboolean enable;
+  gchar *file;
+} RecorderConfig;
+
+typedef struct _ReplayConfig
+{
+  gboolean enable;
+  gchar *file;
+  /* Pace batches with their recorded timestamps instead of replaying them
+   * as fast as possible. */
+  gboolean realtime;
+  guint num_loops;
+} ReplayConfig;
+
+typedef struct _TraceConfig
+{
+  gboolean enable;
+  gchar *file;
+  /* Size of the preallocated event buffer, events beyond it are dropped. */
+  guint max_events;
+} TraceConfig;
+
+typedef struct _TrackLogConfig
+{
+  gboolean enable;
+  gchar *file;
+  /* An update is written once any bbox edge moved by more than this many
+   * pixels, or the confidence changed by more than confidence_threshold,
+   * since the last written state of the track. */
+  gdouble position_threshold;
+  gdouble confidence_threshold;
+  /* A track dies after it was missing from this many batches. */
+  guint max_missed_batches;
+  /* Full state of all live tracks is written every N batches. */
+  guint keyframe_interval;
+} TrackLogConfig;
+
+typedef struct _CameraPoseConfig
+{
+  guint source_id;
+  /* Position on the floor plan and mounting height, in meters. */
+  gdouble x;
+  gdouble y;
+  gdouble height;
+  /* Heading on the floor plan, and tilt of the optical axis away from
+   * straight down, in degrees. */
+  gdouble yaw;
+  gdouble tilt;
+} CameraPoseConfig;
+
+typedef struct _GlobalTrackingConfig
+{
+  gboolean enable;
+  gchar *file;
+  /* Largest distance in meters between a new track and the predicted
+   * position of a global track it may join. */
+  gdouble gate_radius;
+  /* A global identity is dropped once it was not observed for this long. */
+  guint max_age_msec;
+  /* Weight of the newest velocity measurement, 0..1. */
+  gdouble velocity_smoothing;
+  /* Mounting height assumed for cameras without a pose. */
+  gdouble camera_height;
+  /* Cameras with a pose share one floor plan; every other camera only
+   * unifies tracks across its own surfaces. */
+  guint num_camera_poses;
+  CameraPoseConfig *camera_poses;
+} GlobalTrackingConfig;
+
+typedef struct _SourceReconnectConfig
+{
+  gboolean enable;
+  /* Delay before the first reconnect attempt, doubled after every failed
+   * attempt up to max_delay_msec. */
+  guint initial_delay_msec;
+  guint max_delay_msec;
+  /* Failed attempts after which a source is given up, 0 for never. */
+  guint max_retries;
+  /* A source without buffers for this long is reconnected, 0 disables. */
+  guint stall_timeout_sec;
+} SourceReconnectConfig;
+
+typedef struct _HeatmapConfig
+{
+  gboolean enable;
+  gchar *file;
+  /* Cells per side of the grid of every camera, a multiple of 8. */
+  guint grid_size;
+  /* Only detections of this class are counted, -1 for all. */
+  gint class_id;
+  /* Time after which a detection counts half. */
+  gdouble half_life_sec;
+  guint decay_interval_msec;
+  /* 0 writes a single snapshot at exit. */
+  guint snapshot_interval_sec;
+} HeatmapConfig;
+
+typedef struct _PanoramaConfig
+{
+  gboolean enable;
+  /* Resolution of the equirectangular view, width even for the encoder. */
+  guint width;
+  guint height;
+  /* Camera looks straight down, the view then spans the azimuth around it. */
+  gboolean ceiling;
+  /* Source N is written to <file_prefix>_N.h264. */
+  gchar *file_prefix;
+  gboolean draw_detections;
+  /* Directory the remap tables are loaded from and saved to, NULL to always
+   * compute them. */
+  gchar *map_cache_dir;
+} PanoramaConfig;
+
+typedef struct _RoiAnalyticsConfig
+{
+  gboolean enable;
+  /* Event output. */
+  gchar *file;
+  /* Zones and lines, see roi_analytics.h. */
+  gchar *regions_file;
+  /* Only objects of this class are followed, -1 for all. */
+  gint class_id;
+  /* Side in pixels of the cells of the lookup grid of every surface. */
+  guint cell_size;
+  /* A track that was missing this many batches has left its zones. */
+  guint max_missed_batches;
+} RoiAnalyticsConfig;
+
+typedef struct _StartupProfileConfig
+{
+  gboolean enable;
+} StartupProfileConfig;
+
+typedef struct _ParallelInitConfig
+{
+  gboolean enable;
+  /* Threads creating source chains, 0 for one per CPU. */
+  guint num_threads;
+} ParallelInitConfig;
+
+typedef struct _AppConfig
+{
+  StreammuxControlConfig streammux_control;
+  ShardingConfig sharding;
+  RecorderConfig recorder;
+  ReplayConfig replay;
+  TraceConfig trace;
+  TrackLogConfig track_log;
+  GlobalTrackingConfig global_tracking;
+  HeatmapConfig heatmap;
+  SourceReconnectConfig source_reconnect;
+  PanoramaConfig panorama;
+  RoiAnalyticsConfig roi_analytics;
+  StartupProfileConfig startup_profile;
+  ParallelInitConfig parallel_init;
+} AppConfig;
+
+void app_config_set_defaults (AppConfig * config);
+
+/* Frees the strings owned by config. */
+void app_config_clear (AppConfig * config);
+
+/* Parses the optional application config file into config. Missing groups
+ * and keys keep their default values. */
+gboolean parse_app_config (AppConfig * config, const gchar * config_file_name);
+
+#endif
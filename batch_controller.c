@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gst/gst.h>
+#include <glib.h>
+#include <math.h>
+
+#include "gstnvdsmeta.h"
+#include "batch_controller.h"
+
+/* Weight of a new sample in the moving averages. */
+#define INTERVAL_EMA_ALPHA (1.0 / 16)
+
+/* A source that has not delivered a frame for this many of its own frame
+ * intervals is considered stalled and does not influence the timeout, so a
+ * disconnected camera cannot pin the timeout to its maximum. */
+#define STALE_INTERVAL_FACTOR 4
+
+/* Ignore timeout changes smaller than 1/10th of the current value to avoid
+ * toggling the muxer property on every update. */
+#define TIMEOUT_HYSTERESIS_DIV 10
+
+static GstPadProbeReturn
+source_arrival_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  BatchSourceStats *stats = (BatchSourceStats *) u_data;
+  BatchController *controller = stats->controller;
+  gint64 now = g_get_monotonic_time ();
+
+  g_mutex_lock (&controller->lock);
+  if (stats->num_buffers > 0) {
+    gdouble interval = (gdouble) (now - stats->last_arrival);
+    if (stats->num_buffers == 1) {
+      stats->mean_interval = interval;
+    } else {
+      stats->jitter += INTERVAL_EMA_ALPHA *
+          (fabs (interval - stats->mean_interval) - stats->jitter);
+      stats->mean_interval += INTERVAL_EMA_ALPHA *
+          (interval - stats->mean_interval);
+    }
+  }
+  stats->last_arrival = now;
+  stats->num_buffers++;
+  if (controller->pending_since == 0)
+    controller->pending_since = now;
+  g_mutex_unlock (&controller->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+batch_output_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  BatchController *controller = (BatchController *) u_data;
+  GstBuffer *buf = (GstBuffer *) info->data;
+  NvDsBatchMeta *batch_meta = gst_buffer_get_nvds_batch_meta (buf);
+  gint64 now = g_get_monotonic_time ();
+
+  if (!batch_meta)
+    return GST_PAD_PROBE_OK;
+
+  g_mutex_lock (&controller->lock);
+  controller->num_batches++;
+  controller->num_frames += batch_meta->num_frames_in_batch;
+  controller->num_frame_slots += batch_meta->max_frames_in_batch;
+  if (controller->pending_since != 0) {
+    gint64 wait = now - controller->pending_since;
+    controller->total_wait_usec += wait;
+    if (wait > controller->max_wait_usec)
+      controller->max_wait_usec = wait;
+    controller->pending_since = 0;
+  }
+  g_mutex_unlock (&controller->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+batch_controller_update (gpointer data)
+{
+  BatchController *controller = (BatchController *) data;
+  gint64 now = g_get_monotonic_time ();
+  gdouble target = G_MAXDOUBLE;
+  guint active = 0;
+  guint i;
+  gint timeout;
+
+  g_mutex_lock (&controller->lock);
+  for (i = 0; i < controller->num_sources; i++) {
+    BatchSourceStats *stats = &controller->sources[i];
+    gdouble expected;
+
+    if (stats->num_buffers < 2)
+      continue;
+    if (now - stats->last_arrival >
+        STALE_INTERVAL_FACTOR * stats->mean_interval)
+      continue;
+
+    /* A batch takes one frame per source, so waiting for a slower source
+     * would hold every faster one to its rate. The fastest active source,
+     * with its jitter margin, sets the pace; slower ones join the batches
+     * their frames arrive in time for. */
+    expected = stats->mean_interval +
+        controller->config.jitter_factor * stats->jitter;
+    if (expected < target)
+      target = expected;
+    active++;
+  }
+  g_mutex_unlock (&controller->lock);
+
+  if (!active)
+    return TRUE;
+
+  timeout = CLAMP ((gint) target, controller->config.min_timeout_usec,
+      controller->config.max_latency_usec);
+  if (ABS (timeout - controller->timeout_usec) * TIMEOUT_HYSTERESIS_DIV >
+      controller->timeout_usec) {
+    g_object_set (G_OBJECT (controller->streammux),
+        "batched-push-timeout", timeout, NULL);
+    controller->timeout_usec = timeout;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+batch_controller_report (gpointer data)
+{
+  batch_controller_print_stats ((BatchController *) data);
+  return TRUE;
+}
+
+BatchController *
+batch_controller_new (GstElement * streammux, guint num_sources,
+    gint initial_timeout_usec, const StreammuxControlConfig * config)
+{
+  BatchController *controller = g_new0 (BatchController, 1);
+  guint i;
+
+  controller->streammux = streammux;
+  controller->config = *config;
+  controller->num_sources = num_sources;
+  controller->timeout_usec = initial_timeout_usec;
+  controller->sources = g_new0 (BatchSourceStats, num_sources);
+  for (i = 0; i < num_sources; i++) {
+    controller->sources[i].controller = controller;
+    controller->sources[i].index = i;
+  }
+  g_mutex_init (&controller->lock);
+
+  return controller;
+}
+
+gboolean
+batch_controller_add_source (BatchController * controller, guint index,
+    GstPad * upstream_srcpad)
+{
+  if (index >= controller->num_sources) {
+    g_printerr ("Invalid streammux source index %u\n", index);
+    return FALSE;
+  }
+
+  gst_pad_add_probe (upstream_srcpad, GST_PAD_PROBE_TYPE_BUFFER,
+      source_arrival_probe, &controller->sources[index], NULL);
+  return TRUE;
+}
+
+gboolean
+batch_controller_start (BatchController * controller)
+{
+  GstPad *mux_srcpad = gst_element_get_static_pad (controller->streammux,
+      "src");
+
+  if (!mux_srcpad) {
+    g_printerr ("Failed to get src pad of streammux\n");
+    return FALSE;
+  }
+  gst_pad_add_probe (mux_srcpad, GST_PAD_PROBE_TYPE_BUFFER,
+      batch_output_probe, controller, NULL);
+  gst_object_unref (mux_srcpad);
+
+  controller->update_timer_id =
+      g_timeout_add (controller->config.update_interval_msec,
+      batch_controller_update, controller);
+  if (controller->config.report_interval_sec)
+    controller->report_timer_id =
+        g_timeout_add_seconds (controller->config.report_interval_sec,
+        batch_controller_report, controller);
+
+  return TRUE;
+}
+
+void
+batch_controller_print_stats (BatchController * controller)
+{
+  guint i;
+
+  g_mutex_lock (&controller->lock);
+  g_print ("Streammux: batched-push-timeout %d usec, batches %" G_GUINT64_FORMAT
+      ", fill ratio %.3f, wait avg %.2f ms max %.2f ms\n",
+      controller->timeout_usec, controller->num_batches,
+      controller->num_frame_slots ?
+      (gdouble) controller->num_frames / controller->num_frame_slots : 0.0,
+      controller->num_batches ?
+      controller->total_wait_usec / controller->num_batches / 1000.0 : 0.0,
+      controller->max_wait_usec / 1000.0);
+  for (i = 0; i < controller->num_sources; i++) {
+    BatchSourceStats *stats = &controller->sources[i];
+    g_print ("  source %u: fps %.2f jitter %.2f ms buffers %" G_GUINT64_FORMAT
+        "\n", stats->index,
+        stats->mean_interval > 0 ? 1000000.0 / stats->mean_interval : 0.0,
+        stats->jitter / 1000.0, stats->num_buffers);
+  }
+  g_mutex_unlock (&controller->lock);
+}
+
+void
+batch_controller_free (BatchController * controller)
+{
+  if (!controller)
+    return;
+  if (controller->update_timer_id)
+    g_source_remove (controller->update_timer_id);
+  if (controller->report_timer_id)
+    g_source_remove (controller->report_timer_id);
+  g_mutex_clear (&controller->lock);
+  g_free (controller->sources);
+  g_free (controller);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __BATCH_CONTROLLER_H__
+#define __BATCH_CONTROLLER_H__
+
+#include <gst/gst.h>
+
+#include "app_config.h"
+
+/* Adjusts the nvstreammux batched-push-timeout from the measured frame
+ * arrival rate and jitter of every source, and reports how full the formed
+ * batches are and how long the first frame of a batch waited for it. */
+
+typedef struct _BatchSourceStats
+{
+  struct _BatchController *controller;
+  guint index;
+  gint64 last_arrival;
+  /* Exponential moving averages of the inter-arrival time and of its
+   * absolute deviation, in microseconds. */
+  gdouble mean_interval;
+  gdouble jitter;
+  guint64 num_buffers;
+} BatchSourceStats;
+
+typedef struct _BatchController
+{
+  GstElement *streammux;
+  StreammuxControlConfig config;
+  guint num_sources;
+  BatchSourceStats *sources;
+  GMutex lock;
+  guint update_timer_id;
+  guint report_timer_id;
+  gint timeout_usec;
+
+  /* Time the oldest frame not yet part of a batch arrived at the muxer. */
+  gint64 pending_since;
+  guint64 num_batches;
+  guint64 num_frames;
+  guint64 num_frame_slots;
+  gdouble total_wait_usec;
+  gint64 max_wait_usec;
+} BatchController;
+
+BatchController *batch_controller_new (GstElement * streammux,
+    guint num_sources, gint initial_timeout_usec,
+    const StreammuxControlConfig * config);
+
+/* Installs the arrival probe on the pad feeding streammux sink_<index>. */
+gboolean batch_controller_add_source (BatchController * controller,
+    guint index, GstPad * upstream_srcpad);
+
+/* Installs the batch probe on the streammux src pad and starts the periodic
+ * timeout update. */
+gboolean batch_controller_start (BatchController * controller);
+
+void batch_controller_print_stats (BatchController * controller);
+
+void batch_controller_free (BatchController * controller);
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Formats dense synthetic batches into the metadata dump, once with the
+ * fopen/fprintf/fclose per batch the probe used to do and once with
+ * MetadataDump, checks that both files are identical and reports ns/object.
+ *
+ * Usage: metadata_dump_bench [objects per batch] [batches] */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "frame_record.h"
+#include "metadata_dump.h"
+
+#define STDIO_FILE "metadata_dump_bench_stdio.txt"
+#define DUMP_FILE "metadata_dump_bench_dump.txt"
+
+static const gchar *labels[METADATA_DUMP_NUM_CLASSES] = {
+  "Person", "Bag", "Face"
+};
+
+static void
+fill_batch (FrameRecordBatch * batch, guint num_objects, guint64 batch_num)
+{
+  guint i;
+
+  batch->batch_num = batch_num;
+  batch->timestamp = g_get_monotonic_time ();
+  batch->num_frames = 0;
+  while (num_objects) {
+    FrameRecord *record = frame_record_batch_append (batch);
+
+    if (!record)
+      break;
+    memset (record, 0, sizeof (FrameRecord));
+    record->batch_num = batch_num;
+    record->source_id = batch->num_frames - 1;
+    record->num_objects = MIN (num_objects, FRAME_RECORD_MAX_OBJECTS);
+    for (i = 0; i < record->num_objects; i++) {
+      ObjectRecord *object = &record->objects[i];
+
+      object->object_id = batch_num * FRAME_RECORD_MAX_OBJECTS + i;
+      object->class_id = i % METADATA_DUMP_NUM_CLASSES;
+      object->left = g_random_double_range (0, 900);
+      object->top = g_random_double_range (0, 700);
+      object->width = g_random_double_range (10, 60);
+      object->height = g_random_double_range (20, 120);
+      object->confidence = g_random_double ();
+      g_strlcpy (object->label, labels[object->class_id],
+          OBJECT_RECORD_LABEL_LEN);
+    }
+    num_objects -= record->num_objects;
+  }
+}
+
+/* The per batch path of the probe before MetadataDump. */
+static void
+write_batch_stdio (const FrameRecordBatch * batch, gint frame_number)
+{
+  guint counts[METADATA_DUMP_NUM_CLASSES] = { 0 };
+  FILE *file = fopen (STDIO_FILE, "a");
+  guint i, j;
+
+  if (!file)
+    return;
+  for (i = 0; i < batch->num_frames; i++) {
+    const FrameRecord *record = batch->frames[i];
+
+    frame_record_count_classes (record, counts, METADATA_DUMP_NUM_CLASSES);
+    for (j = 0; j < record->num_objects; j++) {
+      const ObjectRecord *object = &record->objects[j];
+      fprintf (file,
+          "%s %lu 0.0 0 0.0 %f %f %f %f 0.0 0.0 0.0 0.0 0.0 0.0 0.0 %f\n",
+          object->label, object->object_id, object->left, object->top,
+          object->left + object->width, object->top + object->height,
+          object->confidence);
+    }
+  }
+  fprintf (file,
+      "Frame Number = %d People Count = %d Bag Count = %d Face Count = %d \n",
+      frame_number, counts[0], counts[1], counts[2]);
+  fclose (file);
+}
+
+static gboolean
+files_equal (const gchar * a, const gchar * b)
+{
+  gchar *contents_a = NULL, *contents_b = NULL;
+  gsize length_a = 0, length_b = 0;
+  gboolean equal;
+
+  equal = g_file_get_contents (a, &contents_a, &length_a, NULL) &&
+      g_file_get_contents (b, &contents_b, &length_b, NULL) &&
+      length_a == length_b && !memcmp (contents_a, contents_b, length_a);
+  g_free (contents_a);
+  g_free (contents_b);
+  return equal;
+}
+
+int
+main (int argc, char *argv[])
+{
+  guint num_objects = argc > 1 ? atoi (argv[1]) : 512;
+  guint num_batches = argc > 2 ? atoi (argv[2]) : 2000;
+  guint max_frames =
+      (num_objects + FRAME_RECORD_MAX_OBJECTS - 1) / FRAME_RECORD_MAX_OBJECTS;
+  FrameRecordBatch **batches;
+  MetadataDump *dump;
+  gint64 start, stdio_usec, dump_usec;
+  guint64 total_objects = (guint64) num_objects * num_batches;
+  gboolean equal;
+  guint i;
+
+  if (num_objects == 0 || num_batches == 0) {
+    g_printerr ("Usage: %s [objects per batch] [batches]\n", argv[0]);
+    return -1;
+  }
+
+  /* Batches are generated up front so only formatting is timed. */
+  batches = g_new (FrameRecordBatch *, num_batches);
+  for (i = 0; i < num_batches; i++) {
+    batches[i] = frame_record_batch_new (max_frames, TRUE);
+    fill_batch (batches[i], num_objects, i);
+  }
+  unlink (STDIO_FILE);
+  unlink (DUMP_FILE);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < num_batches; i++)
+    write_batch_stdio (batches[i], i);
+  stdio_usec = g_get_monotonic_time () - start;
+
+  dump = metadata_dump_new (DUMP_FILE);
+  if (!dump)
+    return -1;
+  start = g_get_monotonic_time ();
+  for (i = 0; i < num_batches; i++) {
+    if (!metadata_dump_write_batch (dump, batches[i])) {
+      g_printerr ("Failed to write %s\n", DUMP_FILE);
+      return -1;
+    }
+  }
+  dump_usec = g_get_monotonic_time () - start;
+  metadata_dump_free (dump);
+
+  equal = files_equal (STDIO_FILE, DUMP_FILE);
+  g_print ("%u batches of %u objects\n", num_batches, num_objects);
+  g_print ("  fopen/fprintf per batch: %8.1f ns/object\n",
+      stdio_usec * 1000.0 / total_objects);
+  g_print ("  MetadataDump:            %8.1f ns/object (%.1fx)\n",
+      dump_usec * 1000.0 / total_objects,
+      dump_usec ? (gdouble) stdio_usec / dump_usec : 0.0);
+  g_print ("  output %s\n", equal ? "identical" : "DIFFERS");
+
+  unlink (STDIO_FILE);
+  unlink (DUMP_FILE);
+  for (i = 0; i < num_batches; i++)
+    frame_record_batch_free (batches[i]);
+  g_free (batches);
+  return equal ? 0 : -1;
+}
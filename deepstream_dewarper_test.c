@@ -22,9 +22,11 @@
 
 #include <gst/gst.h>
 #include <glib.h>
+#include <glib-unix.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <signal.h>
 #include <string.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -36,6 +38,17 @@
 #include "nvdsmeta_schema.h"
 #endif
 
+#include "app_config.h"
+#include "batch_controller.h"
+#include "frame_record.h"
+#include "metadata_recorder.h"
+#include "metadata_sink.h"
+#include "panorama.h"
+#include "pipeline_trace.h"
+#include "source_health.h"
+#include "source_shard.h"
+#include "startup_profile.h"
+
 #define MEMORY_FEATURES "memory:NVMM"
 
 /* The muxer output resolution must be set if the input streams will be of
@@ -45,7 +58,8 @@
 #define MUXER_OUTPUT_HEIGHT 752
 
 /* Muxer batch formation timeout, for e.g. 40 millisec. Should ideally be set
- * based on the fastest source's framerate. */
+ * based on the fastest source's framerate. Used as the initial value when the
+ * [streammux-control] group of APP_CONFIG_FILE is enabled. */
 #define MUXER_BATCH_TIMEOUT_USEC 33000
 
 #define TILED_OUTPUT_WIDTH 1280
@@ -113,10 +127,31 @@ get_absolute_file_path (gchar *cfg_file_path, gchar *file_path)
   return abs_file_path;
 }
 
+typedef struct _BusCtx
+{
+  GMainLoop *loop;
+  /* Set with [source-reconnect] enabled, source errors then only take down
+   * their own source. */
+  SourceHealth *source_health;
+} BusCtx;
+
+/* SIGINT forwarded by the shard supervisor. Ending the streams flushes the
+ * sinks, and the EOS reaching the bus then quits the main loop. */
+static gboolean
+shard_worker_stop (gpointer data)
+{
+  GstElement *pipeline = (GstElement *) data;
+
+  g_print ("Stop requested, sending EOS\n");
+  gst_element_send_event (pipeline, gst_event_new_eos ());
+  return G_SOURCE_REMOVE;
+}
+
 static gboolean
 bus_call (GstBus * bus, GstMessage * msg, gpointer data)
 {
-  GMainLoop *loop = (GMainLoop *) data;
+  BusCtx *ctx = (BusCtx *) data;
+  GMainLoop *loop = ctx->loop;
   switch (GST_MESSAGE_TYPE (msg)) {
     case GST_MESSAGE_EOS:
       g_print ("End of stream\n");
@@ -145,6 +180,9 @@ bus_call (GstBus * bus, GstMessage * msg, gpointer data)
         g_printerr ("Error details: %s\n", debug);
       g_free (debug);
       g_error_free (error);
+      if (ctx->source_health &&
+          source_health_handle_error (ctx->source_health, msg))
+        break;
       g_main_loop_quit (loop);
       break;
     }
@@ -172,6 +210,20 @@ typedef struct _perf_measure{
 	 guint count;
 }perf_measure;
 
+typedef struct _MetadataProbeCtx
+{
+  perf_measure *perf;
+  /* Set in a worker process of the sharded mode, records are then published
+   * to the supervisor instead of being written to the dump file. */
+  ShardWorker *shard_worker;
+  /* Records of the current batch and their consumer in the non sharded
+   * mode. */
+  FrameRecordBatch *batch;
+  MetadataSink *sink;
+  /* Receives the outlines of the objects of every frame, in both modes. */
+  Panorama *panorama;
+} MetadataProbeCtx;
+
 static void
 cb_newpad (GstElement * decodebin, GstPad * decoder_src_pad, gpointer data)
 {
@@ -357,29 +409,395 @@ create_source_bin (guint index, gchar * uri)
 
 
 
+/* The per source elements of one <uri> <source id> <config> triple, created
+ * before they are added to the pipeline. */
+typedef struct _SourceChain
+{
+  guint index;
+  gchar *uri;
+  guint source_id;
+  gchar *dewarper_config_file;
+  StartupProfile *profile;
+  GstElement *source_bin;
+  GstElement *nvvideoconvert;
+  GstElement *caps_filter;
+  GstElement *nvdewarper;
+} SourceChain;
+
+/* Creates the elements of a chain. Only touches the chain, so chains can be
+ * created on several threads; setting config-file is where nvdewarper
+ * parses its config. Elements that fail are left NULL. */
+static void
+create_source_chain (gpointer data, gpointer user_data)
+{
+  /* The nvdewarper plugin does not document its config parsing as thread
+   * safe, so only one chain parses at a time; the source bins, which take
+   * longer, are still created in parallel. */
+  static GMutex config_lock;
+  SourceChain *chain = (SourceChain *) data;
+  GstCaps *caps;
+
+  startup_profile_begin_source (chain->profile, chain->index);
+
+  chain->source_bin = create_source_bin (chain->index, chain->uri);
+  if (!chain->source_bin) {
+    g_printerr ("Failed to create source bin.\n");
+    return;
+  }
+
+  chain->nvvideoconvert = gst_element_factory_make ("nvvideoconvert", NULL);
+  if (!chain->nvvideoconvert) {
+    g_printerr ("Failed to create nvvideoconvert element.\n");
+    return;
+  }
+
+  chain->caps_filter = gst_element_factory_make ("capsfilter", NULL);
+  if (!chain->caps_filter) {
+    g_printerr ("Failed to create capsfilter element.\n");
+    return;
+  }
+
+  caps = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "RGBA",
+      NULL);
+  gst_caps_set_features (caps, 0,
+      gst_caps_features_new (MEMORY_FEATURES, NULL));
+  g_object_set (G_OBJECT (chain->caps_filter), "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  /* create nv dewarper element */
+  chain->nvdewarper = gst_element_factory_make ("nvdewarper", NULL);
+  if (!chain->nvdewarper) {
+    g_printerr ("Failed to create nvdewarper element.\n");
+    return;
+  }
+
+  g_mutex_lock (&config_lock);
+  g_object_set (G_OBJECT (chain->nvdewarper),
+      "config-file", chain->dewarper_config_file,
+      "source-id", chain->source_id, NULL);
+  g_mutex_unlock (&config_lock);
+
+  startup_profile_end_source (chain->profile, chain->index);
+}
+
+/* Creates all chains, on the [parallel-init] threads when enabled. Returns
+ * FALSE if an element of any chain could not be created. */
+static gboolean
+create_source_chains (SourceChain * chains, guint num_chains,
+    const ParallelInitConfig * config)
+{
+  GThreadPool *pool = NULL;
+  GError *error = NULL;
+  guint i;
+
+  if (config->enable && num_chains > 1) {
+    guint num_threads = config->num_threads ? config->num_threads :
+        g_get_num_processors ();
+
+    pool = g_thread_pool_new (create_source_chain, NULL,
+        MIN (num_threads, num_chains), FALSE, &error);
+    if (!pool) {
+      g_printerr ("Failed to start init threads, creating sources serially: "
+          "%s\n", error->message);
+      g_error_free (error);
+    }
+  }
+
+  for (i = 0; i < num_chains; i++) {
+    if (pool)
+      g_thread_pool_push (pool, &chains[i], NULL);
+    else
+      create_source_chain (&chains[i], NULL);
+  }
+  /* Waits for every chain. */
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 0; i < num_chains; i++) {
+    if (!chains[i].source_bin || !chains[i].nvvideoconvert ||
+        !chains[i].caps_filter || !chains[i].nvdewarper)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* Starting nvinfer builds or deserializes its engine and starting nvtracker
+ * loads its low level library, which takes seconds each. An ElementStart
+ * takes the element to PAUSED on its own, on a thread while main goes on
+ * building the pipeline. Its state stays locked so the pipeline state change
+ * neither starts it again nor stops it; element_start_release() hands it
+ * back to the pipeline. */
+typedef struct _ElementStart
+{
+  GstElement *element;
+  StartupProfile *profile;
+  StartupPhase phase;
+  GThread *thread;
+  GstStateChangeReturn ret;
+} ElementStart;
+
+static gpointer
+element_start_thread (gpointer data)
+{
+  ElementStart *start = (ElementStart *) data;
+
+  startup_profile_begin (start->profile, start->phase);
+  start->ret = gst_element_set_state (start->element, GST_STATE_PAUSED);
+  startup_profile_end (start->profile, start->phase);
+  return NULL;
+}
+
+static void
+element_start_begin (ElementStart * start, GstElement * element,
+    StartupProfile * profile, StartupPhase phase)
+{
+  start->element = element;
+  start->profile = profile;
+  start->phase = phase;
+  gst_element_set_locked_state (element, TRUE);
+  start->thread = g_thread_new ("element-start", element_start_thread, start);
+}
+
+/* Waits for the element to be started, FALSE if it failed. The main loop is
+ * not running yet, so the errors the element posted on the pipeline bus are
+ * printed here. */
+static gboolean
+element_start_join (ElementStart * start)
+{
+  GstMessage *msg;
+  GstBus *bus;
+
+  if (start->thread) {
+    g_thread_join (start->thread);
+    start->thread = NULL;
+  }
+  if (start->ret != GST_STATE_CHANGE_FAILURE)
+    return TRUE;
+
+  bus = gst_element_get_bus (start->element);
+  while (bus && (msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ERROR))) {
+    GError *error;
+    gchar *debug;
+
+    gst_message_parse_error (msg, &error, &debug);
+    g_printerr ("ERROR from element %s: %s\n",
+        GST_OBJECT_NAME (msg->src), error->message);
+    if (debug)
+      g_printerr ("Error details: %s\n", debug);
+    g_free (debug);
+    g_error_free (error);
+    gst_message_unref (msg);
+  }
+  if (bus)
+    gst_object_unref (bus);
+  return FALSE;
+}
+
+/* Lets the element follow the pipeline again, once it is set to playing. */
+static void
+element_start_release (ElementStart * start)
+{
+  if (!start->element)
+    return;
+  gst_element_set_locked_state (start->element, FALSE);
+  gst_element_sync_state_with_parent (start->element);
+}
+
+/* Creates the metadata sink and registers the dewarper config of every
+ * <uri> <source id> <config> triple of the command line with it. */
+static MetadataSink *
+create_metadata_sink (const AppConfig * app_config, gint argc, gchar ** argv)
+{
+  MetadataSink *sink = metadata_sink_new (app_config);
+  guint i, num_sources = (argc - 3) / 3;
+
+  if (!sink)
+    return NULL;
+
+  for (i = 0; i < num_sources; i++) {
+    if (!metadata_sink_add_camera (sink, i, argv[3 + i * 3 + 2],
+            MUXER_OUTPUT_WIDTH, MUXER_OUTPUT_HEIGHT)) {
+      metadata_sink_free (sink);
+      return NULL;
+    }
+  }
+  return sink;
+}
+
+/* Turns the frames of one batch into FrameRecords, published to the
+ * supervisor in a shard worker and handed to the metadata sink otherwise.
+ * Runs in the OSD probe and, on recorded metadata, in the replay. */
+static void
+process_batch_meta (MetadataProbeCtx * ctx, NvDsBatchMeta * batch_meta,
+    gint64 timestamp)
+{
+  NvDsFrameMeta *frame_meta = NULL;
+  NvDsMetaList *l_frame;
+
+  if (ctx->shard_worker) {
+    for (l_frame = batch_meta->frame_meta_list; l_frame; l_frame = l_frame->next) {
+      FrameRecord *record;
+
+      frame_meta = (NvDsFrameMeta *) l_frame->data;
+      if (frame_meta == NULL)
+        continue;
+
+      /* A full ring means the supervisor is behind, drop the frame rather
+       * than stalling the pipeline. */
+      record = shard_worker_reserve (ctx->shard_worker);
+      if (!record)
+        continue;
+      frame_record_fill (record, frame_meta, frame_number,
+          shard_worker_source_id (ctx->shard_worker, frame_meta->pad_index));
+      record->end_of_batch = (l_frame->next == NULL);
+      if (ctx->panorama)
+        panorama_add_frame (ctx->panorama, frame_meta->pad_index, record);
+      shard_worker_commit (ctx->shard_worker);
+    }
+    if (ctx->panorama)
+      panorama_end_batch (ctx->panorama);
+    frame_number++;
+    return;
+  }
+
+  ctx->batch->batch_num = frame_number;
+  ctx->batch->timestamp = timestamp;
+  ctx->batch->num_frames = 0;
+
+  for (l_frame = batch_meta->frame_meta_list; l_frame; l_frame = l_frame->next) {
+    FrameRecord *record;
+
+    frame_meta = (NvDsFrameMeta *) l_frame->data;
+
+    if (frame_meta == NULL) {
+      // Ignore Null frame meta.
+      continue;
+    }
+    
+    record = frame_record_batch_append (ctx->batch);
+    if (!record)
+      break;
+    frame_record_fill (record, frame_meta, frame_number,
+        frame_meta->pad_index);
+    if (ctx->panorama)
+      panorama_add_frame (ctx->panorama, frame_meta->pad_index, record);
+  }
+  if (ctx->batch->num_frames)
+    ctx->batch->storage[ctx->batch->num_frames - 1].end_of_batch = TRUE;
+  if (ctx->panorama)
+    panorama_end_batch (ctx->panorama);
+  
+  metadata_sink_process_batch (ctx->batch, ctx->sink);
+  frame_number++;
+}
+
+typedef struct _ReplayCtx
+{
+  MetadataProbeCtx probe;
+  /* Sized for the largest recorded batch on the first one. */
+  NvDsBatchMeta *batch_meta;
+} ReplayCtx;
+
+/* Rebuilds the NvDsBatchMeta nvtracker attached to a recorded batch and runs
+ * the probe code on it, so a replay exercises the same path as a live
+ * pipeline. */
+static void
+replay_batch (const FrameRecordBatch * batch, gpointer user_data)
+{
+  ReplayCtx *replay = (ReplayCtx *) user_data;
+  NvDsBatchMeta *batch_meta;
+  guint i, j;
+
+  if (!replay->batch_meta) {
+    replay->batch_meta = nvds_create_batch_meta (batch->max_frames);
+    replay->probe.batch = frame_record_batch_new (batch->max_frames, TRUE);
+  }
+  batch_meta = replay->batch_meta;
+  nvds_clear_frame_meta_list (batch_meta, batch_meta->frame_meta_list);
+
+  for (i = 0; i < batch->num_frames; i++) {
+    const FrameRecord *record = batch->frames[i];
+    NvDsFrameMeta *frame_meta = nvds_acquire_frame_meta_from_pool (batch_meta);
+
+    frame_meta->pad_index = record->source_id;
+    frame_meta->source_id = record->source_id;
+    frame_meta->batch_id = i;
+    frame_meta->buf_pts = record->pts;
+    frame_meta->frame_num = record->frame_num;
+    frame_meta->surface_type = record->surface_type;
+    frame_meta->surface_index = record->surface_index;
+
+    for (j = 0; j < record->num_objects; j++) {
+      const ObjectRecord *object = &record->objects[j];
+      NvDsObjectMeta *obj_meta = nvds_acquire_obj_meta_from_pool (batch_meta);
+
+      obj_meta->object_id = object->object_id;
+      obj_meta->class_id = object->class_id;
+      obj_meta->tracker_confidence = object->confidence;
+      obj_meta->tracker_bbox_info.org_bbox_coords.left = object->left;
+      obj_meta->tracker_bbox_info.org_bbox_coords.top = object->top;
+      obj_meta->tracker_bbox_info.org_bbox_coords.width = object->width;
+      obj_meta->tracker_bbox_info.org_bbox_coords.height = object->height;
+      g_strlcpy (obj_meta->obj_label, object->label, MAX_LABEL_SIZE);
+      nvds_add_obj_meta_to_frame (frame_meta, obj_meta, NULL);
+    }
+    nvds_add_frame_meta_to_batch (batch_meta, frame_meta);
+  }
+
+  process_batch_meta (&replay->probe, batch_meta, batch->timestamp);
+}
+
+static int
+run_metadata_replay (const AppConfig * app_config, gint argc, gchar ** argv)
+{
+  ReplayCtx replay = { { 0 } };
+  MetadataReplayStats stats;
+  gboolean ok;
+
+  replay.probe.sink = create_metadata_sink (app_config, argc, argv);
+  if (!replay.probe.sink)
+    return -1;
+
+  g_print ("Replaying %s\n", app_config->replay.file);
+  ok = metadata_replay_run (app_config->replay.file,
+      app_config->replay.realtime, app_config->replay.num_loops,
+      replay_batch, &replay, &stats);
+  metadata_sink_free (replay.probe.sink);
+  frame_record_batch_free (replay.probe.batch);
+  if (replay.batch_meta)
+    nvds_destroy_batch_meta (replay.batch_meta);
+  if (!ok)
+    return -1;
+
+  g_print ("Replayed %" G_GUINT64_FORMAT " batches, %" G_GUINT64_FORMAT
+      " frames, %" G_GUINT64_FORMAT " objects in %.3f s\n",
+      stats.num_batches, stats.num_frames, stats.num_objects,
+      stats.elapsed_usec / 1000000.0);
+  if (stats.elapsed_usec > 0)
+    g_print ("Throughput %.1f batches/s, %.1f ns/object\n",
+        stats.num_batches * 1000000.0 / stats.elapsed_usec,
+        stats.num_objects ?
+        stats.elapsed_usec * 1000.0 / stats.num_objects : 0.0);
+  return 0;
+}
+
 /* osd_sink_pad_buffer_probe  will extract metadata received on OSD sink pad
- * and dump bounding box data with tracking id added to a file*/
+ * and hand it to the metadata sink, which dumps bounding box data with
+ * tracking id added to a file*/
 
 static GstPadProbeReturn
 osd_sink_pad_buffer_probe_tracking (GstPad * pad, GstPadProbeInfo * info,
     gpointer u_data)
 {
   GstBuffer *buf = (GstBuffer *) info->data;
-  NvDsFrameMeta *frame_meta = NULL;
-  guint person_count = 0;
-  guint bag_count = 0;
-  guint face_count = 0;
-  
-  NvDsMetaList *l_frame, *l_obj;
 
-  gchar bbox_file[1024] = { 0 };
-  FILE *bbox_params_dump_file = NULL;
   GstClockTime now;
   
   
   NvDsBatchMeta *batch_meta = gst_buffer_get_nvds_batch_meta (buf);
   
-  perf_measure * perf = (perf_measure *)(u_data);
+  MetadataProbeCtx *ctx = (MetadataProbeCtx *) u_data;
+  perf_measure * perf = ctx->perf;
   
   now = g_get_monotonic_time();
 
@@ -401,66 +819,7 @@ osd_sink_pad_buffer_probe_tracking (GstPad * pad, GstPadProbeInfo * info,
     return GST_PAD_PROBE_OK;
   }
   
-  //gchar kitti_track_dir_path[50] = "/home/ds_root/peoplenet/saved_metadata/";
-  //NvDsFrameMeta *frame_meta = l_frame->data;
-  //guint stream_id = frame_meta->pad_index;
-  //g_snprintf (bbox_file, sizeof (bbox_file) - 1,
-  //    "%stracker_working_data.txt", kitti_track_dir_path);
-  g_snprintf (bbox_file, sizeof (bbox_file) - 1,
-      "metadata_dwarper.txt");
-  bbox_params_dump_file = fopen (bbox_file, "a");
-  //if (!bbox_params_dump_file)
-    //continue;
-   
-
-  for (l_frame = batch_meta->frame_meta_list; l_frame; l_frame = l_frame->next) {
-    frame_meta = (NvDsFrameMeta *) l_frame->data;
-
-    if (frame_meta == NULL) {
-      // Ignore Null frame meta.
-      continue;
-    }
-    
-
-    for (l_obj = frame_meta->obj_meta_list; l_obj; l_obj = l_obj->next) {
-      NvDsObjectMeta *obj_meta = (NvDsObjectMeta *) l_obj->data;
-
-      if (obj_meta == NULL) {
-        // Ignore Null object.
-        continue;
-      }
-
-     
-      if (obj_meta->class_id == PGIE_CLASS_ID_PERSON)
-        person_count++;
-      if (obj_meta->class_id == PGIE_CLASS_ID_BAG)
-        bag_count++;
-      if (obj_meta->class_id == PGIE_CLASS_ID_FACE)
-        face_count++;
-
-     
-      
-      float top = obj_meta->tracker_bbox_info.org_bbox_coords.top;//rect_params.top;
-      float left = obj_meta->tracker_bbox_info.org_bbox_coords.left;//rect_params.left;
-      float right = left + obj_meta->tracker_bbox_info.org_bbox_coords.width;//rect_params.width;
-      float bottom = top + obj_meta->tracker_bbox_info.org_bbox_coords.height;//rect_params.height;
-      float confidence = obj_meta->tracker_confidence; //confidence;
-      guint64 id = obj_meta->object_id;
-      fprintf (bbox_params_dump_file,
-          "%s %lu 0.0 0 0.0 %f %f %f %f 0.0 0.0 0.0 0.0 0.0 0.0 0.0 %f\n",
-          obj_meta->obj_label, id, left, top, right, bottom, confidence);
-      
-    }
-        
-    
-  }
-  
-  fprintf (bbox_params_dump_file,"Frame Number = %d People Count = %d Bag Count = %d Face Count = %d \n", frame_number, person_count, bag_count, face_count);
-  //g_print ("Frame Number = %d People Count = %d Bag Count = %d Face Count = %d \n",
-  //    frame_number, person_count, bag_count, face_count);
-  frame_number++;
-  fclose (bbox_params_dump_file);
-  
+  process_batch_meta (ctx, batch_meta, now);
 
   return GST_PAD_PROBE_OK;
 }
@@ -491,6 +850,20 @@ main (int argc, char *argv[])
   GstCapsFeatures *feature = NULL;
   GstPad *osd_sink_pad = NULL;
   perf_measure perf_measure;
+  AppConfig app_config;
+  BatchController *batch_controller = NULL;
+  ShardWorker *shard_worker = NULL;
+  MetadataProbeCtx *probe_ctx = NULL;
+  PipelineTrace *trace = NULL;
+  SourceHealth *source_health = NULL;
+  BusCtx bus_ctx;
+  gint64 start_time = g_get_monotonic_time ();
+  gint64 config_time;
+  StartupProfile *profile = NULL;
+  SourceChain *chains = NULL;
+  ElementStart infer_start = { 0 }, tracker_start = { 0 };
+  gboolean preload;
+  char name[300];
   
   //static guint i = 0;
  
@@ -500,16 +873,70 @@ main (int argc, char *argv[])
     g_printerr ("Usage: %s [1:file sink|2: fakesink|3:display sink] [1:no tracking| 2:tracking] <uri1> <source id1> [<uri2> <source id2>] ... [<uriN> <source idN>]\n", argv[0]); //TODO @mj: changed the Usage
     return -1;
   }
+
+  app_config_set_defaults (&app_config);
+  if (g_file_test (APP_CONFIG_FILE, G_FILE_TEST_EXISTS) &&
+      !parse_app_config (&app_config, APP_CONFIG_FILE)) {
+    g_printerr ("Failed to parse %s. Exiting.\n", APP_CONFIG_FILE);
+    return -1;
+  }
+  config_time = g_get_monotonic_time ();
+
+  /* A replay feeds a recording into the metadata stages, no pipeline. */
+  if (app_config.replay.enable) {
+    gint ret = run_metadata_replay (&app_config, argc, argv);
+    app_config_clear (&app_config);
+    return ret;
+  }
+
+  /* Workers are forked before GStreamer is initialized. The supervisor
+   * returns here only once every worker is done; a worker continues with
+   * argc/argv reduced to its own sources. */
+  if (app_config.sharding.enable) {
+    MetadataSink *sink = create_metadata_sink (&app_config, argc, argv);
+    gint ret;
+
+    if (!sink)
+      return -1;
+    ret = shard_supervisor_run (&app_config.sharding, &argc, &argv,
+        metadata_sink_process_batch, sink, &shard_worker);
+    if (!shard_worker) {
+      metadata_sink_free (sink);
+      app_config_clear (&app_config);
+      return ret;
+    }
+  }
+
   num_sources = (argc - 3) / 3; 
+
+  if (app_config.startup_profile.enable) {
+    profile = startup_profile_new (num_sources, start_time);
+    startup_profile_add_phase (profile, STARTUP_PHASE_APP_CONFIG, start_time,
+        config_time);
+  }
   
+  startup_profile_begin (profile, STARTUP_PHASE_GST_INIT);
   gst_init (&argc, &argv);
+  startup_profile_end (profile, STARTUP_PHASE_GST_INIT);
   loop = g_main_loop_new (NULL, FALSE);
 
   perf_measure.pre_time = GST_CLOCK_TIME_NONE;
   perf_measure.total_time = GST_CLOCK_TIME_NONE;
   perf_measure.count = 0;
 
+  probe_ctx = g_new0 (MetadataProbeCtx, 1);
+  probe_ctx->perf = &perf_measure;
+  probe_ctx->shard_worker = shard_worker;
+  if (!shard_worker) {
+    startup_profile_begin (profile, STARTUP_PHASE_METADATA_SINK);
+    probe_ctx->sink = create_metadata_sink (&app_config, argc, argv);
+    if (!probe_ctx->sink)
+      return -1;
+    startup_profile_end (profile, STARTUP_PHASE_METADATA_SINK);
+  }
+
   /* Create gstreamer elements */
+  startup_profile_begin (profile, STARTUP_PHASE_ELEMENTS);
   /* Create Pipeline element that will form a connection of other elements */
   pipeline = gst_pipeline_new ("dewarper-app-pipeline");
 
@@ -521,64 +948,148 @@ main (int argc, char *argv[])
     return -1;
   }
   gst_bin_add (GST_BIN (pipeline), streammux);
+  if (shard_worker)
+    g_unix_signal_add (SIGINT, shard_worker_stop, pipeline);
 
-  arg_index = 3;
-  
-  for (i = 0; i < num_sources; i++) {
-    guint source_id = 0;
+  /* Inference and tracker are created first so that their engine and
+   * library can load while the sources are set up. */
+  nvinfer = gst_element_factory_make ("nvinfer", NULL);
+  if (!nvinfer) {
+    g_printerr ("Failed to create nvinfer element. Exiting.\n");
+    return -1;
+  }
+  /*g_object_set (G_OBJECT (nvinfer), 
+    "tlt-encode-model", "/opt/nvidia/deepstream/deepstream-5.1/sources/apps/sample_apps/Deepstream-Dewarper-App/inference_files/resnet34_peoplenet_pruned.etlt", 
+    NULL);*/
+  //g_object_set (G_OBJECT (nvinfer), 
+  //  "model-engine-file", "/opt/nvidia/deepstream/deepstream-5.1/sources/apps/sample_apps/Deepstream-Dewarper-App/inference_files/resnet34_peoplenet_pruned.etlt_b1_gpu0_fp16.engine", 
+  //  NULL);
+  g_object_set (G_OBJECT (nvinfer), 
+    "config-file-path", "inference_files/config_infer_primary_peoplenet.txt", 
+    //"config-file-path", "/opt/nvidia/deepstream/deepstream-5.1/sources/apps/sample_apps/Deepstream-Dewarper-App/config_infer_primary_peoplenet.txt",
+    NULL);
 
-    GstPad *mux_sinkpad, *srcbin_srcpad, *dewarper_srcpad, *nvvideoconvert_sinkpad;
-    gchar pad_name[16] = { };
-    
-    g_printerr ("args1: %s",argv[arg_index] );
-    
-    GstElement *source_bin = create_source_bin (i, argv[arg_index++]);
-    g_printerr ("args2: %s",argv[arg_index] );
-    if (!source_bin) {
-      g_printerr ("Failed to create source bin. Exiting.\n");
-      return -1;
-    }
+  tracker = gst_element_factory_make ("nvtracker", "nvtracker"); 
+  startup_profile_end (profile, STARTUP_PHASE_ELEMENTS);
 
-    source_id = atoi(argv[arg_index++]);
+  startup_profile_begin (profile, STARTUP_PHASE_TRACKER_CONFIG);
+  snprintf(name, 300, "tracker_files/dstest_tracker_config.txt");
+  
+  
+  if(!set_tracker_properties(tracker, name)){
+	  g_printerr("Failed to set tracker properties. Exiting.\n");
+	  return -1; 
+  }
+  startup_profile_end (profile, STARTUP_PHASE_TRACKER_CONFIG);
+
+  /* Added before they are started so that their errors reach the pipeline
+   * bus. */
+  gst_bin_add_many (GST_BIN (pipeline), nvinfer, tracker, NULL);
+
+  /* Loading on threads overlaps with creating the sources. Without
+   * [parallel-init] they load when the pipeline starts, also when profiled. */
+  preload = app_config.parallel_init.enable;
+  if (preload) {
+    element_start_begin (&infer_start, nvinfer, profile,
+        STARTUP_PHASE_ENGINE_LOAD);
+    element_start_begin (&tracker_start, tracker, profile,
+        STARTUP_PHASE_TRACKER_LOAD);
+  }
 
-    /* create nv dewarper element */
-    nvvideoconvert = gst_element_factory_make ("nvvideoconvert", NULL);
-    if (!nvvideoconvert) {
-      g_printerr ("Failed to create nvvideoconvert element. Exiting.\n");
-      return -1;
+  if (app_config.streammux_control.enable)
+    batch_controller = batch_controller_new (streammux, num_sources,
+        MUXER_BATCH_TIMEOUT_USEC, &app_config.streammux_control);
+
+  if (app_config.trace.enable) {
+    /* Every worker writes its own trace. */
+    if (shard_worker) {
+      gchar *file = g_strdup_printf ("%s.%u", app_config.trace.file,
+          shard_worker->shard_index);
+      g_free (app_config.trace.file);
+      app_config.trace.file = file;
     }
+    trace = pipeline_trace_new (&app_config.trace);
+  }
 
-    caps_filter = gst_element_factory_make ("capsfilter", NULL);
-    if (!caps_filter) {
-      g_printerr ("Failed to create capsfilter element. Exiting.\n");
-      return -1;
+  if (app_config.source_reconnect.enable)
+    source_health = source_health_new (num_sources,
+        &app_config.source_reconnect);
+
+  if (app_config.panorama.enable) {
+    /* Worker source indices restart at 0, keep the files apart. */
+    if (shard_worker) {
+      gchar *file_prefix = g_strdup_printf ("%s.%u",
+          app_config.panorama.file_prefix, shard_worker->shard_index);
+      g_free (app_config.panorama.file_prefix);
+      app_config.panorama.file_prefix = file_prefix;
     }
+    probe_ctx->panorama = panorama_new (&app_config.panorama, num_sources);
+  }
 
-    GstCaps *caps = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "RGBA", NULL);
-    GstCapsFeatures *feature = gst_caps_features_new (MEMORY_FEATURES, NULL);
-    gst_caps_set_features (caps, 0, feature);
+  arg_index = 3;
 
-    g_object_set (G_OBJECT (caps_filter), "caps", caps, NULL);
+  chains = g_new0 (SourceChain, num_sources);
+  for (i = 0; i < num_sources; i++) {
+    chains[i].index = i;
+    chains[i].profile = profile;
+    chains[i].uri = argv[arg_index++];
+    chains[i].source_id = atoi(argv[arg_index++]);
+    chains[i].dewarper_config_file = argv[arg_index++];
+  }
+
+  startup_profile_begin (profile, STARTUP_PHASE_SOURCE_CHAINS);
+  if (!create_source_chains (chains, num_sources,
+          &app_config.parallel_init)) {
+    g_printerr ("Failed to create source chains. Exiting.\n");
+    return -1;
+  }
+  startup_profile_end (profile, STARTUP_PHASE_SOURCE_CHAINS);
+
+  startup_profile_begin (profile, STARTUP_PHASE_ASSEMBLY);
+  for (i = 0; i < num_sources; i++) {
+    GstPad *mux_sinkpad, *srcbin_srcpad, *dewarper_srcpad, *nvvideoconvert_sinkpad;
+    GstElement *tee = NULL;
+    GstElement *source_bin = chains[i].source_bin;
+    gchar pad_name[16] = { };
+    gchar *uri = chains[i].uri;
+    gchar *dewarper_config_file = chains[i].dewarper_config_file;
 
-    /* create nv dewarper element */
-    nvdewarper = gst_element_factory_make ("nvdewarper", NULL);
-    if (!nvdewarper) {
-      g_printerr ("Failed to create nvdewarper element. Exiting.\n");
+    nvvideoconvert = chains[i].nvvideoconvert;
+    caps_filter = chains[i].caps_filter;
+    nvdewarper = chains[i].nvdewarper;
+
+    if (source_health &&
+        !source_health_add_source (source_health, i, source_bin, uri)) {
+      g_printerr ("Failed to watch source %u. Exiting.\n", i);
       return -1;
     }
 
-    g_object_set (G_OBJECT (nvdewarper),
-      "config-file", argv[arg_index++],
-      "source-id", source_id,
-      NULL);
-
     gst_bin_add_many (GST_BIN (pipeline), source_bin, nvvideoconvert, caps_filter, nvdewarper, NULL);
 
-    if (!gst_element_link_many (nvvideoconvert, caps_filter, nvdewarper, NULL)) {
+    /* The panorama branch takes the fisheye frames before the dewarper. */
+    if (probe_ctx->panorama) {
+      tee = gst_element_factory_make ("tee", NULL);
+      if (!tee) {
+        g_printerr ("Failed to create tee element. Exiting.\n");
+        return -1;
+      }
+      gst_bin_add (GST_BIN (pipeline), tee);
+    }
+
+    if (!gst_element_link (nvvideoconvert, caps_filter) ||
+        (tee && !gst_element_link (caps_filter, tee)) ||
+        !gst_element_link (tee ? tee : caps_filter, nvdewarper)) {
       g_printerr ("Elements could not be linked. Exiting.\n");
       return -1;
     }
 
+    if (tee && !panorama_add_source (probe_ctx->panorama, i,
+            dewarper_config_file, MUXER_OUTPUT_WIDTH, MUXER_OUTPUT_HEIGHT,
+            pipeline, tee)) {
+      g_printerr ("Failed to add the panorama of source %u. Exiting.\n", i);
+      return -1;
+    }
+
     g_snprintf (pad_name, 15, "sink_%u", i);
     mux_sinkpad = gst_element_get_request_pad (streammux, pad_name);
     if (!mux_sinkpad) {
@@ -613,29 +1124,27 @@ main (int argc, char *argv[])
       g_printerr ("Failed to link source bin to stream muxer. Exiting.\n");
       return -1;
     }
+
+    if (batch_controller &&
+        !batch_controller_add_source (batch_controller, i, dewarper_srcpad)) {
+      g_printerr ("Failed to monitor source %u. Exiting.\n", i);
+      return -1;
+    }
+
+    if (trace) {
+      pipeline_trace_add_element (trace, nvvideoconvert, i);
+      pipeline_trace_add_element (trace, caps_filter, i);
+      pipeline_trace_add_element (trace, nvdewarper, i);
+    }
+
+    startup_profile_watch_source (profile, i, srcbin_srcpad, dewarper_srcpad);
                       
     gst_object_unref (srcbin_srcpad);
     gst_object_unref (mux_sinkpad);
     gst_object_unref (dewarper_srcpad);
     gst_object_unref (nvvideoconvert_sinkpad);
-    gst_caps_unref (caps);
-  }
-
-  nvinfer = gst_element_factory_make ("nvinfer", NULL);
-  if (!nvinfer) {
-    g_printerr ("Failed to create nvdewarper element. Exiting.\n");
-    return -1;
   }
-  /*g_object_set (G_OBJECT (nvinfer), 
-    "tlt-encode-model", "/opt/nvidia/deepstream/deepstream-5.1/sources/apps/sample_apps/Deepstream-Dewarper-App/inference_files/resnet34_peoplenet_pruned.etlt", 
-    NULL);*/
-  //g_object_set (G_OBJECT (nvinfer), 
-  //  "model-engine-file", "/opt/nvidia/deepstream/deepstream-5.1/sources/apps/sample_apps/Deepstream-Dewarper-App/inference_files/resnet34_peoplenet_pruned.etlt_b1_gpu0_fp16.engine", 
-  //  NULL);
-  g_object_set (G_OBJECT (nvinfer), 
-    "config-file-path", "inference_files/config_infer_primary_peoplenet.txt", 
-    //"config-file-path", "/opt/nvidia/deepstream/deepstream-5.1/sources/apps/sample_apps/Deepstream-Dewarper-App/config_infer_primary_peoplenet.txt",
-    NULL);
+  g_free (chains);
 
   /* Use nvtiler to composite the batched frames into a 2D tiled array based
    * on the source of the frames. */
@@ -651,7 +1160,6 @@ main (int argc, char *argv[])
  
 
   
-  tracker = gst_element_factory_make ("nvtracker", "nvtracker"); 
   queue1 = gst_element_factory_make ("queue", "queue1"); 
   queue2 = gst_element_factory_make ("queue", "queue2");  
 
@@ -691,6 +1199,15 @@ main (int argc, char *argv[])
   g_object_set (G_OBJECT (streammux),
       "batch-size", num_sources*max_surface_per_frame,
       "num-surfaces-per-frame", max_surface_per_frame, NULL);  
+  probe_ctx->batch = frame_record_batch_new (num_sources * max_surface_per_frame,
+      TRUE);
+
+  /* The controller only retunes batched-push-timeout; batch-size stays fixed
+   * as nvstreammux does not support changing it while playing. */
+  if (batch_controller && !batch_controller_start (batch_controller)) {
+    g_printerr ("Failed to start streammux controller. Exiting.\n");
+    return -1;
+  }
   //GstPad *demux_sinkpad;
   gchar pad_name_d[16] = { };
   g_snprintf (pad_name_d, 15, "sink");
@@ -705,28 +1222,26 @@ main (int argc, char *argv[])
   g_object_set (G_OBJECT (tiler), "rows", tiler_rows, "columns", tiler_columns,
       "width", TILED_OUTPUT_WIDTH, "height", TILED_OUTPUT_HEIGHT, NULL);
 
-  char name[300];
-  snprintf(name, 300, "tracker_files/dstest_tracker_config.txt");
-  
-  
-  if(!set_tracker_properties(tracker, name)){
-	  g_printerr("Failed to set tracker properties. Exiting.\n");
-	  return -1; 
-  }
-
-
   /* we add a message handler */
   bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
-  bus_watch_id = gst_bus_add_watch (bus, bus_call, loop);
+  bus_ctx.loop = loop;
+  bus_ctx.source_health = source_health;
+  bus_watch_id = gst_bus_add_watch (bus, bus_call, &bus_ctx);
   gst_object_unref (bus);
 
   /* Set up the pipeline */
   /* we add all elements into the pipeline */
 
+  if (preload && (!element_start_join (&infer_start) ||
+          !element_start_join (&tracker_start))) {
+    g_printerr ("Failed to start inference or tracker. Exiting.\n");
+    return -1;
+  }
+
   /* Set the pipeline the basic pipeline */
   nvvideoconvert = gst_element_factory_make("nvvideoconvert", NULL);
-  gst_bin_add_many (GST_BIN (pipeline), nvinfer,
-		  tracker,nvvideoconvert, nvosd, tiler, sink, NULL);
+  gst_bin_add_many (GST_BIN (pipeline), nvvideoconvert, nvosd, tiler, sink,
+      NULL);
 
   /* add the elements for sink type */
   
@@ -818,14 +1333,27 @@ main (int argc, char *argv[])
     g_print ("Unable to get sink pad\n");
   else if (atoi(argv[2]) == 1)
     gst_pad_add_probe (osd_sink_pad, GST_PAD_PROBE_TYPE_BUFFER,
-        osd_sink_pad_buffer_probe_tracking, &perf_measure, NULL);
+        osd_sink_pad_buffer_probe_tracking, probe_ctx, NULL);
   else if (atoi(argv[2]) == 2)
     gst_pad_add_probe (osd_sink_pad, GST_PAD_PROBE_TYPE_BUFFER,
-        osd_sink_pad_buffer_probe_tracking, &perf_measure, NULL);
+        osd_sink_pad_buffer_probe_tracking, probe_ctx, NULL);
   gst_object_unref (osd_sink_pad);
+
+  if (profile) {
+    GstPad *muxed_pad = gst_element_get_static_pad (streammux, "src");
+    GstPad *inferred_pad = gst_element_get_static_pad (nvinfer, "src");
+
+    startup_profile_watch_batches (profile, muxed_pad, inferred_pad);
+    gst_object_unref (muxed_pad);
+    gst_object_unref (inferred_pad);
+  }
   
   
 
+  /* Everything not traced per source works on streammux batches. */
+  if (trace)
+    pipeline_trace_add_bin (trace, GST_BIN (pipeline));
+
   g_print ("Now playing:");
    
 
@@ -837,7 +1365,16 @@ main (int argc, char *argv[])
   GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS (GST_BIN (pipeline),
                   GST_DEBUG_GRAPH_SHOW_ALL, "dewarper_test_playing");
 
+  startup_profile_end (profile, STARTUP_PHASE_ASSEMBLY);
+  startup_profile_begin (profile, STARTUP_PHASE_SET_PLAYING);
   gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  startup_profile_end (profile, STARTUP_PHASE_SET_PLAYING);
+  if (preload) {
+    element_start_release (&infer_start);
+    element_start_release (&tracker_start);
+  }
+  if (source_health)
+    source_health_start (source_health);
 
   /* Wait till pipeline encounters an error or EOS */
   g_print ("Running...\n");
@@ -849,9 +1386,30 @@ main (int argc, char *argv[])
   
   g_print ("Average fps %f\n",
       ((perf_measure.count-1)*1000000.0)/perf_measure.total_time);
+  if (batch_controller) {
+    batch_controller_print_stats (batch_controller);
+    batch_controller_free (batch_controller);
+  }
+  if (source_health) {
+    source_health_print_stats (source_health);
+    source_health_free (source_health);
+  }
+  if (probe_ctx->panorama) {
+    panorama_print_stats (probe_ctx->panorama);
+    panorama_free (probe_ctx->panorama);
+  }
+  if (trace)
+    pipeline_trace_write (trace);
+  startup_profile_print (profile);
   g_print ("Deleting pipeline\n");
   gst_object_unref (GST_OBJECT (pipeline));
+  pipeline_trace_free (trace);
+  startup_profile_free (profile);
   g_source_remove (bus_watch_id);
   g_main_loop_unref (loop);
+  metadata_sink_free (probe_ctx->sink);
+  frame_record_batch_free (probe_ctx->batch);
+  g_free (probe_ctx);
+  app_config_clear (&app_config);
   return 0;
 }
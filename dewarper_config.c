@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dewarper_config.h"
+
+#define CHECK_ERROR(error) \
+  if (error) { \
+    g_printerr ("Error while parsing config file: %s\n", error->message); \
+    goto done; \
+  }
+
+static gboolean
+parse_property (GKeyFile * key_file, DewarperConfig * config)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_DEWARPER_PROPERTY, NULL,
+      &error);
+  CHECK_ERROR (error);
+
+  /* nvdewarper knows more properties than the app needs, the rest are
+   * skipped. */
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_DEWARPER_OUTPUT_WIDTH)) {
+      config->output_width =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_DEWARPER_PROPERTY,
+          CONFIG_DEWARPER_OUTPUT_WIDTH, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_OUTPUT_HEIGHT)) {
+      config->output_height =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_DEWARPER_PROPERTY,
+          CONFIG_DEWARPER_OUTPUT_HEIGHT, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_NUM_BATCH_BUFFERS)) {
+      config->num_batch_buffers =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_DEWARPER_PROPERTY,
+          CONFIG_DEWARPER_NUM_BATCH_BUFFERS, &error);
+      CHECK_ERROR (error);
+    }
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static gboolean
+parse_surface (GKeyFile * key_file, const gchar * group,
+    DewarperSurfaceConfig * surface)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+
+  keys = g_key_file_get_keys (key_file, group, NULL, &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_DEWARPER_PROJECTION_TYPE)) {
+      surface->projection_type =
+          g_key_file_get_integer (key_file, group,
+          CONFIG_DEWARPER_PROJECTION_TYPE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_SURFACE_INDEX)) {
+      surface->surface_index =
+          g_key_file_get_integer (key_file, group,
+          CONFIG_DEWARPER_SURFACE_INDEX, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_WIDTH)) {
+      surface->width =
+          g_key_file_get_integer (key_file, group, CONFIG_DEWARPER_WIDTH,
+          &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_HEIGHT)) {
+      surface->height =
+          g_key_file_get_integer (key_file, group, CONFIG_DEWARPER_HEIGHT,
+          &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_TOP_ANGLE)) {
+      surface->top_angle =
+          g_key_file_get_double (key_file, group, CONFIG_DEWARPER_TOP_ANGLE,
+          &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_BOTTOM_ANGLE)) {
+      surface->bottom_angle =
+          g_key_file_get_double (key_file, group,
+          CONFIG_DEWARPER_BOTTOM_ANGLE, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_PITCH)) {
+      surface->pitch =
+          g_key_file_get_double (key_file, group, CONFIG_DEWARPER_PITCH,
+          &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_YAW)) {
+      surface->yaw =
+          g_key_file_get_double (key_file, group, CONFIG_DEWARPER_YAW,
+          &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_ROLL)) {
+      surface->roll =
+          g_key_file_get_double (key_file, group, CONFIG_DEWARPER_ROLL,
+          &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_FOCAL_LENGTH)) {
+      surface->focal_length =
+          g_key_file_get_double (key_file, group,
+          CONFIG_DEWARPER_FOCAL_LENGTH, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_ROT_AXES)) {
+      surface->rot_axes =
+          g_key_file_get_integer (key_file, group, CONFIG_DEWARPER_ROT_AXES,
+          &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_SRC_FOV)) {
+      surface->src_fov =
+          g_key_file_get_double (key_file, group, CONFIG_DEWARPER_SRC_FOV,
+          &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_DEWARPER_CONTROL)) {
+      surface->control =
+          g_key_file_get_double (key_file, group, CONFIG_DEWARPER_CONTROL,
+          &error);
+      CHECK_ERROR (error);
+    } else {
+      surface->num_unknown_keys++;
+    }
+  }
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  return ret;
+}
+
+static int
+compare_surfaces (const void *a, const void *b)
+{
+  const DewarperSurfaceConfig *sa = (const DewarperSurfaceConfig *) a;
+  const DewarperSurfaceConfig *sb = (const DewarperSurfaceConfig *) b;
+
+  return sa->group_number < sb->group_number ? -1 :
+      sa->group_number > sb->group_number;
+}
+
+gboolean
+parse_dewarper_config (DewarperConfig * config,
+    const gchar * config_file_name)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  GKeyFile *key_file = g_key_file_new ();
+  gchar **groups = NULL;
+  gchar **group = NULL;
+
+  memset (config, 0, sizeof (DewarperConfig));
+  config->num_batch_buffers = DEWARPER_DEFAULT_NUM_BATCH_BUFFERS;
+
+  if (!g_key_file_load_from_file (key_file, config_file_name, G_KEY_FILE_NONE,
+          &error)) {
+    g_printerr ("Failed to load config file: %s\n", error->message);
+    goto done;
+  }
+
+  if (g_key_file_has_group (key_file, CONFIG_GROUP_DEWARPER_PROPERTY) &&
+      !parse_property (key_file, config))
+    goto done;
+
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (group = groups; *group; group++) {
+    DewarperSurfaceConfig *surface;
+    guint group_number;
+    gchar tail;
+
+    if (sscanf (*group, CONFIG_GROUP_DEWARPER_SURFACE "%u%c", &group_number,
+            &tail) != 1)
+      continue;
+    if (config->num_surfaces == DEWARPER_CONFIG_MAX_SURFACES) {
+      config->num_ignored_surfaces++;
+      continue;
+    }
+
+    surface = &config->surfaces[config->num_surfaces];
+    surface->group_number = group_number;
+    if (!parse_surface (key_file, *group, surface))
+      goto done;
+    config->num_surfaces++;
+  }
+
+  qsort (config->surfaces, config->num_surfaces,
+      sizeof (DewarperSurfaceConfig), compare_surfaces);
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (groups) {
+    g_strfreev (groups);
+  }
+  g_key_file_free (key_file);
+  if (!ret) {
+    g_printerr ("%s failed for %s\n", __func__, config_file_name);
+  }
+  return ret;
+}
+
+gboolean
+dewarper_config_check_surface_indices (const DewarperConfig * config,
+    const gchar * config_file_name)
+{
+  gint group_of_index[DEWARPER_CONFIG_MAX_SURFACES];
+  gboolean ret = TRUE;
+  guint i;
+
+  for (i = 0; i < DEWARPER_CONFIG_MAX_SURFACES; i++)
+    group_of_index[i] = -1;
+
+  for (i = 0; i < config->num_surfaces; i++) {
+    const DewarperSurfaceConfig *surface = &config->surfaces[i];
+
+    if (surface->surface_index >= DEWARPER_CONFIG_MAX_SURFACES) {
+      g_printerr ("[surface%u] of %s: surface-index=%u is out of range\n",
+          surface->group_number, config_file_name, surface->surface_index);
+      ret = FALSE;
+    } else if (group_of_index[surface->surface_index] >= 0) {
+      g_printerr ("[surface%u] of %s: surface-index=%u is also used by "
+          "[surface%d]\n", surface->group_number, config_file_name,
+          surface->surface_index, group_of_index[surface->surface_index]);
+      ret = FALSE;
+    } else {
+      group_of_index[surface->surface_index] = surface->group_number;
+    }
+  }
+  return ret;
+}
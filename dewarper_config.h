@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __DEWARPER_CONFIG_H__
+#define __DEWARPER_CONFIG_H__
+
+#include <glib.h>
+
+/* Parser for the nvdewarper config files in dewarper_config_files/, for the
+ * parts of the app that need the surface geometry on the CPU. */
+
+#define CONFIG_GROUP_DEWARPER_PROPERTY "property"
+#define CONFIG_GROUP_DEWARPER_SURFACE "surface"
+#define CONFIG_DEWARPER_OUTPUT_WIDTH "output-width"
+#define CONFIG_DEWARPER_OUTPUT_HEIGHT "output-height"
+#define CONFIG_DEWARPER_NUM_BATCH_BUFFERS "num-batch-buffers"
+#define CONFIG_DEWARPER_PROJECTION_TYPE "projection-type"
+#define CONFIG_DEWARPER_SURFACE_INDEX "surface-index"
+#define CONFIG_DEWARPER_WIDTH "width"
+#define CONFIG_DEWARPER_HEIGHT "height"
+#define CONFIG_DEWARPER_TOP_ANGLE "top-angle"
+#define CONFIG_DEWARPER_BOTTOM_ANGLE "bottom-angle"
+#define CONFIG_DEWARPER_PITCH "pitch"
+#define CONFIG_DEWARPER_YAW "yaw"
+#define CONFIG_DEWARPER_ROLL "roll"
+#define CONFIG_DEWARPER_FOCAL_LENGTH "focal-length"
+#define CONFIG_DEWARPER_ROT_AXES "rot-axes"
+#define CONFIG_DEWARPER_SRC_FOV "src-fov"
+#define CONFIG_DEWARPER_CONTROL "control"
+
+/* More [surfaceN] groups than nvdewarper accepts are still parsed so that
+ * the config validator can report them. */
+#define DEWARPER_CONFIG_MAX_SURFACES 16
+
+/* Default of num-batch-buffers in nvdewarper. */
+#define DEWARPER_DEFAULT_NUM_BATCH_BUFFERS 4
+
+typedef struct _DewarperSurfaceConfig
+{
+  /* N of the [surfaceN] group. */
+  guint group_number;
+  guint projection_type;
+  guint surface_index;
+  guint width;
+  guint height;
+  /* Angles in degrees. */
+  gdouble top_angle;
+  gdouble bottom_angle;
+  gdouble pitch;
+  gdouble yaw;
+  gdouble roll;
+  /* Focal length of the source lens in pixels per radian. */
+  gdouble focal_length;
+  guint rot_axes;
+  gdouble src_fov;
+  gdouble control;
+  /* Keys of the group this parser does not know. */
+  guint num_unknown_keys;
+} DewarperSurfaceConfig;
+
+typedef struct _DewarperConfig
+{
+  guint output_width;
+  guint output_height;
+  guint num_batch_buffers;
+  /* Surfaces sorted by group number. Streammux reports the objects of a
+   * surface with its surface-index, not with its position here. */
+  guint num_surfaces;
+  DewarperSurfaceConfig surfaces[DEWARPER_CONFIG_MAX_SURFACES];
+  /* [surfaceN] groups beyond DEWARPER_CONFIG_MAX_SURFACES. */
+  guint num_ignored_surfaces;
+} DewarperConfig;
+
+gboolean parse_dewarper_config (DewarperConfig * config,
+    const gchar * config_file_name);
+
+/* Returns FALSE, after reporting the groups, if two surfaces share a
+ * surface-index or an index is DEWARPER_CONFIG_MAX_SURFACES or more, in which
+ * case objects can not be told apart by the surface they were found on. */
+gboolean dewarper_config_check_surface_indices (const DewarperConfig * config,
+    const gchar * config_file_name);
+
+#endif
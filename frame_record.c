@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+
+#include "frame_record.h"
+
+FrameRecordBatch *
+frame_record_batch_new (guint max_frames, gboolean with_storage)
+{
+  FrameRecordBatch *batch = g_new0 (FrameRecordBatch, 1);
+
+  batch->max_frames = max_frames;
+  batch->frames = g_new0 (const FrameRecord *, max_frames);
+  if (with_storage)
+    batch->storage = g_new0 (FrameRecord, max_frames);
+  return batch;
+}
+
+void
+frame_record_batch_free (FrameRecordBatch * batch)
+{
+  if (!batch)
+    return;
+  g_free (batch->frames);
+  g_free (batch->storage);
+  g_free (batch);
+}
+
+void
+frame_record_fill (FrameRecord * record, NvDsFrameMeta * frame_meta,
+    guint64 batch_num, guint source_id)
+{
+  NvDsMetaList *l_obj;
+
+  record->batch_num = batch_num;
+  record->pts = frame_meta->buf_pts;
+  record->source_id = source_id;
+  record->surface_index = frame_meta->surface_index;
+  record->surface_type = frame_meta->surface_type;
+  record->frame_num = frame_meta->frame_num;
+  record->end_of_batch = FALSE;
+  record->num_objects = 0;
+  record->num_truncated = 0;
+
+  for (l_obj = frame_meta->obj_meta_list; l_obj; l_obj = l_obj->next) {
+    NvDsObjectMeta *obj_meta = (NvDsObjectMeta *) l_obj->data;
+    ObjectRecord *object;
+
+    if (obj_meta == NULL) {
+      // Ignore Null object.
+      continue;
+    }
+    if (record->num_objects == FRAME_RECORD_MAX_OBJECTS) {
+      record->num_truncated++;
+      continue;
+    }
+
+    object = &record->objects[record->num_objects++];
+    object->object_id = obj_meta->object_id;
+    object->left = obj_meta->tracker_bbox_info.org_bbox_coords.left;
+    object->top = obj_meta->tracker_bbox_info.org_bbox_coords.top;
+    object->width = obj_meta->tracker_bbox_info.org_bbox_coords.width;
+    object->height = obj_meta->tracker_bbox_info.org_bbox_coords.height;
+    object->confidence = obj_meta->tracker_confidence;
+    object->class_id = obj_meta->class_id;
+    g_strlcpy (object->label, obj_meta->obj_label, OBJECT_RECORD_LABEL_LEN);
+  }
+}
+
+void
+frame_record_count_classes (const FrameRecord * record, guint * counts,
+    guint num_classes)
+{
+  guint i;
+
+  for (i = 0; i < record->num_objects; i++) {
+    gint class_id = record->objects[i].class_id;
+    if (class_id >= 0 && (guint) class_id < num_classes)
+      counts[class_id]++;
+  }
+}
+
+guint
+track_key_hash (gconstpointer key)
+{
+  const TrackKey *k = (const TrackKey *) key;
+  guint64 h = k->object_id * G_GUINT64_CONSTANT (0x9e3779b97f4a7c15);
+
+  h ^= ((guint64) k->source_id << 8 | k->surface_index) *
+      G_GUINT64_CONSTANT (0xc2b2ae3d27d4eb4f);
+  return (guint) (h ^ (h >> 32));
+}
+
+gboolean
+track_key_equal (gconstpointer a, gconstpointer b)
+{
+  const TrackKey *ka = (const TrackKey *) a;
+  const TrackKey *kb = (const TrackKey *) b;
+
+  return ka->object_id == kb->object_id && ka->source_id == kb->source_id &&
+      ka->surface_index == kb->surface_index;
+}
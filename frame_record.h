@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __FRAME_RECORD_H__
+#define __FRAME_RECORD_H__
+
+#include <glib.h>
+
+#include "gstnvdsmeta.h"
+
+/* Fixed size, pointer free copy of the per frame metadata the app consumes
+ * after nvinfer/nvtracker. Being fixed size it can be placed directly in a
+ * shared memory slot or written to a file. */
+
+#define FRAME_RECORD_MAX_OBJECTS 128
+#define OBJECT_RECORD_LABEL_LEN 16
+
+typedef struct _ObjectRecord
+{
+  guint64 object_id;
+  gfloat left;
+  gfloat top;
+  gfloat width;
+  gfloat height;
+  gfloat confidence;
+  gint class_id;
+  gchar label[OBJECT_RECORD_LABEL_LEN];
+} ObjectRecord;
+
+typedef struct _FrameRecord
+{
+  /* Sequence number of the batch the frame belonged to. */
+  guint64 batch_num;
+  guint64 pts;
+  /* Stream index in command line order. */
+  guint source_id;
+  guint surface_index;
+  guint surface_type;
+  gint frame_num;
+  /* Set on the last frame of a batch. */
+  gboolean end_of_batch;
+  guint num_objects;
+  /* Objects that did not fit in the record. */
+  guint num_truncated;
+  ObjectRecord objects[FRAME_RECORD_MAX_OBJECTS];
+} FrameRecord;
+
+/* The frames of one streammux batch. frames either points into the batch's
+ * own storage or directly at records owned by someone else, e.g. slots of a
+ * shared memory ring, so consumers never need to copy a record. */
+typedef struct _FrameRecordBatch
+{
+  guint64 batch_num;
+  /* Monotonic time in microseconds at which the batch was produced. */
+  gint64 timestamp;
+  guint num_frames;
+  guint max_frames;
+  const FrameRecord **frames;
+  FrameRecord *storage;
+} FrameRecordBatch;
+
+/* Identifies a tracker track: nvtracker numbers objects per surface stream. */
+typedef struct _TrackKey
+{
+  guint64 object_id;
+  guint source_id;
+  guint surface_index;
+} TrackKey;
+
+typedef void (*FrameRecordBatchFunc) (const FrameRecordBatch * batch,
+    gpointer user_data);
+
+FrameRecordBatch *frame_record_batch_new (guint max_frames,
+    gboolean with_storage);
+
+void frame_record_batch_free (FrameRecordBatch * batch);
+
+/* Returns the storage record for the next frame of a batch that owns its
+ * records, or NULL if the batch is full. */
+static inline FrameRecord *
+frame_record_batch_append (FrameRecordBatch * batch)
+{
+  FrameRecord *record;
+
+  if (batch->num_frames == batch->max_frames)
+    return NULL;
+  record = &batch->storage[batch->num_frames];
+  batch->frames[batch->num_frames++] = record;
+  return record;
+}
+
+/* Copies the tracker output of frame_meta into record. */
+void frame_record_fill (FrameRecord * record, NvDsFrameMeta * frame_meta,
+    guint64 batch_num, guint source_id);
+
+/* GHashFunc and GEqualFunc for TrackKey. */
+guint track_key_hash (gconstpointer key);
+
+gboolean track_key_equal (gconstpointer a, gconstpointer b);
+
+/* Adds the number of objects of class 0..num_classes-1 to counts. */
+void frame_record_count_classes (const FrameRecord * record, guint * counts,
+    guint num_classes);
+
+#endif
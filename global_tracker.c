@@ -0,0 +1,596 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "global_tracker.h"
+#include "projection.h"
+
+#define GLOBAL_TRACKER_BUFFER_SIZE (1 << 16)
+/* Number of hash buckets of the floor grid, a power of two. */
+#define GRID_BUCKETS 4096
+/* Foot points further away than this, in meters, are too close to the
+ * horizon to be placed on the floor reliably. */
+#define MAX_FLOOR_RANGE 50.0
+
+typedef struct _Camera
+{
+  /* Tracks of cameras with the same frame id share one floor plan. */
+  guint frame_id;
+  /* Camera frame to floor frame, row major, and the camera position. */
+  gdouble rotation[9];
+  gdouble position[3];
+  SurfaceSet surfaces;
+} Camera;
+
+typedef struct _GlobalTrack
+{
+  guint64 id;
+  guint frame_id;
+  gdouble x;
+  gdouble y;
+  /* Meters per microsecond. */
+  gdouble vx;
+  gdouble vy;
+  gint64 last_update;
+  /* Observations of the batch being processed. */
+  guint64 observed_batch;
+  /* view_key() of every surface that saw the track in the batch. */
+  GArray *observed_views;
+  guint num_observations;
+  gdouble sum_x;
+  gdouble sum_y;
+  /* Position compared against new tracks in this batch. */
+  gdouble match_x;
+  gdouble match_y;
+  /* Tracker tracks mapped to this id; it is only dropped at 0. */
+  guint num_locals;
+  gint grid_next;
+} GlobalTrack;
+
+typedef struct _LocalTrack
+{
+  TrackKey key;
+  GlobalTrack *global;
+  gint64 last_seen;
+} LocalTrack;
+
+typedef struct _PendingTrack
+{
+  TrackKey key;
+  guint frame_id;
+  gdouble x;
+  gdouble y;
+  guint64 view;
+  gboolean assigned;
+} PendingTrack;
+
+typedef struct _Candidate
+{
+  gdouble cost;
+  guint pending;
+  GlobalTrack *track;
+} Candidate;
+
+struct _GlobalTracker
+{
+  GlobalTrackingConfig config;
+  FILE *file;
+  /* Camera per stream index, NULL for streams without one. */
+  GPtrArray *cameras;
+  GHashTable *locals;
+  /* Live global tracks. */
+  GPtrArray *tracks;
+  /* Scratch arrays reused for every batch. */
+  GArray *pending;
+  GArray *candidates;
+  gint grid[GRID_BUCKETS];
+  guint64 next_id;
+  guint64 num_batches;
+  gint64 now;
+  /* Statistics printed at exit. */
+  guint64 num_objects;
+  guint64 num_unplaced;
+  guint64 num_new_ids;
+  guint64 num_joined;
+  guint64 num_dropped;
+};
+
+static void
+global_track_free (gpointer data)
+{
+  GlobalTrack *track = (GlobalTrack *) data;
+
+  g_array_free (track->observed_views, TRUE);
+  g_free (track);
+}
+
+GlobalTracker *
+global_tracker_new (const GlobalTrackingConfig * config)
+{
+  GlobalTracker *tracker;
+  FILE *file = fopen (config->file, "w");
+
+  if (!file) {
+    g_printerr ("Failed to open %s\n", config->file);
+    return NULL;
+  }
+  setvbuf (file, NULL, _IOFBF, GLOBAL_TRACKER_BUFFER_SIZE);
+
+  tracker = g_new0 (GlobalTracker, 1);
+  tracker->file = file;
+  tracker->config = *config;
+  tracker->config.file = NULL;
+  tracker->config.camera_poses = g_new (CameraPoseConfig,
+      config->num_camera_poses);
+  memcpy (tracker->config.camera_poses, config->camera_poses,
+      config->num_camera_poses * sizeof (CameraPoseConfig));
+  tracker->cameras = g_ptr_array_new_with_free_func (g_free);
+  tracker->locals = g_hash_table_new_full (track_key_hash, track_key_equal,
+      NULL, g_free);
+  tracker->tracks = g_ptr_array_new_with_free_func (global_track_free);
+  tracker->pending = g_array_new (FALSE, FALSE, sizeof (PendingTrack));
+  tracker->candidates = g_array_new (FALSE, FALSE, sizeof (Candidate));
+  tracker->next_id = 1;
+  return tracker;
+}
+
+/* Camera looking straight down for yaw = tilt = 0, with the image x axis
+ * along the floor x axis. */
+static void
+camera_set_pose (Camera * camera, gdouble x, gdouble y, gdouble height,
+    gdouble yaw, gdouble tilt)
+{
+  gdouble cz = cos (yaw * G_PI / 180.0);
+  gdouble sz = sin (yaw * G_PI / 180.0);
+  gdouble ct = cos (tilt * G_PI / 180.0);
+  gdouble st = sin (tilt * G_PI / 180.0);
+  gdouble rotation[9] = {
+    cz, sz * ct, -sz * st,
+    sz, -cz * ct, cz * st,
+    0, -st, -ct
+  };
+
+  memcpy (camera->rotation, rotation, sizeof (rotation));
+  camera->position[0] = x;
+  camera->position[1] = y;
+  camera->position[2] = height;
+}
+
+gboolean
+global_tracker_add_camera (GlobalTracker * tracker, guint source_id,
+    const gchar * dewarper_config_file, guint frame_width,
+    guint frame_height)
+{
+  Camera *camera = g_new0 (Camera, 1);
+  guint i;
+
+  if (!surface_set_load (&camera->surfaces, dewarper_config_file, frame_width,
+          frame_height)) {
+    g_free (camera);
+    return FALSE;
+  }
+
+  /* Frame 0 is the shared floor plan. */
+  camera->frame_id = source_id + 1;
+  camera_set_pose (camera, 0, 0, tracker->config.camera_height, 0, 0);
+  for (i = 0; i < tracker->config.num_camera_poses; i++) {
+    const CameraPoseConfig *pose = &tracker->config.camera_poses[i];
+
+    if (pose->source_id == source_id) {
+      camera->frame_id = 0;
+      camera_set_pose (camera, pose->x, pose->y, pose->height, pose->yaw,
+          pose->tilt);
+    }
+  }
+
+  if (tracker->cameras->len <= source_id)
+    g_ptr_array_set_size (tracker->cameras, source_id + 1);
+  g_free (g_ptr_array_index (tracker->cameras, source_id));
+  g_ptr_array_index (tracker->cameras, source_id) = camera;
+  return TRUE;
+}
+
+/* Places the foot point of object on the floor. */
+static gboolean
+place_object (const Camera * camera, guint surface_index,
+    const ObjectRecord * object, gdouble * x, gdouble * y)
+{
+  gdouble ray[3], floor_ray[3];
+  gdouble t;
+  guint i;
+
+  if (!surface_set_point_to_ray (&camera->surfaces, surface_index,
+          object->left + object->width / 2, object->top + object->height,
+          ray))
+    return FALSE;
+
+  for (i = 0; i < 3; i++)
+    floor_ray[i] = camera->rotation[i * 3] * ray[0] +
+        camera->rotation[i * 3 + 1] * ray[1] +
+        camera->rotation[i * 3 + 2] * ray[2];
+  if (floor_ray[2] > -1e-6)
+    return FALSE;
+
+  t = -camera->position[2] / floor_ray[2];
+  if (t * sqrt (floor_ray[0] * floor_ray[0] + floor_ray[1] * floor_ray[1]) >
+      MAX_FLOOR_RANGE)
+    return FALSE;
+  *x = camera->position[0] + t * floor_ray[0];
+  *y = camera->position[1] + t * floor_ray[1];
+  return TRUE;
+}
+
+static inline guint64
+view_key (guint source_id, guint surface_index)
+{
+  return ((guint64) source_id << 32) | surface_index;
+}
+
+static gboolean
+observed_from (const GlobalTracker * tracker, const GlobalTrack * track,
+    guint64 view)
+{
+  guint i;
+
+  if (track->observed_batch != tracker->num_batches)
+    return FALSE;
+  for (i = 0; i < track->observed_views->len; i++) {
+    if (g_array_index (track->observed_views, guint64, i) == view)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static void
+observe (GlobalTracker * tracker, GlobalTrack * track, gdouble x, gdouble y,
+    guint64 view)
+{
+  if (track->observed_batch != tracker->num_batches) {
+    track->observed_batch = tracker->num_batches;
+    g_array_set_size (track->observed_views, 0);
+    track->num_observations = 0;
+    track->sum_x = track->sum_y = 0;
+  }
+  if (!observed_from (tracker, track, view))
+    g_array_append_val (track->observed_views, view);
+  track->num_observations++;
+  track->sum_x += x;
+  track->sum_y += y;
+}
+
+static inline guint
+grid_bucket (guint frame_id, gint cell_x, gint cell_y)
+{
+  guint h = (guint) cell_x * 73856093u ^ (guint) cell_y * 19349663u ^
+      frame_id * 83492791u;
+
+  return h & (GRID_BUCKETS - 1);
+}
+
+static inline gint
+grid_cell (const GlobalTracker * tracker, gdouble coordinate)
+{
+  return (gint) floor (coordinate / tracker->config.gate_radius);
+}
+
+static void
+build_grid (GlobalTracker * tracker)
+{
+  guint i;
+
+  for (i = 0; i < GRID_BUCKETS; i++)
+    tracker->grid[i] = -1;
+
+  for (i = 0; i < tracker->tracks->len; i++) {
+    GlobalTrack *track = g_ptr_array_index (tracker->tracks, i);
+    gdouble dt = tracker->now - track->last_update;
+    guint bucket;
+
+    if (track->observed_batch == tracker->num_batches) {
+      track->match_x = track->sum_x / track->num_observations;
+      track->match_y = track->sum_y / track->num_observations;
+    } else {
+      track->match_x = track->x + track->vx * dt;
+      track->match_y = track->y + track->vy * dt;
+    }
+
+    bucket = grid_bucket (track->frame_id, grid_cell (tracker, track->match_x),
+        grid_cell (tracker, track->match_y));
+    track->grid_next = tracker->grid[bucket];
+    tracker->grid[bucket] = i;
+  }
+}
+
+static void
+find_candidates (GlobalTracker * tracker, guint pending_index)
+{
+  const PendingTrack *pending = &g_array_index (tracker->pending,
+      PendingTrack, pending_index);
+  gint cell_x = grid_cell (tracker, pending->x);
+  gint cell_y = grid_cell (tracker, pending->y);
+  guint visited[9];
+  gint dx, dy;
+  guint num_visited = 0;
+
+  for (dx = -1; dx <= 1; dx++) {
+    for (dy = -1; dy <= 1; dy++) {
+      guint bucket = grid_bucket (pending->frame_id, cell_x + dx,
+          cell_y + dy);
+      gint i;
+      guint j;
+
+      /* Neighbouring cells may share a bucket. */
+      for (j = 0; j < num_visited && visited[j] != bucket; j++);
+      if (j < num_visited)
+        continue;
+      visited[num_visited++] = bucket;
+
+      for (i = tracker->grid[bucket]; i >= 0;) {
+        GlobalTrack *track = g_ptr_array_index (tracker->tracks, i);
+        Candidate candidate;
+
+        i = track->grid_next;
+        if (track->frame_id != pending->frame_id)
+          continue;
+        candidate.cost = hypot (pending->x - track->match_x,
+            pending->y - track->match_y);
+        if (candidate.cost > tracker->config.gate_radius)
+          continue;
+        candidate.pending = pending_index;
+        candidate.track = track;
+        g_array_append_val (tracker->candidates, candidate);
+      }
+    }
+  }
+}
+
+static gint
+compare_candidates (gconstpointer a, gconstpointer b)
+{
+  const Candidate *ca = (const Candidate *) a;
+  const Candidate *cb = (const Candidate *) b;
+
+  return ca->cost < cb->cost ? -1 : ca->cost > cb->cost;
+}
+
+static void
+add_local (GlobalTracker * tracker, const PendingTrack * pending,
+    GlobalTrack * track, guint64 batch_num, gchar type)
+{
+  LocalTrack *local = g_new0 (LocalTrack, 1);
+
+  local->key = pending->key;
+  local->global = track;
+  local->last_seen = tracker->now;
+  track->num_locals++;
+  g_hash_table_insert (tracker->locals, &local->key, local);
+  observe (tracker, track, pending->x, pending->y, pending->view);
+
+  fprintf (tracker->file, "%c %" G_GUINT64_FORMAT " %u %u %" G_GUINT64_FORMAT
+      " %" G_GUINT64_FORMAT " %.2f %.2f\n", type, batch_num,
+      pending->key.source_id, pending->key.surface_index,
+      pending->key.object_id, track->id, pending->x, pending->y);
+}
+
+static void
+associate (GlobalTracker * tracker, guint64 batch_num)
+{
+  guint i;
+
+  g_array_set_size (tracker->candidates, 0);
+  build_grid (tracker);
+  for (i = 0; i < tracker->pending->len; i++)
+    find_candidates (tracker, i);
+
+  /* Greedy: cheapest pairs first, one track per surface and batch. */
+  g_array_sort (tracker->candidates, compare_candidates);
+  for (i = 0; i < tracker->candidates->len; i++) {
+    Candidate *candidate = &g_array_index (tracker->candidates, Candidate, i);
+    PendingTrack *pending = &g_array_index (tracker->pending, PendingTrack,
+        candidate->pending);
+    GlobalTrack *track = candidate->track;
+
+    if (pending->assigned)
+      continue;
+    if (observed_from (tracker, track, pending->view))
+      continue;
+    pending->assigned = TRUE;
+    add_local (tracker, pending, track, batch_num, 'M');
+    tracker->num_joined++;
+  }
+
+  for (i = 0; i < tracker->pending->len; i++) {
+    PendingTrack *pending = &g_array_index (tracker->pending, PendingTrack, i);
+    GlobalTrack *track;
+
+    if (pending->assigned)
+      continue;
+    track = g_new0 (GlobalTrack, 1);
+    track->observed_views = g_array_new (FALSE, FALSE, sizeof (guint64));
+    track->id = tracker->next_id++;
+    track->frame_id = pending->frame_id;
+    track->x = pending->x;
+    track->y = pending->y;
+    track->last_update = tracker->now;
+    g_ptr_array_add (tracker->tracks, track);
+    add_local (tracker, pending, track, batch_num, 'N');
+    tracker->num_new_ids++;
+  }
+}
+
+static void
+update_tracks (GlobalTracker * tracker)
+{
+  gdouble alpha = tracker->config.velocity_smoothing;
+  guint i;
+
+  for (i = 0; i < tracker->tracks->len; i++) {
+    GlobalTrack *track = g_ptr_array_index (tracker->tracks, i);
+    gdouble dt = tracker->now - track->last_update;
+    gdouble x, y;
+
+    if (track->observed_batch != tracker->num_batches)
+      continue;
+    x = track->sum_x / track->num_observations;
+    y = track->sum_y / track->num_observations;
+    if (dt > 0) {
+      track->vx = alpha * (x - track->x) / dt + (1 - alpha) * track->vx;
+      track->vy = alpha * (y - track->y) / dt + (1 - alpha) * track->vy;
+    }
+    track->x = x;
+    track->y = y;
+    track->last_update = tracker->now;
+  }
+}
+
+/* Drops the tracks not seen for max-age-msec, or all tracks. */
+static void
+expire (GlobalTracker * tracker, guint64 batch_num, gboolean all)
+{
+  gint64 max_age = (gint64) tracker->config.max_age_msec * 1000;
+  GHashTableIter iter;
+  gpointer value;
+  guint i;
+
+  g_hash_table_iter_init (&iter, tracker->locals);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    LocalTrack *local = (LocalTrack *) value;
+
+    if (all || tracker->now - local->last_seen > max_age) {
+      local->global->num_locals--;
+      g_hash_table_iter_remove (&iter);
+    }
+  }
+
+  /* Dropped ids are swapped with the last entry to keep the table dense. */
+  for (i = tracker->tracks->len; i-- > 0;) {
+    GlobalTrack *track = g_ptr_array_index (tracker->tracks, i);
+
+    if (track->num_locals == 0 &&
+        (all || tracker->now - track->last_update > max_age)) {
+      fprintf (tracker->file, "X %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT
+          "\n", batch_num, track->id);
+      g_ptr_array_remove_index_fast (tracker->tracks, i);
+      tracker->num_dropped++;
+    }
+  }
+}
+
+gboolean
+global_tracker_process_batch (GlobalTracker * tracker,
+    const FrameRecordBatch * batch)
+{
+  gint64 max_age = (gint64) tracker->config.max_age_msec * 1000;
+  guint i, j;
+
+  /* A replay loop starts over in time; tracks of the previous loop end. */
+  if (batch->timestamp + max_age < tracker->now) {
+    expire (tracker, batch->batch_num, TRUE);
+    tracker->now = batch->timestamp;
+  }
+  tracker->now = MAX (tracker->now, batch->timestamp);
+  expire (tracker, batch->batch_num, FALSE);
+
+  g_array_set_size (tracker->pending, 0);
+  for (i = 0; i < batch->num_frames; i++) {
+    const FrameRecord *record = batch->frames[i];
+    const Camera *camera = record->source_id < tracker->cameras->len ?
+        g_ptr_array_index (tracker->cameras, record->source_id) : NULL;
+
+    for (j = 0; j < record->num_objects; j++) {
+      const ObjectRecord *object = &record->objects[j];
+      PendingTrack pending;
+      LocalTrack *local;
+
+      if (object->object_id == UNTRACKED_OBJECT_ID)
+        continue;
+      tracker->num_objects++;
+      if (!camera || !place_object (camera, record->surface_index, object,
+              &pending.x, &pending.y)) {
+        tracker->num_unplaced++;
+        continue;
+      }
+
+      pending.key.object_id = object->object_id;
+      pending.key.source_id = record->source_id;
+      pending.key.surface_index = record->surface_index;
+      pending.view = view_key (record->source_id, record->surface_index);
+
+      local = (LocalTrack *) g_hash_table_lookup (tracker->locals,
+          &pending.key);
+      if (local) {
+        local->last_seen = tracker->now;
+        observe (tracker, local->global, pending.x, pending.y, pending.view);
+        continue;
+      }
+
+      pending.frame_id = camera->frame_id;
+      pending.assigned = FALSE;
+      g_array_append_val (tracker->pending, pending);
+    }
+  }
+
+  if (tracker->pending->len)
+    associate (tracker, batch->batch_num);
+  update_tracks (tracker);
+  tracker->num_batches++;
+
+  return !ferror (tracker->file);
+}
+
+guint64
+global_tracker_lookup (GlobalTracker * tracker, const TrackKey * key)
+{
+  LocalTrack *local = (LocalTrack *) g_hash_table_lookup (tracker->locals,
+      key);
+
+  return local ? local->global->id : 0;
+}
+
+void
+global_tracker_print_stats (GlobalTracker * tracker)
+{
+  g_print ("Global tracking: %" G_GUINT64_FORMAT " tracked objects, %"
+      G_GUINT64_FORMAT " not placed on the floor, %" G_GUINT64_FORMAT
+      " global ids, %" G_GUINT64_FORMAT " tracker tracks joined an existing"
+      " id, %u ids live\n", tracker->num_objects, tracker->num_unplaced,
+      tracker->num_new_ids, tracker->num_joined, tracker->tracks->len);
+}
+
+void
+global_tracker_free (GlobalTracker * tracker)
+{
+  if (!tracker)
+    return;
+  g_hash_table_destroy (tracker->locals);
+  g_ptr_array_free (tracker->tracks, TRUE);
+  g_ptr_array_free (tracker->cameras, TRUE);
+  g_array_free (tracker->pending, TRUE);
+  g_array_free (tracker->candidates, TRUE);
+  g_free (tracker->config.camera_poses);
+  fclose (tracker->file);
+  g_free (tracker);
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GLOBAL_TRACKER_H__
+#define __GLOBAL_TRACKER_H__
+
+#include <glib.h>
+#include <stdio.h>
+
+#include "app_config.h"
+#include "frame_record.h"
+
+/* Unifies nvtracker tracks, which are numbered per surface stream, into
+ * global identities. The foot point of every tracked box is mapped through
+ * the surface projection of its dewarper config onto the floor of the
+ * camera, and onto a shared floor plan for cameras with a configured pose.
+ * A track the tracker just started joins the global track whose constant
+ * velocity prediction is closest, if it is within the gate radius and not
+ * already observed from the same surface; otherwise it gets a new global
+ * id. Candidates come from a uniform grid over the floor, so association
+ * does not depend on the total number of tracks.
+ *
+ * Every assignment is written to the configured file:
+ *   N <batch> <source> <surface> <object id> <global id> <x> <y>   new global id
+ *   M <batch> <source> <surface> <object id> <global id> <x> <y>   joined one
+ *   X <batch> <global id>                                           id dropped
+ * Dropped ids are removed from the table, which stays dense. */
+
+typedef struct _GlobalTracker GlobalTracker;
+
+GlobalTracker *global_tracker_new (const GlobalTrackingConfig * config);
+
+/* Loads the surfaces of the stream source_id from its dewarper config.
+ * frame_width and frame_height are the streammux resolution the object
+ * coordinates refer to. */
+gboolean global_tracker_add_camera (GlobalTracker * tracker, guint source_id,
+    const gchar * dewarper_config_file, guint frame_width,
+    guint frame_height);
+
+gboolean global_tracker_process_batch (GlobalTracker * tracker,
+    const FrameRecordBatch * batch);
+
+/* Returns the global id of a track, 0 if it has none. */
+guint64 global_tracker_lookup (GlobalTracker * tracker, const TrackKey * key);
+
+void global_tracker_print_stats (GlobalTracker * tracker);
+
+void global_tracker_free (GlobalTracker * tracker);
+
+#endif
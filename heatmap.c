@@ -0,0 +1,444 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "heatmap.h"
+#include "projection.h"
+
+#define HEATMAP_BUFFER_SIZE (1 << 16)
+/* Cells per vector. The GCC vector extension compiles the cell loops to
+ * SSE2 on x86_64 and NEON on aarch64. */
+#define LANES 4
+/* Fractional bits of a cell value, the center of a footprint adds 1.0. The
+ * 20 integer bits left hold about 80 people standing in one cell for a
+ * whole 300 s half-life at 30 fps. */
+#define WEIGHT_BITS 12
+#define DECAY_BITS 16
+/* Footprints wider than this, in cells, are clamped. */
+#define MAX_RADIUS 16
+/* Unused cells around the grid, so footprints at the border need no
+ * clipping. A multiple of LANES. */
+#define MARGIN 16
+
+typedef guint32 CellVector
+    __attribute__ ((vector_size (LANES * sizeof (guint32))));
+
+/* Footprint weights of one radius, starting phase cells into a vector. */
+typedef struct _Kernel
+{
+  guint num_rows;
+  guint num_vectors;
+  CellVector *rows;
+} Kernel;
+
+typedef struct _HeatmapCamera
+{
+  guint source_id;
+  SurfaceSet surfaces;
+  gdouble src_fov;
+  /* Cells per radian of the equidistant grid. */
+  gdouble grid_focal;
+  /* num_rows rows of stride vectors, including the margin. */
+  CellVector *cells;
+} HeatmapCamera;
+
+struct _Heatmap
+{
+  HeatmapConfig config;
+  FILE *file;
+  /* Camera per stream index, NULL for streams without one. */
+  GPtrArray *cameras;
+  guint stride;
+  guint num_rows;
+  Kernel kernels[MAX_RADIUS + 1][LANES];
+  guint16 *snapshot;
+  gboolean started;
+  gint64 now;
+  gint64 last_decay;
+  gint64 last_snapshot;
+  guint64 batch_num;
+  /* Statistics printed at exit. */
+  guint64 num_objects;
+  guint64 num_unplaced;
+  guint64 num_decays;
+  guint64 num_snapshots;
+};
+
+static void
+kernel_init (Kernel * kernel, guint radius, guint phase)
+{
+  guint size = 2 * radius + 1;
+  guint x, y;
+
+  kernel->num_rows = size;
+  kernel->num_vectors = (phase + size + LANES - 1) / LANES;
+  kernel->rows = g_new0 (CellVector, kernel->num_rows * kernel->num_vectors);
+
+  /* Cone falling off to 1 / (radius + 1) at the footprint edge. */
+  for (y = 0; y < size; y++) {
+    guint32 *row = (guint32 *) & kernel->rows[y * kernel->num_vectors];
+
+    for (x = 0; x < size; x++) {
+      gdouble dx = (gdouble) x - radius;
+      gdouble dy = (gdouble) y - radius;
+      gdouble d = sqrt (dx * dx + dy * dy);
+
+      if (d <= radius + 0.5)
+        row[phase + x] = (guint32) MAX (0.0,
+            (1 << WEIGHT_BITS) * (1 - d / (radius + 1)) + 0.5);
+    }
+  }
+}
+
+Heatmap *
+heatmap_new (const HeatmapConfig * config)
+{
+  Heatmap *heatmap;
+  FILE *file = fopen (config->file, "wb");
+  guint radius, phase;
+
+  if (!file) {
+    g_printerr ("Failed to open %s\n", config->file);
+    return NULL;
+  }
+  setvbuf (file, NULL, _IOFBF, HEATMAP_BUFFER_SIZE);
+
+  heatmap = g_new0 (Heatmap, 1);
+  heatmap->file = file;
+  heatmap->config = *config;
+  heatmap->config.file = NULL;
+  heatmap->cameras = g_ptr_array_new ();
+  heatmap->stride = (config->grid_size + 2 * MARGIN) / LANES;
+  heatmap->num_rows = config->grid_size + 2 * MARGIN;
+  heatmap->snapshot = g_new (guint16, config->grid_size * config->grid_size);
+  for (radius = 0; radius <= MAX_RADIUS; radius++)
+    for (phase = 0; phase < LANES; phase++)
+      kernel_init (&heatmap->kernels[radius][phase], radius, phase);
+  return heatmap;
+}
+
+static void
+camera_free (HeatmapCamera * camera)
+{
+  if (!camera)
+    return;
+  g_free (camera->cells);
+  g_free (camera);
+}
+
+gboolean
+heatmap_add_camera (Heatmap * heatmap, guint source_id,
+    const gchar * dewarper_config_file, guint frame_width,
+    guint frame_height)
+{
+  HeatmapCamera *camera = g_new0 (HeatmapCamera, 1);
+
+  if (!surface_set_load (&camera->surfaces, dewarper_config_file, frame_width,
+          frame_height)) {
+    g_free (camera);
+    return FALSE;
+  }
+
+  camera->source_id = source_id;
+  camera->src_fov = camera->surfaces.src_fov;
+  camera->grid_focal = heatmap->config.grid_size /
+      (camera->src_fov * G_PI / 180.0);
+  /* g_new is 16 byte aligned on the 64 bit targets of DeepStream. */
+  camera->cells = g_new0 (CellVector, heatmap->num_rows * heatmap->stride);
+
+  if (heatmap->cameras->len <= source_id)
+    g_ptr_array_set_size (heatmap->cameras, source_id + 1);
+  camera_free (g_ptr_array_index (heatmap->cameras, source_id));
+  g_ptr_array_index (heatmap->cameras, source_id) = camera;
+  return TRUE;
+}
+
+/* Maps point (x, y) of a surface, in streammux coordinates, to the grid. */
+static gboolean
+point_to_cell (const HeatmapCamera * camera, guint surface_index, gdouble x,
+    gdouble y, gdouble grid_size, gdouble * u, gdouble * v)
+{
+  gdouble ray[3];
+
+  return surface_set_point_to_ray (&camera->surfaces, surface_index, x, y,
+      ray) && fisheye_ray_to_pixel (camera->grid_focal, camera->src_fov,
+      grid_size / 2, grid_size / 2, ray, u, v);
+}
+
+static inline CellVector
+saturating_add (CellVector a, CellVector b)
+{
+  CellVector sum = a + b;
+
+  /* Lanes that wrapped compare as all ones. */
+  return sum | (CellVector) (sum < a);
+}
+
+static void
+splat (Heatmap * heatmap, HeatmapCamera * camera, guint x, guint y,
+    guint radius)
+{
+  guint left = x + MARGIN - radius;
+  const Kernel *kernel = &heatmap->kernels[radius][left % LANES];
+  CellVector *cells = camera->cells + (y + MARGIN - radius) * heatmap->stride +
+      left / LANES;
+  const CellVector *weights = kernel->rows;
+  guint i, j;
+
+  for (i = 0; i < kernel->num_rows; i++) {
+    for (j = 0; j < kernel->num_vectors; j++)
+      cells[j] = saturating_add (cells[j], weights[j]);
+    cells += heatmap->stride;
+    weights += kernel->num_vectors;
+  }
+}
+
+static void
+splat_object (Heatmap * heatmap, HeatmapCamera * camera, guint surface_index,
+    const ObjectRecord * object)
+{
+  gdouble grid_size = heatmap->config.grid_size;
+  gdouble bottom = object->top + object->height;
+  gdouble u, v, edge_u, edge_v;
+  gdouble radius = 0;
+
+  if (!point_to_cell (camera, surface_index,
+          object->left + object->width / 2, bottom, grid_size, &u, &v) ||
+      u < 0 || v < 0 || u >= grid_size || v >= grid_size) {
+    heatmap->num_unplaced++;
+    return;
+  }
+
+  /* The footprint is as wide as the bottom edge of the box. */
+  if (point_to_cell (camera, surface_index, object->left, bottom, grid_size,
+          &edge_u, &edge_v))
+    radius = MAX (radius, hypot (edge_u - u, edge_v - v));
+  if (point_to_cell (camera, surface_index, object->left + object->width,
+          bottom, grid_size, &edge_u, &edge_v))
+    radius = MAX (radius, hypot (edge_u - u, edge_v - v));
+
+  splat (heatmap, camera, (guint) u, (guint) v,
+      (guint) MIN (radius + 0.5, MAX_RADIUS));
+}
+
+/* Multiplies every cell by factor / 2^DECAY_BITS, rounding down so that
+ * cells eventually return to 0. Rounding takes less than 2^-WEIGHT_BITS
+ * detections per pass, a tenth of the decay of a cell holding one detection
+ * with a 300 s half-life and 1 s passes. Split in 16 bit halves to stay
+ * within 32 bits. */
+static void
+decay_cells (CellVector * cells, guint num_vectors, guint32 factor)
+{
+  const CellVector f = { factor, factor, factor, factor };
+  const CellVector low_mask = { 0xffff, 0xffff, 0xffff, 0xffff };
+  guint i;
+
+  for (i = 0; i < num_vectors; i++) {
+    CellVector value = cells[i];
+
+    cells[i] = (value >> DECAY_BITS) * f +
+        (((value & low_mask) * f) >> DECAY_BITS);
+  }
+}
+
+static void
+decay (Heatmap * heatmap, guint64 num_intervals)
+{
+  gdouble elapsed_sec =
+      num_intervals * heatmap->config.decay_interval_msec / 1000.0;
+  gdouble factor = pow (0.5, elapsed_sec / heatmap->config.half_life_sec);
+  guint32 fixed = (guint32) MIN (factor * (1 << DECAY_BITS) + 0.5,
+      (1 << DECAY_BITS) - 1);
+  guint i;
+
+  for (i = 0; i < heatmap->cameras->len; i++) {
+    HeatmapCamera *camera = g_ptr_array_index (heatmap->cameras, i);
+
+    if (camera)
+      decay_cells (camera->cells, heatmap->num_rows * heatmap->stride, fixed);
+  }
+  heatmap->num_decays++;
+}
+
+static guint32
+grid_max (const Heatmap * heatmap, const HeatmapCamera * camera)
+{
+  CellVector max = { 0, 0, 0, 0 };
+  guint32 result = 0;
+  guint x, y, i;
+
+  for (y = MARGIN; y < MARGIN + heatmap->config.grid_size; y++) {
+    const CellVector *row = camera->cells + y * heatmap->stride;
+
+    for (x = MARGIN / LANES; x < (MARGIN + heatmap->config.grid_size) / LANES;
+        x++) {
+      CellVector greater = (CellVector) (row[x] > max);
+      max = (row[x] & greater) | (max & ~greater);
+    }
+  }
+  for (i = 0; i < LANES; i++)
+    result = MAX (result, max[i]);
+  return result;
+}
+
+static gboolean
+write_snapshot (Heatmap * heatmap, const HeatmapCamera * camera,
+    gint64 timestamp)
+{
+  guint grid_size = heatmap->config.grid_size;
+  HeatmapSnapshotHeader header;
+  guint32 max = grid_max (heatmap, camera);
+  guint x, y;
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, HEATMAP_FILE_MAGIC, sizeof (header.magic));
+  header.version = HEATMAP_FILE_VERSION;
+  header.source_id = camera->source_id;
+  header.grid_size = grid_size;
+  header.batch_num = heatmap->batch_num;
+  header.timestamp = timestamp;
+  header.src_fov = camera->src_fov;
+  header.focal_length = camera->surfaces.focal_length;
+  header.scale = (gdouble) max / G_MAXUINT16 / (1 << WEIGHT_BITS);
+
+  /* Cells are scaled to the full 16 bit range of each snapshot. */
+  for (y = 0; y < grid_size; y++) {
+    const guint32 *row =
+        (const guint32 *) (camera->cells + (y + MARGIN) * heatmap->stride) +
+        MARGIN;
+    guint16 *out = heatmap->snapshot + y * grid_size;
+
+    for (x = 0; x < grid_size; x++)
+      out[x] = max ?
+          (guint16) (((guint64) row[x] * G_MAXUINT16 + max / 2) / max) : 0;
+  }
+
+  if (fwrite (&header, sizeof (header), 1, heatmap->file) != 1 ||
+      fwrite (heatmap->snapshot, sizeof (guint16), grid_size * grid_size,
+          heatmap->file) != grid_size * grid_size)
+    return FALSE;
+
+  heatmap->num_snapshots++;
+  return TRUE;
+}
+
+static gboolean
+write_snapshots (Heatmap * heatmap, gint64 timestamp)
+{
+  guint i;
+
+  for (i = 0; i < heatmap->cameras->len; i++) {
+    HeatmapCamera *camera = g_ptr_array_index (heatmap->cameras, i);
+
+    if (camera && !write_snapshot (heatmap, camera, timestamp))
+      return FALSE;
+  }
+  /* Readers always see whole snapshots. */
+  return fflush (heatmap->file) == 0;
+}
+
+gboolean
+heatmap_process_batch (Heatmap * heatmap, const FrameRecordBatch * batch)
+{
+  gint64 decay_interval = heatmap->config.decay_interval_msec * 1000;
+  gint64 snapshot_interval =
+      (gint64) heatmap->config.snapshot_interval_sec * G_USEC_PER_SEC;
+  guint64 num_intervals;
+  guint i, j;
+
+  /* A replay starting its next loop goes back in time. */
+  if (!heatmap->started || batch->timestamp < heatmap->last_decay) {
+    heatmap->started = TRUE;
+    heatmap->last_decay = batch->timestamp;
+    heatmap->last_snapshot = batch->timestamp;
+  }
+  heatmap->batch_num = batch->batch_num;
+  heatmap->now = batch->timestamp;
+
+  /* Intervals missed while no batches came are caught up in one pass. */
+  num_intervals = (batch->timestamp - heatmap->last_decay) / decay_interval;
+  if (num_intervals) {
+    decay (heatmap, num_intervals);
+    heatmap->last_decay += num_intervals * decay_interval;
+  }
+
+  for (i = 0; i < batch->num_frames; i++) {
+    const FrameRecord *record = batch->frames[i];
+    HeatmapCamera *camera = record->source_id < heatmap->cameras->len ?
+        g_ptr_array_index (heatmap->cameras, record->source_id) : NULL;
+
+    for (j = 0; j < record->num_objects; j++) {
+      const ObjectRecord *object = &record->objects[j];
+
+      if (heatmap->config.class_id >= 0 &&
+          object->class_id != heatmap->config.class_id)
+        continue;
+      heatmap->num_objects++;
+      if (!camera) {
+        heatmap->num_unplaced++;
+        continue;
+      }
+      splat_object (heatmap, camera, record->surface_index, object);
+    }
+  }
+
+  if (snapshot_interval &&
+      batch->timestamp - heatmap->last_snapshot >= snapshot_interval) {
+    heatmap->last_snapshot = batch->timestamp;
+    return write_snapshots (heatmap, batch->timestamp);
+  }
+  return TRUE;
+}
+
+void
+heatmap_print_stats (Heatmap * heatmap)
+{
+  g_print ("Heatmap: %" G_GUINT64_FORMAT " detections, %" G_GUINT64_FORMAT
+      " outside the grid or without geometry, %" G_GUINT64_FORMAT
+      " decay passes, %" G_GUINT64_FORMAT " snapshots\n",
+      heatmap->num_objects, heatmap->num_unplaced, heatmap->num_decays,
+      heatmap->num_snapshots);
+}
+
+void
+heatmap_free (Heatmap * heatmap)
+{
+  guint i, j;
+
+  if (!heatmap)
+    return;
+  if (heatmap->started && !write_snapshots (heatmap, heatmap->now))
+    g_printerr ("Failed to write the last heatmap snapshot\n");
+  for (i = 0; i < heatmap->cameras->len; i++)
+    camera_free (g_ptr_array_index (heatmap->cameras, i));
+  g_ptr_array_free (heatmap->cameras, TRUE);
+  for (i = 0; i <= MAX_RADIUS; i++)
+    for (j = 0; j < LANES; j++)
+      g_free (heatmap->kernels[i][j].rows);
+  g_free (heatmap->snapshot);
+  fclose (heatmap->file);
+  g_free (heatmap);
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __HEATMAP_H__
+#define __HEATMAP_H__
+
+#include <glib.h>
+
+#include "app_config.h"
+#include "frame_record.h"
+
+/* Occupancy heatmap of every camera, accumulated in the coordinates of its
+ * fisheye source rather than of the dewarped surfaces, so that an area seen
+ * by several surfaces is counted in one place. The bottom edge of every
+ * detection is mapped through the projection of its surface to a ray, and
+ * the ray to a cell of an equidistant grid spanning the widest src-fov of
+ * the surfaces in the camera's dewarper config. A cone shaped footprint as wide as that edge is
+ * added to the grid in fixed point, several cells per instruction. Every
+ * decay interval all cells are multiplied by the decay factor, so the work
+ * per interval depends on the grid size only, never on how long the app ran.
+ *
+ * Snapshots are appended to the configured file, in host byte order:
+ *   per camera and snapshot: HeatmapSnapshotHeader followed by
+ *   grid_size * grid_size guint16 cells, row major.
+ * A cell holds value * scale detections; the center of a footprint adds one
+ * detection per frame. Cell (x, y) is centered on the source pixel
+ *   cx + (x + 0.5 - grid_size / 2) * f * fov / grid_size
+ * where f is focal_length, fov is src_fov in radians and cx the optical
+ * center of the source, likewise for y. */
+
+#define HEATMAP_FILE_MAGIC "DSHM"
+#define HEATMAP_FILE_VERSION 1
+
+typedef struct _HeatmapSnapshotHeader
+{
+  gchar magic[4];
+  guint32 version;
+  guint32 source_id;
+  guint32 grid_size;
+  guint64 batch_num;
+  gint64 timestamp;
+  /* Field of view in degrees covered by the grid width. */
+  gfloat src_fov;
+  /* Pixels per radian of the fisheye source, 0 if the config has none. */
+  gfloat focal_length;
+  gfloat scale;
+  guint32 reserved;
+} HeatmapSnapshotHeader;
+
+typedef struct _Heatmap Heatmap;
+
+Heatmap *heatmap_new (const HeatmapConfig * config);
+
+/* Loads the surfaces of the stream source_id from its dewarper config and
+ * allocates the grid of the camera. frame_width and frame_height are the
+ * streammux resolution the object coordinates refer to. */
+gboolean heatmap_add_camera (Heatmap * heatmap, guint source_id,
+    const gchar * dewarper_config_file, guint frame_width,
+    guint frame_height);
+
+/* Returns FALSE if a snapshot could not be written. */
+gboolean heatmap_process_batch (Heatmap * heatmap,
+    const FrameRecordBatch * batch);
+
+void heatmap_print_stats (Heatmap * heatmap);
+
+/* Writes a last snapshot of every camera. */
+void heatmap_free (Heatmap * heatmap);
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "metadata_dump.h"
+
+#define METADATA_DUMP_BUFFER_SIZE (1 << 16)
+/* Longest line formatting may produce, including five floats that take
+ * the printf fallback. */
+#define MAX_LINE_LENGTH 512
+/* Floats whose scaled value does not fit a guint64. */
+#define MAX_FAST_FLOAT 9e18
+
+#define APPEND_LITERAL(out, s) \
+  (memcpy ((out), (s), sizeof (s) - 1), (out) + sizeof (s) - 1)
+
+MetadataDump *
+metadata_dump_new (const gchar * file_name)
+{
+  MetadataDump *dump;
+  gint fd = open (file_name, O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+  if (fd < 0) {
+    g_printerr ("Failed to open %s: %s\n", file_name, g_strerror (errno));
+    return NULL;
+  }
+
+  dump = g_new0 (MetadataDump, 1);
+  dump->fd = fd;
+  dump->buffer = g_malloc (METADATA_DUMP_BUFFER_SIZE);
+  return dump;
+}
+
+static gboolean
+flush (MetadataDump * dump)
+{
+  gsize written = 0;
+
+  while (written < dump->length) {
+    gssize ret = write (dump->fd, dump->buffer + written,
+        dump->length - written);
+
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+    written += ret;
+  }
+  dump->length = 0;
+  return TRUE;
+}
+
+static inline gchar *
+format_uint (gchar * out, guint64 value)
+{
+  gchar digits[20];
+  guint n = 0;
+
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  while (n)
+    *out++ = digits[--n];
+  return out;
+}
+
+static inline gchar *
+format_int (gchar * out, gint value)
+{
+  if (value < 0) {
+    *out++ = '-';
+    return format_uint (out, -(gint64) value);
+  }
+  return format_uint (out, value);
+}
+
+/* Same output as printf ("%f", value). A float has at most 24 significant
+ * bits and 10^6 needs 14 more, so value * 10^6 is exact in a double and
+ * rint() rounds it half to even, like printf does. */
+static inline gchar *
+format_float (gchar * out, gfloat value)
+{
+  gdouble scaled = (gdouble) value * 1e6;
+  guint64 fixed;
+  guint fraction;
+  gint i;
+
+  if (!(fabs (scaled) < MAX_FAST_FLOAT))
+    return out + g_snprintf (out, MAX_LINE_LENGTH / 8, "%f", value);
+
+  if (signbit (scaled)) {
+    *out++ = '-';
+    scaled = -scaled;
+  }
+  fixed = (guint64) rint (scaled);
+  out = format_uint (out, fixed / 1000000);
+  *out++ = '.';
+  fraction = fixed % 1000000;
+  for (i = 5; i >= 0; i--) {
+    out[i] = '0' + fraction % 10;
+    fraction /= 10;
+  }
+  return out + 6;
+}
+
+/* "%s %lu 0.0 0 0.0 %f %f %f %f 0.0 0.0 0.0 0.0 0.0 0.0 0.0 %f\n" */
+static gchar *
+format_object (gchar * out, const ObjectRecord * object)
+{
+  gsize label_length = strnlen (object->label, OBJECT_RECORD_LABEL_LEN);
+
+  memcpy (out, object->label, label_length);
+  out += label_length;
+  *out++ = ' ';
+  out = format_uint (out, object->object_id);
+  out = APPEND_LITERAL (out, " 0.0 0 0.0 ");
+  out = format_float (out, object->left);
+  *out++ = ' ';
+  out = format_float (out, object->top);
+  *out++ = ' ';
+  out = format_float (out, object->left + object->width);
+  *out++ = ' ';
+  out = format_float (out, object->top + object->height);
+  out = APPEND_LITERAL (out, " 0.0 0.0 0.0 0.0 0.0 0.0 0.0 ");
+  out = format_float (out, object->confidence);
+  *out++ = '\n';
+  return out;
+}
+
+/* "Frame Number = %d People Count = %d Bag Count = %d Face Count = %d \n" */
+static gchar *
+format_summary (gchar * out, gint frame_number, const guint * counts)
+{
+  out = APPEND_LITERAL (out, "Frame Number = ");
+  out = format_int (out, frame_number);
+  out = APPEND_LITERAL (out, " People Count = ");
+  out = format_int (out, counts[0]);
+  out = APPEND_LITERAL (out, " Bag Count = ");
+  out = format_int (out, counts[1]);
+  out = APPEND_LITERAL (out, " Face Count = ");
+  out = format_int (out, counts[2]);
+  out = APPEND_LITERAL (out, " \n");
+  return out;
+}
+
+/* "Objects Not Recorded = %u \n" */
+static gchar *
+format_truncated (gchar * out, guint num_truncated)
+{
+  out = APPEND_LITERAL (out, "Objects Not Recorded = ");
+  out = format_uint (out, num_truncated);
+  out = APPEND_LITERAL (out, " \n");
+  return out;
+}
+
+gboolean
+metadata_dump_write_batch (MetadataDump * dump,
+    const FrameRecordBatch * batch)
+{
+  guint class_counts[METADATA_DUMP_NUM_CLASSES] = { 0 };
+  guint num_truncated = 0;
+  guint i, j;
+
+  for (i = 0; i < batch->num_frames; i++) {
+    const FrameRecord *record = batch->frames[i];
+
+    num_truncated += record->num_truncated;
+
+    frame_record_count_classes (record, class_counts,
+        METADATA_DUMP_NUM_CLASSES);
+    for (j = 0; j < record->num_objects; j++) {
+      if (METADATA_DUMP_BUFFER_SIZE - dump->length < MAX_LINE_LENGTH &&
+          !flush (dump))
+        return FALSE;
+      dump->length = format_object (dump->buffer + dump->length,
+          &record->objects[j]) - dump->buffer;
+    }
+  }
+
+  if (METADATA_DUMP_BUFFER_SIZE - dump->length < MAX_LINE_LENGTH &&
+      !flush (dump))
+    return FALSE;
+  dump->length = format_summary (dump->buffer + dump->length,
+      dump->frame_number++, class_counts) - dump->buffer;
+  if (num_truncated) {
+    dump->length = format_truncated (dump->buffer + dump->length,
+        num_truncated) - dump->buffer;
+    dump->num_truncated += num_truncated;
+  }
+
+  /* The file is complete after every batch, as readers expect. */
+  return flush (dump);
+}
+
+void
+metadata_dump_print_stats (const MetadataDump * dump)
+{
+  if (dump->num_truncated)
+    g_printerr ("%" G_GUINT64_FORMAT " objects beyond %d per frame were not "
+        "written to %s\n", dump->num_truncated, FRAME_RECORD_MAX_OBJECTS,
+        METADATA_DUMP_FILE);
+}
+
+void
+metadata_dump_free (MetadataDump * dump)
+{
+  if (!dump)
+    return;
+  close (dump->fd);
+  g_free (dump->buffer);
+  g_free (dump);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __METADATA_DUMP_H__
+#define __METADATA_DUMP_H__
+
+#include <glib.h>
+
+#include "frame_record.h"
+
+/* Text dump written for every batch, one line per object followed by a per
+ * batch summary of the person, bag and face class counts. Frames with more
+ * than FRAME_RECORD_MAX_OBJECTS objects keep only the first ones; the summary
+ * is then followed by "Objects Not Recorded = <n>", and the missing objects
+ * are neither dumped nor counted. The file stays
+ * open for the whole run. Lines are formatted into a buffer allocated once,
+ * with integer arithmetic instead of printf, and each batch goes to the file
+ * with a single write(2), so writing the dump neither allocates nor goes
+ * through stdio. This covers the dump only: the recorder, track log, global
+ * tracker and ROI stages still write through stdio and may allocate per
+ * batch. The output is byte for byte what printf's %f produced. */
+
+#define METADATA_DUMP_FILE "metadata_dwarper.txt"
+#define METADATA_DUMP_NUM_CLASSES 3
+
+typedef struct _MetadataDump
+{
+  gint fd;
+  gchar *buffer;
+  gsize length;
+  /* Batch counter printed in the summary lines. */
+  gint frame_number;
+  guint64 num_truncated;
+} MetadataDump;
+
+/* Opens file_name for appending. */
+MetadataDump *metadata_dump_new (const gchar * file_name);
+
+gboolean metadata_dump_write_batch (MetadataDump * dump,
+    const FrameRecordBatch * batch);
+
+/* Warns about objects that did not fit their frame record. */
+void metadata_dump_print_stats (const MetadataDump * dump);
+
+void metadata_dump_free (MetadataDump * dump);
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "metadata_recorder.h"
+
+#define RECORDER_BUFFER_SIZE (1 << 20)
+
+MetadataRecorder *
+metadata_recorder_new (const gchar * file_name)
+{
+  MetadataRecorder *recorder;
+  MetadataFileHeader header;
+  FILE *file = fopen (file_name, "wb");
+
+  if (!file) {
+    g_printerr ("Failed to open %s for recording\n", file_name);
+    return NULL;
+  }
+  setvbuf (file, NULL, _IOFBF, RECORDER_BUFFER_SIZE);
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, METADATA_FILE_MAGIC, sizeof (header.magic));
+  header.version = METADATA_FILE_VERSION;
+  header.object_record_size = sizeof (ObjectRecord);
+  if (fwrite (&header, sizeof (header), 1, file) != 1) {
+    g_printerr ("Failed to write %s\n", file_name);
+    fclose (file);
+    return NULL;
+  }
+
+  recorder = g_new0 (MetadataRecorder, 1);
+  recorder->file = file;
+  return recorder;
+}
+
+gboolean
+metadata_recorder_write_batch (MetadataRecorder * recorder,
+    const FrameRecordBatch * batch)
+{
+  MetadataBatchHeader batch_header;
+  guint i;
+
+  memset (&batch_header, 0, sizeof (batch_header));
+  batch_header.batch_num = batch->batch_num;
+  batch_header.timestamp = batch->timestamp;
+  batch_header.num_frames = batch->num_frames;
+  if (fwrite (&batch_header, sizeof (batch_header), 1, recorder->file) != 1)
+    return FALSE;
+
+  for (i = 0; i < batch->num_frames; i++) {
+    const FrameRecord *record = batch->frames[i];
+    MetadataFrameHeader frame_header;
+
+    frame_header.pts = record->pts;
+    frame_header.source_id = record->source_id;
+    frame_header.surface_index = record->surface_index;
+    frame_header.surface_type = record->surface_type;
+    frame_header.frame_num = record->frame_num;
+    frame_header.num_objects = record->num_objects;
+    frame_header.num_truncated = record->num_truncated;
+    if (fwrite (&frame_header, sizeof (frame_header), 1, recorder->file) != 1)
+      return FALSE;
+    if (record->num_objects &&
+        fwrite (record->objects, sizeof (ObjectRecord), record->num_objects,
+            recorder->file) != record->num_objects)
+      return FALSE;
+  }
+
+  recorder->num_batches++;
+  return TRUE;
+}
+
+void
+metadata_recorder_free (MetadataRecorder * recorder)
+{
+  if (!recorder)
+    return;
+  fclose (recorder->file);
+  g_free (recorder);
+}
+
+/* Decodes the batch at *offset into batch and advances *offset. Returns
+ * FALSE on a truncated or malformed batch. batch may be NULL to only
+ * validate and count frames. */
+static gboolean
+decode_batch (const guint8 * data, gsize size, gsize * offset,
+    FrameRecordBatch * batch, guint * num_frames)
+{
+  MetadataBatchHeader batch_header;
+  gsize pos = *offset;
+  guint i;
+
+  if (size - pos < sizeof (batch_header))
+    return FALSE;
+  memcpy (&batch_header, data + pos, sizeof (batch_header));
+  pos += sizeof (batch_header);
+
+  if (batch) {
+    if (batch_header.num_frames > batch->max_frames)
+      return FALSE;
+    batch->batch_num = batch_header.batch_num;
+    batch->timestamp = batch_header.timestamp;
+    batch->num_frames = 0;
+  }
+
+  for (i = 0; i < batch_header.num_frames; i++) {
+    MetadataFrameHeader frame_header;
+    gsize objects_size;
+
+    if (size - pos < sizeof (frame_header))
+      return FALSE;
+    memcpy (&frame_header, data + pos, sizeof (frame_header));
+    pos += sizeof (frame_header);
+
+    if (frame_header.num_objects > FRAME_RECORD_MAX_OBJECTS)
+      return FALSE;
+    objects_size = (gsize) frame_header.num_objects * sizeof (ObjectRecord);
+    if (size - pos < objects_size)
+      return FALSE;
+
+    if (batch) {
+      FrameRecord *record = frame_record_batch_append (batch);
+
+      record->batch_num = batch_header.batch_num;
+      record->pts = frame_header.pts;
+      record->source_id = frame_header.source_id;
+      record->surface_index = frame_header.surface_index;
+      record->surface_type = frame_header.surface_type;
+      record->frame_num = frame_header.frame_num;
+      record->end_of_batch = (i == batch_header.num_frames - 1);
+      record->num_objects = frame_header.num_objects;
+      record->num_truncated = frame_header.num_truncated;
+      memcpy (record->objects, data + pos, objects_size);
+    }
+    pos += objects_size;
+  }
+
+  *num_frames = batch_header.num_frames;
+  *offset = pos;
+  return TRUE;
+}
+
+gboolean
+metadata_replay_run (const gchar * file_name, gboolean realtime,
+    guint num_loops, FrameRecordBatchFunc func, gpointer user_data,
+    MetadataReplayStats * stats)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  gchar *contents = NULL;
+  gsize size = 0;
+  const guint8 *data;
+  MetadataFileHeader header;
+  FrameRecordBatch *batch = NULL;
+  guint max_frames = 0;
+  gint64 first_timestamp = 0, last_timestamp = 0;
+  gint64 start, loop_offset = 0;
+  gsize offset;
+  guint loop, num_frames, i;
+
+  memset (stats, 0, sizeof (MetadataReplayStats));
+
+  /* The whole recording is loaded up front so that file I/O is not part of
+   * the measured replay. */
+  if (!g_file_get_contents (file_name, &contents, &size, &error)) {
+    g_printerr ("Failed to read %s: %s\n", file_name, error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+  data = (const guint8 *) contents;
+
+  if (size < sizeof (header)) {
+    g_printerr ("%s is not a metadata recording\n", file_name);
+    goto done;
+  }
+  memcpy (&header, data, sizeof (header));
+  if (memcmp (header.magic, METADATA_FILE_MAGIC, sizeof (header.magic)) ||
+      header.version != METADATA_FILE_VERSION ||
+      header.object_record_size != sizeof (ObjectRecord)) {
+    g_printerr ("%s has an unsupported format\n", file_name);
+    goto done;
+  }
+
+  /* Validate once and size the batch for the largest recorded batch. */
+  offset = sizeof (header);
+  for (i = 0; offset < size; i++) {
+    if (!decode_batch (data, size, &offset, NULL, &num_frames)) {
+      g_printerr ("%s is truncated or corrupt at batch %u\n", file_name, i);
+      goto done;
+    }
+    max_frames = MAX (max_frames, num_frames);
+  }
+  batch = frame_record_batch_new (MAX (max_frames, 1), TRUE);
+
+  start = g_get_monotonic_time ();
+  for (loop = 0; loop < num_loops; loop++) {
+    gboolean first = TRUE;
+    guint num_loop_batches = 0;
+
+    offset = sizeof (header);
+    while (offset < size) {
+      decode_batch (data, size, &offset, batch, &num_frames);
+
+      if (first) {
+        first_timestamp = batch->timestamp;
+        first = FALSE;
+      }
+      last_timestamp = batch->timestamp;
+      num_loop_batches++;
+      batch->timestamp += loop_offset;
+
+      if (realtime) {
+        gint64 due = start + (batch->timestamp - first_timestamp);
+        gint64 now = g_get_monotonic_time ();
+        if (due > now)
+          g_usleep (due - now);
+      }
+
+      func (batch, user_data);
+
+      stats->num_batches++;
+      stats->num_frames += batch->num_frames;
+      for (i = 0; i < batch->num_frames; i++)
+        stats->num_objects += batch->frames[i]->num_objects;
+    }
+    /* The next loop follows the last batch after the mean batch interval,
+     * as if the recording went on. */
+    loop_offset += last_timestamp - first_timestamp;
+    if (num_loop_batches > 1)
+      loop_offset +=
+          (last_timestamp - first_timestamp) / (num_loop_batches - 1);
+  }
+  stats->elapsed_usec = g_get_monotonic_time () - start;
+
+  ret = TRUE;
+done:
+  frame_record_batch_free (batch);
+  g_free (contents);
+  return ret;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __METADATA_RECORDER_H__
+#define __METADATA_RECORDER_H__
+
+#include <glib.h>
+#include <stdio.h>
+
+#include "frame_record.h"
+
+/* Records the FrameRecordBatches seen by the metadata probe into a compact
+ * binary file and replays them later without GStreamer, GPU or model, so
+ * everything downstream of nvinfer/nvtracker can be benchmarked and regression
+ * tested offline.
+ *
+ * File layout, in host byte order:
+ *   MetadataFileHeader
+ *   per batch: MetadataBatchHeader, then per frame MetadataFrameHeader
+ *              followed by num_objects ObjectRecords. */
+
+#define METADATA_FILE_MAGIC "DSMR"
+#define METADATA_FILE_VERSION 1
+
+typedef struct _MetadataFileHeader
+{
+  gchar magic[4];
+  guint32 version;
+  guint32 object_record_size;
+  guint32 reserved;
+} MetadataFileHeader;
+
+typedef struct _MetadataBatchHeader
+{
+  guint64 batch_num;
+  gint64 timestamp;
+  guint32 num_frames;
+  guint32 reserved;
+} MetadataBatchHeader;
+
+typedef struct _MetadataFrameHeader
+{
+  guint64 pts;
+  guint32 source_id;
+  guint32 surface_index;
+  guint32 surface_type;
+  gint32 frame_num;
+  guint32 num_objects;
+  guint32 num_truncated;
+} MetadataFrameHeader;
+
+typedef struct _MetadataRecorder
+{
+  FILE *file;
+  guint64 num_batches;
+} MetadataRecorder;
+
+MetadataRecorder *metadata_recorder_new (const gchar * file_name);
+
+gboolean metadata_recorder_write_batch (MetadataRecorder * recorder,
+    const FrameRecordBatch * batch);
+
+void metadata_recorder_free (MetadataRecorder * recorder);
+
+typedef struct _MetadataReplayStats
+{
+  guint64 num_batches;
+  guint64 num_frames;
+  guint64 num_objects;
+  gint64 elapsed_usec;
+} MetadataReplayStats;
+
+/* Reads file_name and calls func for every recorded batch, num_loops times.
+ * Each loop's timestamps are shifted to follow the previous loop by the mean
+ * batch interval, so func sees a steady clock. With realtime set the batches
+ * are paced with these timestamps, otherwise they are delivered as fast as
+ * func consumes them. */
+gboolean metadata_replay_run (const gchar * file_name, gboolean realtime,
+    guint num_loops, FrameRecordBatchFunc func, gpointer user_data,
+    MetadataReplayStats * stats);
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+
+#include "dewarper_config.h"
+#include "metadata_sink.h"
+
+MetadataSink *
+metadata_sink_new (const AppConfig * config)
+{
+  MetadataSink *sink = g_new0 (MetadataSink, 1);
+
+  sink->dump = metadata_dump_new (METADATA_DUMP_FILE);
+  if (!sink->dump) {
+    metadata_sink_free (sink);
+    return NULL;
+  }
+
+  if (config->recorder.enable) {
+    sink->recorder = metadata_recorder_new (config->recorder.file);
+    if (!sink->recorder) {
+      metadata_sink_free (sink);
+      return NULL;
+    }
+  }
+
+  if (config->global_tracking.enable) {
+    sink->global_tracker = global_tracker_new (&config->global_tracking);
+    if (!sink->global_tracker) {
+      metadata_sink_free (sink);
+      return NULL;
+    }
+  }
+
+  if (config->track_log.enable) {
+    sink->track_log = track_log_new (&config->track_log);
+    if (!sink->track_log) {
+      metadata_sink_free (sink);
+      return NULL;
+    }
+  }
+
+  if (config->heatmap.enable) {
+    sink->heatmap = heatmap_new (&config->heatmap);
+    if (!sink->heatmap) {
+      metadata_sink_free (sink);
+      return NULL;
+    }
+  }
+
+  if (config->roi_analytics.enable) {
+    sink->roi_analytics = roi_analytics_new (&config->roi_analytics);
+    if (!sink->roi_analytics) {
+      metadata_sink_free (sink);
+      return NULL;
+    }
+  }
+
+  return sink;
+}
+
+gboolean
+metadata_sink_add_camera (MetadataSink * sink, guint source_id,
+    const gchar * dewarper_config_file, guint frame_width,
+    guint frame_height)
+{
+  if (sink->global_tracker &&
+      !global_tracker_add_camera (sink->global_tracker, source_id,
+          dewarper_config_file, frame_width, frame_height))
+    return FALSE;
+
+  if (sink->heatmap &&
+      !heatmap_add_camera (sink->heatmap, source_id, dewarper_config_file,
+          frame_width, frame_height))
+    return FALSE;
+
+  /* Regions name their surface by surface-index, so each has to select a
+   * single surface. */
+  if (sink->roi_analytics) {
+    DewarperConfig config;
+
+    if (!parse_dewarper_config (&config, dewarper_config_file) ||
+        !dewarper_config_check_surface_indices (&config, dewarper_config_file))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+void
+metadata_sink_process_batch (const FrameRecordBatch * batch,
+    gpointer user_data)
+{
+  MetadataSink *sink = (MetadataSink *) user_data;
+
+  if (sink->recorder &&
+      !metadata_recorder_write_batch (sink->recorder, batch)) {
+    g_printerr ("Failed to record batch %" G_GUINT64_FORMAT
+        ", recording stopped\n", batch->batch_num);
+    metadata_recorder_free (sink->recorder);
+    sink->recorder = NULL;
+  }
+
+  if (sink->global_tracker &&
+      !global_tracker_process_batch (sink->global_tracker, batch)) {
+    g_printerr ("Failed to write global tracks at batch %" G_GUINT64_FORMAT
+        ", global tracking stopped\n", batch->batch_num);
+    global_tracker_free (sink->global_tracker);
+    sink->global_tracker = NULL;
+  }
+
+  if (sink->track_log && !track_log_write_batch (sink->track_log, batch)) {
+    g_printerr ("Failed to write track log at batch %" G_GUINT64_FORMAT
+        ", track log stopped\n", batch->batch_num);
+    track_log_free (sink->track_log);
+    sink->track_log = NULL;
+  }
+
+  if (sink->heatmap && !heatmap_process_batch (sink->heatmap, batch)) {
+    g_printerr ("Failed to write heatmap snapshot at batch %" G_GUINT64_FORMAT
+        ", heatmap stopped\n", batch->batch_num);
+    heatmap_free (sink->heatmap);
+    sink->heatmap = NULL;
+  }
+
+  if (sink->roi_analytics &&
+      !roi_analytics_process_batch (sink->roi_analytics, batch,
+          sink->global_tracker)) {
+    g_printerr ("Failed to write ROI events at batch %" G_GUINT64_FORMAT
+        ", ROI analytics stopped\n", batch->batch_num);
+    roi_analytics_free (sink->roi_analytics);
+    sink->roi_analytics = NULL;
+  }
+
+  if (sink->dump && !metadata_dump_write_batch (sink->dump, batch)) {
+    g_printerr ("Failed to write %s at batch %" G_GUINT64_FORMAT
+        ", metadata dump stopped\n", METADATA_DUMP_FILE, batch->batch_num);
+    metadata_dump_free (sink->dump);
+    sink->dump = NULL;
+  }
+}
+
+void
+metadata_sink_free (MetadataSink * sink)
+{
+  if (!sink)
+    return;
+  if (sink->dump) {
+    metadata_dump_print_stats (sink->dump);
+    metadata_dump_free (sink->dump);
+  }
+  metadata_recorder_free (sink->recorder);
+  if (sink->global_tracker) {
+    global_tracker_print_stats (sink->global_tracker);
+    global_tracker_free (sink->global_tracker);
+  }
+  if (sink->track_log) {
+    track_log_print_stats (sink->track_log);
+    track_log_free (sink->track_log);
+  }
+  if (sink->heatmap) {
+    heatmap_print_stats (sink->heatmap);
+    heatmap_free (sink->heatmap);
+  }
+  if (sink->roi_analytics) {
+    roi_analytics_print_stats (sink->roi_analytics);
+    roi_analytics_free (sink->roi_analytics);
+  }
+  g_free (sink);
+}
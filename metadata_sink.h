@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __METADATA_SINK_H__
+#define __METADATA_SINK_H__
+
+#include <glib.h>
+
+#include "app_config.h"
+#include "frame_record.h"
+#include "global_tracker.h"
+#include "heatmap.h"
+#include "metadata_dump.h"
+#include "metadata_recorder.h"
+#include "roi_analytics.h"
+#include "track_log.h"
+
+/* Everything the app does with the metadata of a batch once it left the
+ * tracker: the metadata dump file, the optional recorder, global tracking,
+ * track log, heatmap and ROI analytics. Batches come from the metadata probe,
+ * from the shard supervisor or from a replayed recording, so the stages
+ * behind it can run without a pipeline. */
+
+typedef struct _MetadataSink
+{
+  MetadataDump *dump;
+  MetadataRecorder *recorder;
+  TrackLog *track_log;
+  GlobalTracker *global_tracker;
+  Heatmap *heatmap;
+  RoiAnalytics *roi_analytics;
+} MetadataSink;
+
+MetadataSink *metadata_sink_new (const AppConfig * config);
+
+/* Registers the dewarper config of stream source_id, for the stages that
+ * need the surface geometry. frame_width and frame_height are the streammux
+ * output resolution. Fails if a stage that keys on the surface is enabled
+ * and two surfaces of the config share a surface-index. */
+gboolean metadata_sink_add_camera (MetadataSink * sink, guint source_id,
+    const gchar * dewarper_config_file, guint frame_width,
+    guint frame_height);
+
+/* Has the FrameRecordBatchFunc signature, user_data is the MetadataSink. */
+void metadata_sink_process_batch (const FrameRecordBatch * batch,
+    gpointer user_data);
+
+/* Prints the statistics of the enabled outputs before freeing them. */
+void metadata_sink_free (MetadataSink * sink);
+
+#endif
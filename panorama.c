@@ -0,0 +1,759 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <gst/video/video.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "panorama.h"
+
+/* Points sampled per bbox edge; the edges of a box are curves on the view. */
+#define PANORAMA_OUTLINE_STEPS 8
+/* Frames allowed to wait for the encoder before new ones are dropped. */
+#define MAX_QUEUED_FRAMES 2
+
+#define PANORAMA_MAP_CACHE_MAGIC "DSPM"
+#define PANORAMA_MAP_CACHE_VERSION 1
+
+typedef struct _PanoramaMapCacheHeader
+{
+  gchar magic[4];
+  guint32 version;
+  guint32 width;
+  guint32 height;
+  guint32 ceiling;
+  guint32 src_width;
+  guint32 src_height;
+  guint32 src_stride;
+  gdouble focal_length;
+  gdouble src_fov;
+} PanoramaMapCacheHeader;
+
+typedef struct _PanoramaColor
+{
+  guint8 r;
+  guint8 g;
+  guint8 b;
+} PanoramaColor;
+
+/* Same colors as the labels of the peoplenet classes on the tiler. */
+static const PanoramaColor class_colors[] = {
+  {0, 255, 0},                  /* person */
+  {0, 0, 255},                  /* bag */
+  {255, 0, 0},                  /* face */
+};
+
+static const PanoramaColor other_color = { 255, 255, 0 };
+
+void
+panorama_view_init (PanoramaView * view, guint width, guint height,
+    gboolean ceiling, gdouble src_fov)
+{
+  view->width = width;
+  view->height = height;
+  view->ceiling = ceiling;
+  /* The rim of the fisheye circle is src_fov / 2 off the optical axis, which
+   * points straight down. */
+  view->top_elevation = MIN (src_fov * G_PI / 360.0, G_PI) - G_PI_2;
+}
+
+static void
+view_pixel_to_ray (const PanoramaView * view, gdouble x, gdouble y,
+    gdouble ray[3])
+{
+  gdouble azimuth = x / view->width * 2 * G_PI - G_PI;
+
+  if (view->ceiling) {
+    gdouble elevation = view->top_elevation -
+        y / view->height * (view->top_elevation + G_PI_2);
+    gdouble theta = elevation + G_PI_2;
+
+    ray[0] = sin (theta) * cos (azimuth);
+    ray[1] = sin (theta) * sin (azimuth);
+    ray[2] = cos (theta);
+  } else {
+    gdouble latitude = G_PI_2 - y / view->height * G_PI;
+
+    ray[0] = cos (latitude) * sin (azimuth);
+    ray[1] = -sin (latitude);
+    ray[2] = cos (latitude) * cos (azimuth);
+  }
+}
+
+void
+panorama_view_ray_to_pixel (const PanoramaView * view, const gdouble ray[3],
+    gdouble * x, gdouble * y)
+{
+  if (view->ceiling) {
+    gdouble theta = atan2 (hypot (ray[0], ray[1]), ray[2]);
+
+    *x = (atan2 (ray[1], ray[0]) + G_PI) / (2 * G_PI) * view->width;
+    *y = (view->top_elevation - (theta - G_PI_2)) /
+        (view->top_elevation + G_PI_2) * view->height;
+  } else {
+    gdouble latitude = atan2 (-ray[1], hypot (ray[0], ray[2]));
+
+    *x = (atan2 (ray[0], ray[2]) + G_PI) / (2 * G_PI) * view->width;
+    *y = (G_PI_2 - latitude) / G_PI * view->height;
+  }
+}
+
+void
+panorama_map_init (PanoramaMap * map, const PanoramaView * view,
+    guint src_width, guint src_height, guint src_stride,
+    gdouble focal_length, gdouble src_fov)
+{
+  PanoramaMapEntry *entry;
+  gdouble cx = src_width / 2.0;
+  gdouble cy = src_height / 2.0;
+  guint x, y;
+
+  map->view = *view;
+  map->src_width = src_width;
+  map->src_height = src_height;
+  map->src_stride = src_stride;
+  map->focal_length = focal_length;
+  map->src_fov = src_fov;
+  g_free (map->entries);
+  map->entries = g_new (PanoramaMapEntry, view->width * view->height);
+
+  if (src_fov <= 0)
+    src_fov = SURFACE_DEFAULT_SRC_FOV;
+  if (focal_length <= 0)
+    focal_length = MIN (cx, cy) / (src_fov * G_PI / 360.0);
+
+  entry = map->entries;
+  for (y = 0; y < view->height; y++) {
+    for (x = 0; x < view->width; x++, entry++) {
+      gdouble ray[3], u, v, u0, v0;
+
+      entry->offset = PANORAMA_MAP_OUTSIDE;
+      entry->fx = entry->fy = 0;
+      entry->reserved = 0;
+
+      view_pixel_to_ray (view, x + 0.5, y + 0.5, ray);
+      if (!fisheye_ray_to_pixel (focal_length, src_fov, cx, cy, ray, &u, &v))
+        continue;
+      /* Relative to the centers of the source pixels, which need a right and
+       * a bottom neighbour for the interpolation. */
+      u -= 0.5;
+      v -= 0.5;
+      if (u < 0 || v < 0 || u > src_width - 1 || v > src_height - 1)
+        continue;
+      u0 = MIN (floor (u), src_width - 2.0);
+      v0 = MIN (floor (v), src_height - 2.0);
+
+      entry->offset = (guint32) v0 * src_stride + (guint32) u0 * 4;
+      entry->fx = (guint8) MIN ((u - u0) * 256 + 0.5, 255);
+      entry->fy = (guint8) MIN ((v - v0) * 256 + 0.5, 255);
+    }
+  }
+}
+
+void
+panorama_map_remap (const PanoramaMap * map, const guint8 * src,
+    guint8 * dst)
+{
+  const PanoramaMapEntry *entry = map->entries;
+  const PanoramaMapEntry *end =
+      entry + map->view.width * map->view.height;
+  guint stride = map->src_stride;
+
+  for (; entry < end; entry++, dst += 4) {
+    const guint8 *p;
+    guint wx, wy, c;
+
+    if (entry->offset == PANORAMA_MAP_OUTSIDE) {
+      dst[0] = dst[1] = dst[2] = 0;
+      dst[3] = 255;
+      continue;
+    }
+
+    p = src + entry->offset;
+    wx = entry->fx;
+    wy = entry->fy;
+    for (c = 0; c < 3; c++) {
+      guint top = p[c] * (256 - wx) + p[c + 4] * wx;
+      guint bottom = p[stride + c] * (256 - wx) + p[stride + c + 4] * wx;
+
+      dst[c] = (top * (256 - wy) + bottom * wy + (1 << 15)) >> 16;
+    }
+    dst[3] = 255;
+  }
+}
+
+void
+panorama_map_clear (PanoramaMap * map)
+{
+  g_free (map->entries);
+  map->entries = NULL;
+}
+
+gchar *
+panorama_map_cache_name (const PanoramaView * view, guint src_width,
+    guint src_height, gdouble focal_length, gdouble src_fov)
+{
+  return g_strdup_printf ("panorama_%ux%u_%s_%ux%u_f%g_fov%g.map",
+      view->width, view->height, view->ceiling ? "ceiling" : "wall",
+      src_width, src_height, focal_length, src_fov);
+}
+
+static void
+cache_header_init (PanoramaMapCacheHeader * header, const PanoramaView * view,
+    guint src_width, guint src_height, guint src_stride,
+    gdouble focal_length, gdouble src_fov)
+{
+  memset (header, 0, sizeof (PanoramaMapCacheHeader));
+  memcpy (header->magic, PANORAMA_MAP_CACHE_MAGIC, 4);
+  header->version = PANORAMA_MAP_CACHE_VERSION;
+  header->width = view->width;
+  header->height = view->height;
+  header->ceiling = view->ceiling ? 1 : 0;
+  header->src_width = src_width;
+  header->src_height = src_height;
+  header->src_stride = src_stride;
+  header->focal_length = focal_length;
+  header->src_fov = src_fov;
+}
+
+gboolean
+panorama_map_save (const PanoramaMap * map, const gchar * file)
+{
+  PanoramaMapCacheHeader header;
+  gsize num_entries = (gsize) map->view.width * map->view.height;
+  gboolean ret;
+  FILE *f;
+
+  cache_header_init (&header, &map->view, map->src_width, map->src_height,
+      map->src_stride, map->focal_length, map->src_fov);
+
+  f = fopen (file, "wb");
+  if (!f) {
+    g_printerr ("Failed to open panorama map cache %s\n", file);
+    return FALSE;
+  }
+  ret = fwrite (&header, sizeof (header), 1, f) == 1 &&
+      fwrite (map->entries, sizeof (PanoramaMapEntry), num_entries,
+      f) == num_entries;
+  if (fclose (f) != 0)
+    ret = FALSE;
+  if (!ret) {
+    g_printerr ("Failed to write panorama map cache %s\n", file);
+    remove (file);
+  }
+  return ret;
+}
+
+gboolean
+panorama_map_load (PanoramaMap * map, const PanoramaView * view,
+    guint src_width, guint src_height, guint src_stride,
+    gdouble focal_length, gdouble src_fov, const gchar * file)
+{
+  PanoramaMapCacheHeader expected, header;
+  gsize num_entries = (gsize) view->width * view->height;
+  /* The bottom right sample of an entry must be inside the frame, and its
+   * right samples inside the row rather than in the padding of the stride. */
+  gsize max_offset = (gsize) (src_height - 1) * src_stride - 8;
+  PanoramaMapEntry *entries;
+  gboolean ret = FALSE;
+  gsize i;
+  FILE *f;
+
+  if (src_width < 2 || src_height < 2 || src_stride < src_width * 4)
+    return FALSE;
+  f = fopen (file, "rb");
+  if (!f)
+    return FALSE;
+
+  cache_header_init (&expected, view, src_width, src_height, src_stride,
+      focal_length, src_fov);
+  entries = g_new (PanoramaMapEntry, num_entries);
+  if (fread (&header, sizeof (header), 1, f) != 1 ||
+      memcmp (&header, &expected, sizeof (header)) != 0 ||
+      fread (entries, sizeof (PanoramaMapEntry), num_entries,
+          f) != num_entries)
+    goto done;
+  for (i = 0; i < num_entries; i++) {
+    if (entries[i].offset != PANORAMA_MAP_OUTSIDE &&
+        (entries[i].offset > max_offset ||
+            entries[i].offset % src_stride > (src_width - 2) * 4))
+      goto done;
+  }
+
+  map->view = *view;
+  map->src_width = src_width;
+  map->src_height = src_height;
+  map->src_stride = src_stride;
+  map->focal_length = focal_length;
+  map->src_fov = src_fov;
+  g_free (map->entries);
+  map->entries = entries;
+  entries = NULL;
+  ret = TRUE;
+done:
+  g_free (entries);
+  fclose (f);
+  return ret;
+}
+
+Panorama *
+panorama_new (const PanoramaConfig * config, guint num_sources)
+{
+  Panorama *panorama = g_new0 (Panorama, 1);
+  guint i;
+
+  panorama->config = *config;
+  panorama->config.file_prefix = g_strdup (config->file_prefix);
+  panorama->config.map_cache_dir = g_strdup (config->map_cache_dir);
+  panorama->num_sources = num_sources;
+  panorama->sources = g_new0 (PanoramaSource, num_sources);
+  for (i = 0; i < num_sources; i++) {
+    PanoramaSource *source = &panorama->sources[i];
+
+    source->panorama = panorama;
+    source->index = i;
+    g_mutex_init (&source->lock);
+    source->current = g_array_new (FALSE, FALSE, sizeof (PanoramaSegment));
+    source->pending = g_array_new (FALSE, FALSE, sizeof (PanoramaSegment));
+  }
+  return panorama;
+}
+
+static void
+draw_line (guint8 * dst, guint width, guint height, gint x0, gint y0,
+    gint x1, gint y1, const PanoramaColor * color)
+{
+  gint dx = ABS (x1 - x0);
+  gint dy = -ABS (y1 - y0);
+  gint sx = x0 < x1 ? 1 : -1;
+  gint sy = y0 < y1 ? 1 : -1;
+  gint err = dx + dy;
+
+  for (;;) {
+    if (x0 >= 0 && y0 >= 0 && x0 < (gint) width && y0 < (gint) height) {
+      guint8 *p = dst + ((gsize) y0 * width + x0) * 4;
+
+      p[0] = color->r;
+      p[1] = color->g;
+      p[2] = color->b;
+    }
+    if (x0 == x1 && y0 == y1)
+      break;
+    if (2 * err >= dy) {
+      err += dy;
+      x0 += sx;
+    }
+    if (2 * err <= dx) {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+static void
+draw_outlines (PanoramaSource * source, guint8 * dst)
+{
+  const PanoramaView *view = &source->view;
+  guint i;
+
+  g_mutex_lock (&source->lock);
+  for (i = 0; i < source->current->len; i++) {
+    const PanoramaSegment *segment =
+        &g_array_index (source->current, PanoramaSegment, i);
+    const PanoramaColor *color = segment->class_id >= 0 &&
+        segment->class_id < (gint) G_N_ELEMENTS (class_colors) ?
+        &class_colors[segment->class_id] : &other_color;
+
+    draw_line (dst, view->width, view->height, (gint) segment->x0,
+        (gint) segment->y0, (gint) segment->x1, (gint) segment->y1, color);
+  }
+  g_mutex_unlock (&source->lock);
+}
+
+/* Size, row stride and offset of the RGBA plane of buffer, from its video
+ * meta when the converter attached one and from the caps otherwise. */
+static gboolean
+frame_layout (GstSample * sample, GstBuffer * buffer, guint * width,
+    guint * height, guint * stride, gsize * offset)
+{
+  GstVideoMeta *meta = gst_buffer_get_video_meta (buffer);
+  GstCaps *caps = gst_sample_get_caps (sample);
+  GstVideoInfo info;
+
+  if (meta) {
+    if (meta->format != GST_VIDEO_FORMAT_RGBA || meta->stride[0] <= 0)
+      return FALSE;
+    *width = meta->width;
+    *height = meta->height;
+    *stride = meta->stride[0];
+    *offset = meta->offset[0];
+  } else {
+    if (!caps || !gst_video_info_from_caps (&info, caps) ||
+        GST_VIDEO_INFO_FORMAT (&info) != GST_VIDEO_FORMAT_RGBA ||
+        GST_VIDEO_INFO_PLANE_STRIDE (&info, 0) <= 0)
+      return FALSE;
+    *width = GST_VIDEO_INFO_WIDTH (&info);
+    *height = GST_VIDEO_INFO_HEIGHT (&info);
+    *stride = GST_VIDEO_INFO_PLANE_STRIDE (&info, 0);
+    *offset = GST_VIDEO_INFO_PLANE_OFFSET (&info, 0);
+  }
+  return *width >= 2 && *height >= 2 && *stride >= *width * 4;
+}
+
+static void
+build_map (PanoramaSource * source, guint width, guint height, guint stride)
+{
+  const gchar *cache_dir;
+  gchar *cache_file = NULL;
+
+  cache_dir = source->panorama->config.map_cache_dir;
+  if (cache_dir) {
+    gchar *name = panorama_map_cache_name (&source->view, width, height,
+        source->surfaces.focal_length, source->surfaces.src_fov);
+
+    cache_file = g_build_filename (cache_dir, name, NULL);
+    g_free (name);
+  }
+
+  if (!cache_file || !panorama_map_load (&source->map, &source->view, width,
+          height, stride, source->surfaces.focal_length,
+          source->surfaces.src_fov, cache_file)) {
+    panorama_map_init (&source->map, &source->view, width, height, stride,
+        source->surfaces.focal_length, source->surfaces.src_fov);
+    /* The next start finds the map. */
+    if (cache_file)
+      panorama_map_save (&source->map, cache_file);
+  }
+  g_free (cache_file);
+}
+
+static GstFlowReturn
+panorama_new_sample (GstElement * appsink, gpointer user_data)
+{
+  PanoramaSource *source = (PanoramaSource *) user_data;
+  const PanoramaView *view = &source->view;
+  gsize frame_size = (gsize) view->width * view->height * 4;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstSample *sample = NULL;
+  GstBuffer *in, *out;
+  GstMapInfo in_info, out_info;
+  guint width = 0, height = 0, stride = 0;
+  gsize offset = 0;
+  guint64 level = 0;
+  gint64 start;
+
+  g_signal_emit_by_name (appsink, "pull-sample", &sample);
+  if (!sample)
+    return GST_FLOW_OK;
+
+  /* A full encoder queue means the encoder is behind; skipping a frame of
+   * the view keeps the inference path from waiting on it. */
+  g_object_get (source->appsrc, "current-level-bytes", &level, NULL);
+  if (level >= MAX_QUEUED_FRAMES * frame_size) {
+    source->num_dropped++;
+    gst_sample_unref (sample);
+    return GST_FLOW_OK;
+  }
+
+  in = gst_sample_get_buffer (sample);
+  if (!in || !frame_layout (sample, in, &width, &height, &stride, &offset)) {
+    g_printerr ("Panorama of source %u: frames are not RGBA of a known size\n",
+        source->index);
+    gst_sample_unref (sample);
+    return GST_FLOW_ERROR;
+  }
+
+  /* The entries are byte offsets into the frame, so a map built for another
+   * size or stride would read the wrong pixels, or past the buffer. */
+  if (!source->map.entries || source->map.src_width != width ||
+      source->map.src_height != height || source->map.src_stride != stride)
+    build_map (source, width, height, stride);
+
+  if (!gst_buffer_map (in, &in_info, GST_MAP_READ)) {
+    gst_sample_unref (sample);
+    return GST_FLOW_OK;
+  }
+  if (in_info.size < offset + (gsize) stride * height) {
+    gst_buffer_unmap (in, &in_info);
+    gst_sample_unref (sample);
+    source->num_dropped++;
+    return GST_FLOW_OK;
+  }
+
+  out = gst_buffer_new_allocate (NULL, frame_size, NULL);
+  gst_buffer_map (out, &out_info, GST_MAP_WRITE);
+
+  start = g_get_monotonic_time ();
+  panorama_map_remap (&source->map, in_info.data + offset, out_info.data);
+  if (source->panorama->config.draw_detections)
+    draw_outlines (source, out_info.data);
+  source->total_remap_usec += g_get_monotonic_time () - start;
+  source->num_frames++;
+
+  gst_buffer_unmap (out, &out_info);
+  gst_buffer_unmap (in, &in_info);
+  GST_BUFFER_PTS (out) = GST_BUFFER_PTS (in);
+  GST_BUFFER_DURATION (out) = GST_BUFFER_DURATION (in);
+  gst_sample_unref (sample);
+
+  g_signal_emit_by_name (source->appsrc, "push-buffer", out, &ret);
+  gst_buffer_unref (out);
+  return ret;
+}
+
+static void
+panorama_eos (GstElement * appsink, gpointer user_data)
+{
+  PanoramaSource *source = (PanoramaSource *) user_data;
+  GstFlowReturn ret;
+
+  g_signal_emit_by_name (source->appsrc, "end-of-stream", &ret);
+}
+
+gboolean
+panorama_add_source (Panorama * panorama, guint index,
+    const gchar * dewarper_config_file, guint frame_width,
+    guint frame_height, GstElement * pipeline, GstElement * tee)
+{
+  PanoramaSource *source;
+  GstElement *queue, *convert, *filter, *appsink, *appsrc, *out_convert,
+      *out_filter, *encoder, *filesink;
+  GstCaps *caps;
+  gchar *location;
+
+  g_return_val_if_fail (index < panorama->num_sources, FALSE);
+  source = &panorama->sources[index];
+
+  if (!surface_set_load (&source->surfaces, dewarper_config_file, frame_width,
+          frame_height))
+    return FALSE;
+  panorama_view_init (&source->view, panorama->config.width,
+      panorama->config.height, panorama->config.ceiling,
+      source->surfaces.src_fov);
+
+  queue = gst_element_factory_make ("queue", NULL);
+  convert = gst_element_factory_make ("nvvideoconvert", NULL);
+  filter = gst_element_factory_make ("capsfilter", NULL);
+  appsink = gst_element_factory_make ("appsink", NULL);
+  appsrc = gst_element_factory_make ("appsrc", NULL);
+  out_convert = gst_element_factory_make ("nvvideoconvert", NULL);
+  out_filter = gst_element_factory_make ("capsfilter", NULL);
+  encoder = gst_element_factory_make ("nvv4l2h264enc", NULL);
+  filesink = gst_element_factory_make ("filesink", NULL);
+  if (!queue || !convert || !filter || !appsink || !appsrc || !out_convert ||
+      !out_filter || !encoder || !filesink) {
+    g_printerr ("Failed to create the panorama elements of source %u\n",
+        index);
+    return FALSE;
+  }
+
+  /* The view is a side output: old frames are dropped rather than holding
+   * up the tee, and with it the dewarper. */
+  g_object_set (G_OBJECT (queue), "leaky", 2, "max-size-buffers", 2,
+      "max-size-bytes", 0, "max-size-time", (guint64) 0, NULL);
+
+  caps = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "RGBA",
+      NULL);
+  g_object_set (G_OBJECT (filter), "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  g_object_set (G_OBJECT (appsink), "emit-signals", TRUE, "sync", FALSE,
+      "max-buffers", 1, "drop", TRUE, NULL);
+  g_signal_connect (appsink, "new-sample", G_CALLBACK (panorama_new_sample),
+      source);
+  g_signal_connect (appsink, "eos", G_CALLBACK (panorama_eos), source);
+
+  caps = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "RGBA",
+      "width", G_TYPE_INT, panorama->config.width,
+      "height", G_TYPE_INT, panorama->config.height,
+      "framerate", GST_TYPE_FRACTION, 0, 1, NULL);
+  g_object_set (G_OBJECT (appsrc), "caps", caps, "format", GST_FORMAT_TIME,
+      "is-live", TRUE, NULL);
+  gst_caps_unref (caps);
+
+  caps = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "I420",
+      NULL);
+  gst_caps_set_features (caps, 0, gst_caps_features_new ("memory:NVMM",
+          NULL));
+  g_object_set (G_OBJECT (out_filter), "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  location = g_strdup_printf ("%s_%u.h264", panorama->config.file_prefix,
+      index);
+  g_object_set (G_OBJECT (filesink), "location", location, "sync", FALSE,
+      "async", FALSE, NULL);
+  g_free (location);
+
+  gst_bin_add_many (GST_BIN (pipeline), queue, convert, filter, appsink,
+      appsrc, out_convert, out_filter, encoder, filesink, NULL);
+  if (!gst_element_link_many (tee, queue, convert, filter, appsink, NULL) ||
+      !gst_element_link_many (appsrc, out_convert, out_filter, encoder,
+          filesink, NULL)) {
+    g_printerr ("Failed to link the panorama elements of source %u\n",
+        index);
+    return FALSE;
+  }
+
+  source->appsrc = appsrc;
+  return TRUE;
+}
+
+/* Maps point (x, y) of a surface, in streammux coordinates, to the view. */
+static gboolean
+point_to_view (const PanoramaSource * source, guint surface_index,
+    gdouble x, gdouble y, gfloat * u, gfloat * v)
+{
+  gdouble ray[3], view_x, view_y;
+
+  if (!surface_set_point_to_ray (&source->surfaces, surface_index, x, y, ray))
+    return FALSE;
+  panorama_view_ray_to_pixel (&source->view, ray, &view_x, &view_y);
+  *u = view_x;
+  *v = view_y;
+  return TRUE;
+}
+
+static void
+add_outline (PanoramaSource * source, guint surface_index,
+    const ObjectRecord * object)
+{
+  const gdouble corners[5][2] = {
+    {object->left, object->top},
+    {object->left + object->width, object->top},
+    {object->left + object->width, object->top + object->height},
+    {object->left, object->top + object->height},
+    {object->left, object->top},
+  };
+  gboolean have_last = FALSE;
+  gfloat last_x = 0, last_y = 0;
+  guint edge, step;
+
+  for (edge = 0; edge < 4; edge++) {
+    for (step = 0; step < PANORAMA_OUTLINE_STEPS; step++) {
+      gdouble t = (gdouble) step / PANORAMA_OUTLINE_STEPS;
+      gdouble x = corners[edge][0] + t * (corners[edge + 1][0] -
+          corners[edge][0]);
+      gdouble y = corners[edge][1] + t * (corners[edge + 1][1] -
+          corners[edge][1]);
+      PanoramaSegment segment;
+      gfloat u, v;
+
+      if (!point_to_view (source, surface_index, x, y, &u, &v)) {
+        have_last = FALSE;
+        continue;
+      }
+      /* Segments across the seam of the view would span all of it. */
+      if (have_last && fabsf (u - last_x) < source->view.width / 2.0f) {
+        segment.x0 = last_x;
+        segment.y0 = last_y;
+        segment.x1 = u;
+        segment.y1 = v;
+        segment.class_id = object->class_id;
+        g_array_append_val (source->pending, segment);
+      }
+      have_last = TRUE;
+      last_x = u;
+      last_y = v;
+    }
+  }
+}
+
+void
+panorama_add_frame (Panorama * panorama, guint index,
+    const FrameRecord * record)
+{
+  PanoramaSource *source;
+  guint i;
+
+  if (!panorama->config.draw_detections || index >= panorama->num_sources)
+    return;
+  source = &panorama->sources[index];
+  if (!source->appsrc)
+    return;
+
+  if (!source->touched) {
+    g_array_set_size (source->pending, 0);
+    source->touched = TRUE;
+  }
+  for (i = 0; i < record->num_objects; i++)
+    add_outline (source, record->surface_index, &record->objects[i]);
+}
+
+void
+panorama_end_batch (Panorama * panorama)
+{
+  guint i;
+
+  for (i = 0; i < panorama->num_sources; i++) {
+    PanoramaSource *source = &panorama->sources[i];
+    GArray *swap;
+
+    if (!source->touched)
+      continue;
+    g_mutex_lock (&source->lock);
+    swap = source->current;
+    source->current = source->pending;
+    source->pending = swap;
+    g_mutex_unlock (&source->lock);
+    source->touched = FALSE;
+  }
+}
+
+void
+panorama_print_stats (Panorama * panorama)
+{
+  guint i;
+
+  for (i = 0; i < panorama->num_sources; i++) {
+    PanoramaSource *source = &panorama->sources[i];
+
+    if (!source->appsrc)
+      continue;
+    g_print ("Panorama source %u: %" G_GUINT64_FORMAT " frames, %"
+        G_GUINT64_FORMAT " dropped, %.2f ms per frame\n", i,
+        source->num_frames, source->num_dropped, source->num_frames ?
+        source->total_remap_usec / 1000.0 / source->num_frames : 0.0);
+  }
+}
+
+void
+panorama_free (Panorama * panorama)
+{
+  guint i;
+
+  if (!panorama)
+    return;
+  for (i = 0; i < panorama->num_sources; i++) {
+    PanoramaSource *source = &panorama->sources[i];
+
+    panorama_map_clear (&source->map);
+    g_array_free (source->current, TRUE);
+    g_array_free (source->pending, TRUE);
+    g_mutex_clear (&source->lock);
+  }
+  g_free (panorama->sources);
+  g_free (panorama->config.file_prefix);
+  g_free (panorama->config.map_cache_dir);
+  g_free (panorama);
+}
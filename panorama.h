@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __PANORAMA_H__
+#define __PANORAMA_H__
+
+#include <gst/gst.h>
+
+#include "app_config.h"
+#include "frame_record.h"
+#include "projection.h"
+
+/* One equirectangular 360 degree view per camera, remapped on the CPU from
+ * the fisheye frame before nvdewarper with a map computed once per source
+ * resolution, and encoded to <file-prefix>_<source>.h264. The outlines of
+ * the detections of every dewarped surface are projected back onto it, so
+ * one view shows what the tiler spreads over several surfaces.
+ *
+ * For a ceiling camera the columns span the azimuth around the optical axis
+ * and the rows the elevation from the edge of the fisheye circle at the top
+ * down to straight below the camera at the bottom. Otherwise the optical
+ * axis is the center of the view. */
+
+/* Geometry of the view, enough to place points on it. */
+typedef struct _PanoramaView
+{
+  guint width;
+  guint height;
+  gboolean ceiling;
+  /* Elevation in radians of the top row for a ceiling camera. */
+  gdouble top_elevation;
+} PanoramaView;
+
+/* Source pixel sampled for an output pixel, bilinear with 8 bit weights. */
+typedef struct _PanoramaMapEntry
+{
+  /* Byte offset of the top left sample, PANORAMA_MAP_OUTSIDE for output
+   * pixels outside the fisheye circle. */
+  guint32 offset;
+  guint8 fx;
+  guint8 fy;
+  guint16 reserved;
+} PanoramaMapEntry;
+
+#define PANORAMA_MAP_OUTSIDE G_MAXUINT32
+
+typedef struct _PanoramaMap
+{
+  PanoramaView view;
+  guint src_width;
+  guint src_height;
+  guint src_stride;
+  /* Lens as passed to panorama_map_init(), before defaults are applied. */
+  gdouble focal_length;
+  gdouble src_fov;
+  PanoramaMapEntry *entries;
+} PanoramaMap;
+
+/* src_fov is the field of view of the fisheye in degrees. */
+void panorama_view_init (PanoramaView * view, guint width, guint height,
+    gboolean ceiling, gdouble src_fov);
+
+/* Maps a ray in the camera frame to a pixel of the view. */
+void panorama_view_ray_to_pixel (const PanoramaView * view,
+    const gdouble ray[3], gdouble * x, gdouble * y);
+
+/* Computes the map from an equidistant fisheye of src_width x src_height
+ * RGBA pixels with focal_length pixels per radian. A focal length <= 0 fits
+ * src_fov to the shorter side. */
+void panorama_map_init (PanoramaMap * map, const PanoramaView * view,
+    guint src_width, guint src_height, guint src_stride,
+    gdouble focal_length, gdouble src_fov);
+
+/* Writes the width x height RGBA view of src into dst. */
+void panorama_map_remap (const PanoramaMap * map, const guint8 * src,
+    guint8 * dst);
+
+void panorama_map_clear (PanoramaMap * map);
+
+/* A map can be saved to a cache file and loaded instead of being computed
+ * again, e.g. by tools/dewarper_config_check before a deployment goes live.
+ * The file is a header with magic "DSPM", version, view and source size and
+ * lens, followed by the entries in host byte order. */
+
+/* File name of the cache of a map, distinct for every set of parameters. */
+gchar *panorama_map_cache_name (const PanoramaView * view, guint src_width,
+    guint src_height, gdouble focal_length, gdouble src_fov);
+
+gboolean panorama_map_save (const PanoramaMap * map, const gchar * file);
+
+/* Returns FALSE, leaving map untouched, if file is missing or was saved
+ * with different parameters. */
+gboolean panorama_map_load (PanoramaMap * map, const PanoramaView * view,
+    guint src_width, guint src_height, guint src_stride,
+    gdouble focal_length, gdouble src_fov, const gchar * file);
+
+typedef struct _PanoramaSegment
+{
+  gfloat x0;
+  gfloat y0;
+  gfloat x1;
+  gfloat y1;
+  gint class_id;
+} PanoramaSegment;
+
+typedef struct _PanoramaSource
+{
+  struct _Panorama *panorama;
+  guint index;
+  SurfaceSet surfaces;
+  PanoramaView view;
+  GstElement *appsrc;
+  /* Built for the size and stride of the fisheye frames, and rebuilt when
+   * they change. */
+  PanoramaMap map;
+  /* Outlines of the latest batch, and those of the batch being collected.
+   * current is guarded by lock, pending is only used by the probe. */
+  GMutex lock;
+  GArray *current;
+  GArray *pending;
+  gboolean touched;
+  /* Statistics, written by the streaming thread of the branch. */
+  guint64 num_frames;
+  guint64 num_dropped;
+  gint64 total_remap_usec;
+} PanoramaSource;
+
+typedef struct _Panorama
+{
+  PanoramaConfig config;
+  guint num_sources;
+  PanoramaSource *sources;
+} Panorama;
+
+Panorama *panorama_new (const PanoramaConfig * config, guint num_sources);
+
+/* Adds the branch of source index to pipeline, fed by tee, which carries the
+ * RGBA fisheye frames in NVMM memory. frame_width and frame_height are the
+ * streammux resolution the object coordinates refer to. */
+gboolean panorama_add_source (Panorama * panorama, guint index,
+    const gchar * dewarper_config_file, guint frame_width,
+    guint frame_height, GstElement * pipeline, GstElement * tee);
+
+/* Collects the outlines of the objects of record, a frame of source index.
+ * Called from the metadata probe. */
+void panorama_add_frame (Panorama * panorama, guint index,
+    const FrameRecord * record);
+
+/* Makes the outlines collected since the last call the ones drawn. */
+void panorama_end_batch (Panorama * panorama);
+
+void panorama_print_stats (Panorama * panorama);
+
+void panorama_free (Panorama * panorama);
+
+#endif
@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib-unix.h>
+#include <signal.h>
+#include <stdio.h>
+
+#include "gstnvdsmeta.h"
+#include "pipeline_trace.h"
+
+#define TRACE_PHASE_BEGIN 'b'
+#define TRACE_PHASE_END 'e'
+
+struct _PipelineTraceEvent
+{
+  gint64 timestamp;
+  const gchar *name;
+  /* Source buffer PTS, which streammux keeps as the buf_pts of the frame, so
+   * events before and after the muxer line up. */
+  guint64 pts;
+  /* Streammux frame number, -1 before the muxer. */
+  gint frame_num;
+  gint16 source_id;
+  /* -1 for buffers that carry all surfaces of a source frame. */
+  gint16 surface_index;
+  gchar phase;
+  /* Index of the event in the stream plus one, set last; 0 while the slot
+   * is being filled in. The writer skips slots whose sequence is not that of
+   * the event it expects there. */
+  guint seq;
+};
+
+typedef struct _TracePad
+{
+  PipelineTrace *trace;
+  gchar *name;
+  gchar phase;
+  /* Source for buffers without batch meta, -1 if unknown. */
+  gint source_id;
+} TracePad;
+
+static gboolean
+trace_dump_on_signal (gpointer user_data)
+{
+  pipeline_trace_write ((PipelineTrace *) user_data);
+  return G_SOURCE_CONTINUE;
+}
+
+PipelineTrace *
+pipeline_trace_new (const TraceConfig * config)
+{
+  PipelineTrace *trace = g_new0 (PipelineTrace, 1);
+
+  trace->capacity = 1;
+  while (trace->capacity < config->max_events)
+    trace->capacity <<= 1;
+  trace->events = g_new0 (PipelineTraceEvent, trace->capacity);
+  trace->file = g_strdup (config->file);
+  trace->start_time = g_get_monotonic_time ();
+  trace->signal_id = g_unix_signal_add (SIGUSR1, trace_dump_on_signal, trace);
+
+  return trace;
+}
+
+static inline void
+trace_add_event (PipelineTrace * trace, const gchar * name, gchar phase,
+    gint64 timestamp, gint source_id, guint64 pts, gint frame_num,
+    gint surface_index)
+{
+  PipelineTraceEvent *event;
+  guint index;
+
+  /* The counter runs freely and wraps; the capacity is a power of two, so
+   * the slot sequence stays consistent across the wrap. */
+  index = (guint) g_atomic_int_add (&trace->num_events, 1);
+  event = &trace->events[index & (trace->capacity - 1)];
+  if (g_atomic_int_get (&event->seq) != 0)
+    g_atomic_int_inc (&trace->overwritten);
+  g_atomic_int_set (&event->seq, 0);
+
+  event->timestamp = timestamp;
+  event->name = name;
+  event->pts = pts;
+  event->frame_num = frame_num;
+  event->source_id = source_id;
+  event->surface_index = surface_index;
+  event->phase = phase;
+  g_atomic_int_set (&event->seq, index + 1);
+}
+
+static GstPadProbeReturn
+trace_pad_buffer_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer u_data)
+{
+  TracePad *trace_pad = (TracePad *) u_data;
+  GstBuffer *buf = (GstBuffer *) info->data;
+  gint64 now = g_get_monotonic_time ();
+  NvDsBatchMeta *batch_meta = gst_buffer_get_nvds_batch_meta (buf);
+  NvDsMetaList *l_frame;
+
+  if (!batch_meta || !batch_meta->frame_meta_list) {
+    trace_add_event (trace_pad->trace, trace_pad->name, trace_pad->phase, now,
+        trace_pad->source_id, GST_BUFFER_PTS (buf), -1, -1);
+    return GST_PAD_PROBE_OK;
+  }
+
+  /* Frames leave in the reverse order they entered so that the spans of the
+   * surfaces of one frame nest properly in the viewer. */
+  if (trace_pad->phase == TRACE_PHASE_BEGIN) {
+    for (l_frame = batch_meta->frame_meta_list; l_frame;
+        l_frame = l_frame->next) {
+      NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) l_frame->data;
+      trace_add_event (trace_pad->trace, trace_pad->name, trace_pad->phase,
+          now, frame_meta->pad_index, frame_meta->buf_pts,
+          frame_meta->frame_num, frame_meta->surface_index);
+    }
+  } else {
+    for (l_frame = g_list_last (batch_meta->frame_meta_list); l_frame;
+        l_frame = l_frame->prev) {
+      NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) l_frame->data;
+      trace_add_event (trace_pad->trace, trace_pad->name, trace_pad->phase,
+          now, frame_meta->pad_index, frame_meta->buf_pts,
+          frame_meta->frame_num, frame_meta->surface_index);
+    }
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+trace_pad (PipelineTrace * trace, GstElement * element, GstPad * pad,
+    gint source_id)
+{
+  TracePad *trace_pad = g_new0 (TracePad, 1);
+  guint pad_index;
+
+  trace_pad->trace = trace;
+  trace_pad->name = g_strdup (GST_OBJECT_NAME (element));
+  trace_pad->source_id = source_id;
+
+  if (GST_PAD_DIRECTION (pad) == GST_PAD_SINK) {
+    trace_pad->phase = TRACE_PHASE_BEGIN;
+    if (source_id == PIPELINE_TRACE_BATCHED &&
+        sscanf (GST_OBJECT_NAME (pad), "sink_%u", &pad_index) == 1)
+      trace_pad->source_id = pad_index;
+  } else {
+    trace_pad->phase = TRACE_PHASE_END;
+  }
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, trace_pad_buffer_probe,
+      trace_pad, NULL);
+  trace->pads = g_list_prepend (trace->pads, trace_pad);
+}
+
+void
+pipeline_trace_add_element (PipelineTrace * trace, GstElement * element,
+    gint source_id)
+{
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+  gboolean done = FALSE;
+  GList *added = NULL;
+  GList *l;
+
+  if (g_list_find (trace->elements, element))
+    return;
+
+  it = gst_element_iterate_pads (element);
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:
+        added = g_list_prepend (added, g_value_get_object (&item));
+        g_value_reset (&item);
+        break;
+      case GST_ITERATOR_RESYNC:
+        g_list_free (added);
+        added = NULL;
+        gst_iterator_resync (it);
+        break;
+      case GST_ITERATOR_ERROR:
+      case GST_ITERATOR_DONE:
+        done = TRUE;
+        break;
+    }
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  /* Probes are added once the iteration, which holds the element lock, is
+   * done. */
+  for (l = added; l; l = l->next)
+    trace_pad (trace, element, GST_PAD (l->data), source_id);
+  g_list_free (added);
+
+  trace->elements = g_list_prepend (trace->elements, element);
+}
+
+void
+pipeline_trace_add_bin (PipelineTrace * trace, GstBin * bin)
+{
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+  gboolean done = FALSE;
+  GList *elements = NULL;
+  GList *l;
+
+  it = gst_bin_iterate_elements (bin);
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:{
+        GstElement *element = GST_ELEMENT (g_value_get_object (&item));
+        if (!GST_IS_BIN (element))
+          elements = g_list_prepend (elements, element);
+        g_value_reset (&item);
+        break;
+      }
+      case GST_ITERATOR_RESYNC:
+        g_list_free (elements);
+        elements = NULL;
+        gst_iterator_resync (it);
+        break;
+      case GST_ITERATOR_ERROR:
+      case GST_ITERATOR_DONE:
+        done = TRUE;
+        break;
+    }
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  for (l = elements; l; l = l->next)
+    pipeline_trace_add_element (trace, GST_ELEMENT (l->data),
+        PIPELINE_TRACE_BATCHED);
+  g_list_free (elements);
+}
+
+static void
+write_event (FILE * file, const PipelineTraceEvent * event, gint64 start_time,
+    gboolean first)
+{
+  /* Trace event timestamps are in microseconds. */
+  gint64 ts = event->timestamp - start_time;
+
+  fprintf (file, "%s\n{\"name\":\"%s", first ? "" : ",", event->name);
+  if (event->surface_index >= 0)
+    fprintf (file, " #%d", event->surface_index);
+  fprintf (file, "\",\"cat\":\"frame\",\"ph\":\"%c\"", event->phase);
+
+  /* All spans of one source frame share an id and form one row. */
+  if (event->source_id >= 0)
+    fprintf (file, ",\"id\":\"s%d.t%" G_GUINT64_FORMAT "\"",
+        event->source_id, event->pts);
+  else
+    fprintf (file, ",\"id\":\"batch.t%" G_GUINT64_FORMAT "\"", event->pts);
+
+  fprintf (file, ",\"ts\":%" G_GINT64_FORMAT ",\"pid\":1,\"tid\":%d"
+      ",\"args\":{\"source\":%d,\"pts\":%" G_GUINT64_FORMAT,
+      ts, event->source_id + 1, event->source_id, event->pts);
+  if (event->frame_num >= 0)
+    fprintf (file, ",\"frame\":%d", event->frame_num);
+  fprintf (file, ",\"surface\":%d}}", event->surface_index);
+}
+
+gboolean
+pipeline_trace_write (PipelineTrace * trace)
+{
+  gchar *tmp_file = g_strdup_printf ("%s.tmp", trace->file);
+  FILE *file;
+  guint head, first, i;
+  guint overwritten;
+  gint written = 0;
+
+  file = fopen (tmp_file, "w");
+  if (!file) {
+    g_printerr ("Failed to open trace file %s\n", tmp_file);
+    g_free (tmp_file);
+    return FALSE;
+  }
+
+  /* The latest capacity events, oldest first. Probes keep writing during the
+   * dump: an event is copied and kept only if its slot held the expected
+   * sequence before and after the copy. */
+  head = (guint) g_atomic_int_get (&trace->num_events);
+  first = head - trace->capacity;
+
+  fprintf (file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  for (i = first; i != head; i++) {
+    const PipelineTraceEvent *slot =
+        &trace->events[i & (trace->capacity - 1)];
+    PipelineTraceEvent event;
+
+    if (i + 1 == 0 || (guint) g_atomic_int_get (&slot->seq) != i + 1)
+      continue;
+    event = *slot;
+    if ((guint) g_atomic_int_get (&slot->seq) != i + 1)
+      continue;
+    write_event (file, &event, trace->start_time, written == 0);
+    written++;
+  }
+  overwritten = (guint) g_atomic_int_get (&trace->overwritten);
+  fprintf (file, "\n],\"otherData\":{\"overwritten\":%u}}\n",
+      overwritten);
+
+  if (fclose (file) != 0 || g_rename (tmp_file, trace->file) != 0) {
+    g_printerr ("Failed to write trace file %s\n", trace->file);
+    g_free (tmp_file);
+    return FALSE;
+  }
+  g_free (tmp_file);
+
+  g_print ("Trace: latest %d events written to %s, %u older ones "
+      "overwritten\n", written, trace->file, overwritten);
+  return TRUE;
+}
+
+static void
+trace_pad_free (gpointer data)
+{
+  TracePad *trace_pad = (TracePad *) data;
+
+  g_free (trace_pad->name);
+  g_free (trace_pad);
+}
+
+void
+pipeline_trace_free (PipelineTrace * trace)
+{
+  if (!trace)
+    return;
+  if (trace->signal_id)
+    g_source_remove (trace->signal_id);
+  g_list_free_full (trace->pads, trace_pad_free);
+  g_list_free (trace->elements);
+  g_free (trace->events);
+  g_free (trace->file);
+  g_free (trace);
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __PIPELINE_TRACE_H__
+#define __PIPELINE_TRACE_H__
+
+#include <gst/gst.h>
+
+#include "app_config.h"
+
+/* Per frame timeline of the pipeline in the Chrome trace event format, for
+ * chrome://tracing or Perfetto. Every element gets a probe on its sink pads
+ * (frame enters) and src pads (frame leaves). Events are keyed by source,
+ * buffer PTS and surface; unlike a count of buffers the PTS stays aligned
+ * across the muxer when frames are dropped or a source reconnects. They are
+ * written to a preallocated ring with a single atomic increment, so probes
+ * never lock or allocate. Once the ring is full the oldest events are
+ * overwritten, and counted, so a dump always holds the latest max-events
+ * events however long the app has been running. */
+
+/* Source id for elements that handle streammux batches; their events are
+ * keyed from the NvDsBatchMeta of each buffer. */
+#define PIPELINE_TRACE_BATCHED (-1)
+
+typedef struct _PipelineTraceEvent PipelineTraceEvent;
+
+typedef struct _PipelineTrace
+{
+  PipelineTraceEvent *events;
+  /* max-events rounded up to a power of two. */
+  guint capacity;
+  /* Events ever added, wrapping. */
+  guint num_events;
+  guint overwritten;
+  gint64 start_time;
+  /* Per pad probe data, freed with the trace. */
+  GList *pads;
+  GList *elements;
+  gchar *file;
+  guint signal_id;
+} PipelineTrace;
+
+PipelineTrace *pipeline_trace_new (const TraceConfig * config);
+
+/* Traces element. source_id is the index of the source chain the element
+ * belongs to, or PIPELINE_TRACE_BATCHED for elements after streammux. */
+void pipeline_trace_add_element (PipelineTrace * trace, GstElement * element,
+    gint source_id);
+
+/* Traces every element of bin that is not traced yet and is not a bin
+ * itself, as an element after streammux. Sink pads named sink_<n> that get
+ * buffers without batch meta, i.e. the streammux inputs, are keyed to
+ * source n. */
+void pipeline_trace_add_bin (PipelineTrace * trace, GstBin * bin);
+
+/* Writes the latest events, oldest first, to the configured file. */
+gboolean pipeline_trace_write (PipelineTrace * trace);
+
+void pipeline_trace_free (PipelineTrace * trace);
+
+#endif
@@ -0,0 +1,500 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "nvds_dewarper_meta.h"
+#include "projection.h"
+
+#define DEG_TO_RAD(x) ((x) * G_PI / 180.0)
+
+/* Order in which pitch (x), yaw (y) and roll (z) are applied, indexed by
+ * rot-axes. */
+static const gchar *rotation_orders[] = {
+  "XYZ", "XZY", "YXZ", "YZX", "ZXY", "ZYX"
+};
+
+SurfaceModel
+surface_model_for_projection (guint projection_type)
+{
+  switch (projection_type) {
+    case NVDS_META_SURFACE_PERSPECTIVE_PERSPECTIVE:
+    case NVDS_META_SURFACE_FISH_PERSPECTIVE:
+    case NVDS_META_SURFACE_EQUIRECT_PERSPECTIVE:
+      return SURFACE_MODEL_PERSPECTIVE;
+    case NVDS_META_SURFACE_FISH_PUSHBROOM:
+    case NVDS_META_SURFACE_EQUIRECT_PUSHBROOM:
+    case NVDS_META_SURFACE_FISH_CYL:
+    case NVDS_META_SURFACE_EQUIRECT_CYLINDER:
+      return SURFACE_MODEL_CYLINDER;
+    case NVDS_META_SURFACE_FISH_VERTCYL:
+    case NVDS_META_SURFACE_EQUIRECT_VERTCYLINDER:
+      return SURFACE_MODEL_VERTICAL_CYLINDER;
+    case NVDS_META_SURFACE_FISH_EQUIRECT:
+    case NVDS_META_SURFACE_PERSPECTIVE_EQUIRECT:
+    case NVDS_META_SURFACE_EQUIRECT_EQUIRECT:
+      return SURFACE_MODEL_EQUIRECT;
+    case NVDS_META_SURFACE_FISH_PANINI:
+    case NVDS_META_SURFACE_PERSPECTIVE_PANINI:
+    case NVDS_META_SURFACE_EQUIRECT_PANINI:
+      return SURFACE_MODEL_PANINI;
+    case NVDS_META_SURFACE_FISH_FISH:
+    case NVDS_META_SURFACE_EQUIRECT_FISHEYE:
+      return SURFACE_MODEL_FISHEYE;
+    case NVDS_META_SURFACE_EQUIRECT_STEREOGRAPHIC:
+      return SURFACE_MODEL_STEREOGRAPHIC;
+    default:
+      return SURFACE_MODEL_NONE;
+  }
+}
+
+gboolean
+surface_has_fisheye_source (guint projection_type)
+{
+  switch (projection_type) {
+    case NVDS_META_SURFACE_FISH_PUSHBROOM:
+    case NVDS_META_SURFACE_FISH_VERTCYL:
+    case NVDS_META_SURFACE_FISH_PERSPECTIVE:
+    case NVDS_META_SURFACE_FISH_FISH:
+    case NVDS_META_SURFACE_FISH_CYL:
+    case NVDS_META_SURFACE_FISH_EQUIRECT:
+    case NVDS_META_SURFACE_FISH_PANINI:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+static void
+matrix_multiply (const gdouble a[9], const gdouble b[9], gdouble out[9])
+{
+  gdouble tmp[9];
+  guint i, j;
+
+  for (i = 0; i < 3; i++)
+    for (j = 0; j < 3; j++)
+      tmp[i * 3 + j] = a[i * 3] * b[j] + a[i * 3 + 1] * b[3 + j] +
+          a[i * 3 + 2] * b[6 + j];
+  memcpy (out, tmp, sizeof (tmp));
+}
+
+static void
+axis_rotation (gchar axis, gdouble angle, gdouble m[9])
+{
+  gdouble c = cos (angle);
+  gdouble s = sin (angle);
+
+  memset (m, 0, 9 * sizeof (gdouble));
+  switch (axis) {
+    case 'X':
+      m[0] = 1;
+      m[4] = c;
+      m[5] = -s;
+      m[7] = s;
+      m[8] = c;
+      break;
+    case 'Y':
+      m[0] = c;
+      m[2] = s;
+      m[4] = 1;
+      m[6] = -s;
+      m[8] = c;
+      break;
+    default:
+      m[0] = c;
+      m[1] = -s;
+      m[3] = s;
+      m[4] = c;
+      m[8] = 1;
+      break;
+  }
+}
+
+static void
+rotate (const gdouble m[9], const gdouble in[3], gdouble out[3])
+{
+  out[0] = m[0] * in[0] + m[1] * in[1] + m[2] * in[2];
+  out[1] = m[3] * in[0] + m[4] * in[1] + m[5] * in[2];
+  out[2] = m[6] * in[0] + m[7] * in[1] + m[8] * in[2];
+}
+
+static void
+rotate_inverse (const gdouble m[9], const gdouble in[3], gdouble out[3])
+{
+  out[0] = m[0] * in[0] + m[3] * in[1] + m[6] * in[2];
+  out[1] = m[1] * in[0] + m[4] * in[1] + m[7] * in[2];
+  out[2] = m[2] * in[0] + m[5] * in[1] + m[8] * in[2];
+}
+
+static void
+normalize (gdouble v[3])
+{
+  gdouble n = sqrt (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+
+  v[0] /= n;
+  v[1] /= n;
+  v[2] /= n;
+}
+
+gboolean
+surface_projection_init (SurfaceProjection * projection,
+    const DewarperSurfaceConfig * surface)
+{
+  gdouble top = DEG_TO_RAD (surface->top_angle);
+  gdouble bottom = DEG_TO_RAD (surface->bottom_angle);
+  gdouble extent;
+  const gchar *order;
+  guint i;
+
+  memset (projection, 0, sizeof (SurfaceProjection));
+  projection->model = surface_model_for_projection (surface->projection_type);
+  projection->width = surface->width;
+  projection->height = surface->height;
+  projection->control = surface->control;
+
+  if (projection->model == SURFACE_MODEL_NONE || surface->width == 0 ||
+      surface->height == 0 || top <= bottom)
+    return FALSE;
+
+  /* The vertical extent of the surface is top-angle to bottom-angle, measured
+   * in the quantity the model is linear in. */
+  switch (projection->model) {
+    case SURFACE_MODEL_PERSPECTIVE:
+    case SURFACE_MODEL_CYLINDER:
+    case SURFACE_MODEL_PANINI:
+      if (top >= G_PI / 2 || bottom <= -G_PI / 2)
+        return FALSE;
+      projection->focal = surface->height / (tan (top) - tan (bottom));
+      projection->cy = projection->focal * tan (top);
+      break;
+    case SURFACE_MODEL_STEREOGRAPHIC:
+      extent = 2 * tan (top / 2) - 2 * tan (bottom / 2);
+      projection->focal = surface->height / extent;
+      projection->cy = projection->focal * 2 * tan (top / 2);
+      break;
+    default:
+      projection->focal = surface->height / (top - bottom);
+      projection->cy = projection->focal * top;
+      break;
+  }
+  projection->cx = surface->width / 2.0;
+
+  for (i = 0; i < 9; i++)
+    projection->rotation[i] = (i % 4 == 0);
+  order = rotation_orders[surface->rot_axes < G_N_ELEMENTS (rotation_orders) ?
+      surface->rot_axes : 0];
+  for (i = 0; i < 3; i++) {
+    gdouble m[9];
+    gdouble angle = order[i] == 'X' ? surface->pitch :
+        order[i] == 'Y' ? surface->yaw : surface->roll;
+
+    axis_rotation (order[i], DEG_TO_RAD (angle), m);
+    /* Later rotations apply to the result of the earlier ones. */
+    matrix_multiply (m, projection->rotation, projection->rotation);
+  }
+
+  return TRUE;
+}
+
+gboolean
+surface_projection_pixel_to_ray (const SurfaceProjection * projection,
+    gdouble u, gdouble v, gdouble ray[3])
+{
+  gdouble x = (u - projection->cx) / projection->focal;
+  gdouble y = (projection->cy - v) / projection->focal;
+  gdouble view[3];
+
+  switch (projection->model) {
+    case SURFACE_MODEL_PERSPECTIVE:
+      view[0] = x;
+      view[1] = -y;
+      view[2] = 1;
+      break;
+    case SURFACE_MODEL_CYLINDER:
+      view[0] = sin (x);
+      view[1] = -y;
+      view[2] = cos (x);
+      break;
+    case SURFACE_MODEL_VERTICAL_CYLINDER:
+      view[0] = x;
+      view[1] = -sin (y);
+      view[2] = cos (y);
+      break;
+    case SURFACE_MODEL_EQUIRECT:
+      view[0] = cos (y) * sin (x);
+      view[1] = -sin (y);
+      view[2] = cos (y) * cos (x);
+      break;
+    case SURFACE_MODEL_PANINI:{
+      gdouble d = projection->control;
+      gdouble k = x * x / ((d + 1) * (d + 1));
+      gdouble discriminant = k * k * d * d - (k + 1) * (k * d * d - 1);
+      gdouble cos_lon, s, lon, lat;
+
+      if (discriminant < 0)
+        return FALSE;
+      cos_lon = (-k * d + sqrt (discriminant)) / (k + 1);
+      s = (d + 1) / (d + cos_lon);
+      lon = atan2 (x, s * cos_lon);
+      lat = atan (y / s);
+      view[0] = cos (lat) * sin (lon);
+      view[1] = -sin (lat);
+      view[2] = cos (lat) * cos (lon);
+      break;
+    }
+    case SURFACE_MODEL_FISHEYE:
+    case SURFACE_MODEL_STEREOGRAPHIC:{
+      gdouble r = sqrt (x * x + y * y);
+      gdouble theta = projection->model == SURFACE_MODEL_FISHEYE ? r :
+          2 * atan (r / 2);
+
+      if (theta > G_PI)
+        return FALSE;
+      if (r < 1e-12) {
+        view[0] = view[1] = 0;
+      } else {
+        view[0] = sin (theta) * x / r;
+        view[1] = -sin (theta) * y / r;
+      }
+      view[2] = cos (theta);
+      break;
+    }
+    default:
+      return FALSE;
+  }
+
+  normalize (view);
+  rotate (projection->rotation, view, ray);
+  return TRUE;
+}
+
+gboolean
+surface_projection_ray_to_pixel (const SurfaceProjection * projection,
+    const gdouble ray[3], gdouble * u, gdouble * v)
+{
+  gdouble view[3];
+  gdouble x, y;
+
+  rotate_inverse (projection->rotation, ray, view);
+  normalize (view);
+
+  switch (projection->model) {
+    case SURFACE_MODEL_PERSPECTIVE:
+      if (view[2] <= 0)
+        return FALSE;
+      x = view[0] / view[2];
+      y = -view[1] / view[2];
+      break;
+    case SURFACE_MODEL_CYLINDER:{
+      gdouble radius = sqrt (view[0] * view[0] + view[2] * view[2]);
+
+      if (radius < 1e-12)
+        return FALSE;
+      x = atan2 (view[0], view[2]);
+      y = -view[1] / radius;
+      break;
+    }
+    case SURFACE_MODEL_VERTICAL_CYLINDER:{
+      gdouble radius = sqrt (view[1] * view[1] + view[2] * view[2]);
+
+      if (radius < 1e-12)
+        return FALSE;
+      x = view[0] / radius;
+      y = atan2 (-view[1], view[2]);
+      break;
+    }
+    case SURFACE_MODEL_EQUIRECT:
+      x = atan2 (view[0], view[2]);
+      y = asin (CLAMP (-view[1], -1.0, 1.0));
+      break;
+    case SURFACE_MODEL_PANINI:{
+      gdouble d = projection->control;
+      gdouble lon = atan2 (view[0], view[2]);
+      gdouble lat = asin (CLAMP (-view[1], -1.0, 1.0));
+      gdouble s;
+
+      if (d + cos (lon) <= 0)
+        return FALSE;
+      s = (d + 1) / (d + cos (lon));
+      x = s * sin (lon);
+      y = s * tan (lat);
+      break;
+    }
+    case SURFACE_MODEL_FISHEYE:
+    case SURFACE_MODEL_STEREOGRAPHIC:{
+      gdouble theta = acos (CLAMP (view[2], -1.0, 1.0));
+      gdouble sin_theta = sqrt (view[0] * view[0] + view[1] * view[1]);
+      gdouble r = projection->model == SURFACE_MODEL_FISHEYE ? theta :
+          2 * tan (theta / 2);
+
+      if (sin_theta < 1e-12) {
+        x = y = 0;
+      } else {
+        x = r * view[0] / sin_theta;
+        y = -r * view[1] / sin_theta;
+      }
+      break;
+    }
+    default:
+      return FALSE;
+  }
+
+  *u = projection->cx + x * projection->focal;
+  *v = projection->cy - y * projection->focal;
+  return TRUE;
+}
+
+gdouble
+surface_projection_coverage (const SurfaceProjection * projection,
+    gdouble src_fov)
+{
+  const guint steps = 20;
+  gdouble min_cos = cos (DEG_TO_RAD (MIN (src_fov, 360.0)) / 2);
+  guint x, y, inside = 0;
+
+  for (y = 0; y <= steps; y++) {
+    for (x = 0; x <= steps; x++) {
+      gdouble ray[3];
+
+      if (surface_projection_pixel_to_ray (projection,
+              projection->width * x / steps, projection->height * y / steps,
+              ray) && ray[2] >= min_cos)
+        inside++;
+    }
+  }
+  return (gdouble) inside / ((steps + 1) * (steps + 1));
+}
+
+gboolean
+surface_set_load (SurfaceSet * set, const gchar * dewarper_config_file,
+    guint frame_width, guint frame_height)
+{
+  DewarperConfig config;
+  gboolean have_lens = FALSE;
+  guint i;
+
+  memset (set, 0, sizeof (SurfaceSet));
+  if (!parse_dewarper_config (&config, dewarper_config_file))
+    return FALSE;
+
+  if (!dewarper_config_check_surface_indices (&config, dewarper_config_file))
+    return FALSE;
+
+  set->frame_width = frame_width;
+  set->frame_height = frame_height;
+  set->src_fov = SURFACE_DEFAULT_SRC_FOV;
+  for (i = 0; i < config.num_surfaces; i++) {
+    const DewarperSurfaceConfig *surface = &config.surfaces[i];
+    guint index = surface->surface_index;
+    gdouble src_fov = surface->src_fov > 0 ?
+        surface->src_fov : SURFACE_DEFAULT_SRC_FOV;
+    gdouble coverage;
+
+    set->num_surfaces = MAX (set->num_surfaces, index + 1);
+    set->surface_focal_length[index] = surface->focal_length;
+    set->surface_src_fov[index] = src_fov;
+
+    if (!surface_has_fisheye_source (surface->projection_type)) {
+      g_printerr ("[surface%u] of %s does not dewarp a fisheye, its objects "
+          "are not placed\n", surface->group_number, dewarper_config_file);
+      continue;
+    }
+    if (!surface_projection_init (&set->surfaces[index], surface)) {
+      g_printerr ("No geometry for [surface%u] of %s, its objects are not "
+          "placed\n", surface->group_number, dewarper_config_file);
+      continue;
+    }
+    coverage = surface_projection_coverage (&set->surfaces[index], src_fov);
+    if (coverage < SURFACE_MIN_COVERAGE) {
+      g_printerr ("[surface%u] of %s looks outside its src-fov=%g at %.0f%% "
+          "of its pixels, its objects are not placed\n",
+          surface->group_number, dewarper_config_file, src_fov,
+          100 * (1 - coverage));
+      continue;
+    }
+
+    if (!have_lens || src_fov > set->src_fov) {
+      set->focal_length = surface->focal_length;
+      set->src_fov = src_fov;
+      have_lens = TRUE;
+    }
+    set->valid[index] = TRUE;
+  }
+  return TRUE;
+}
+
+gboolean
+surface_set_point_to_ray (const SurfaceSet * set, guint surface_index,
+    gdouble x, gdouble y, gdouble ray[3])
+{
+  const SurfaceProjection *projection;
+
+  if (surface_index >= set->num_surfaces || !set->valid[surface_index])
+    return FALSE;
+  projection = &set->surfaces[surface_index];
+
+  return surface_projection_pixel_to_ray (projection,
+      x * projection->width / set->frame_width,
+      y * projection->height / set->frame_height, ray) &&
+      ray[2] >= cos (DEG_TO_RAD (MIN (set->surface_src_fov[surface_index],
+                  360.0)) / 2);
+}
+
+gboolean
+fisheye_ray_to_pixel (gdouble focal_length, gdouble src_fov, gdouble cx,
+    gdouble cy, const gdouble ray[3], gdouble * u, gdouble * v)
+{
+  gdouble sin_theta = sqrt (ray[0] * ray[0] + ray[1] * ray[1]);
+  gdouble theta = atan2 (sin_theta, ray[2]);
+  gdouble r = focal_length * theta;
+
+  if (theta > DEG_TO_RAD (src_fov) / 2)
+    return FALSE;
+  if (sin_theta < 1e-12) {
+    *u = cx;
+    *v = cy;
+  } else {
+    *u = cx + r * ray[0] / sin_theta;
+    *v = cy + r * ray[1] / sin_theta;
+  }
+  return TRUE;
+}
+
+void
+fisheye_pixel_to_ray (gdouble focal_length, gdouble cx, gdouble cy,
+    gdouble u, gdouble v, gdouble ray[3])
+{
+  gdouble dx = u - cx;
+  gdouble dy = v - cy;
+  gdouble r = sqrt (dx * dx + dy * dy);
+  gdouble theta = r / focal_length;
+
+  if (r < 1e-12) {
+    ray[0] = ray[1] = 0;
+  } else {
+    ray[0] = sin (theta) * dx / r;
+    ray[1] = sin (theta) * dy / r;
+  }
+  ray[2] = cos (theta);
+}
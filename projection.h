@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __PROJECTION_H__
+#define __PROJECTION_H__
+
+#include <glib.h>
+
+#include "dewarper_config.h"
+
+/* CPU side geometry of the nvdewarper surfaces. A pixel of a dewarped
+ * surface maps to a viewing ray in the frame of the source camera: x right,
+ * y down, z along the optical axis. The surface models follow the usual
+ * definitions of each projection, with the vertical extent set by top-angle
+ * and bottom-angle and the view rotated by pitch (x), yaw (y) and roll (z) in
+ * the order selected by rot-axes. Pushbroom surfaces are approximated by a
+ * cylinder. */
+
+/* Field of view of a fisheye source whose src-fov is not set, in degrees. */
+#define SURFACE_DEFAULT_SRC_FOV 180.0
+
+/* A surface is not placed if fewer of its pixels look into the fisheye, as
+ * then its model does not match what nvdewarper renders. */
+#define SURFACE_MIN_COVERAGE 0.5
+
+typedef enum
+{
+  SURFACE_MODEL_NONE,
+  SURFACE_MODEL_PERSPECTIVE,
+  SURFACE_MODEL_CYLINDER,
+  SURFACE_MODEL_VERTICAL_CYLINDER,
+  SURFACE_MODEL_EQUIRECT,
+  SURFACE_MODEL_PANINI,
+  SURFACE_MODEL_FISHEYE,
+  SURFACE_MODEL_STEREOGRAPHIC
+} SurfaceModel;
+
+typedef struct _SurfaceProjection
+{
+  SurfaceModel model;
+  gdouble width;
+  gdouble height;
+  /* Pixels per radian or per unit of tangent, depending on the model. */
+  gdouble focal;
+  gdouble cx;
+  gdouble cy;
+  /* Panini distance parameter. */
+  gdouble control;
+  /* Rotates a ray of the view into the camera frame, row major. */
+  gdouble rotation[9];
+} SurfaceProjection;
+
+/* The surfaces of one dewarper config, indexed by their surface-index,
+ * which is the surface_index streammux reports. */
+typedef struct _SurfaceSet
+{
+  /* One past the largest surface-index. Indices no group uses are not
+   * valid. */
+  guint num_surfaces;
+  gboolean valid[DEWARPER_CONFIG_MAX_SURFACES];
+  SurfaceProjection surfaces[DEWARPER_CONFIG_MAX_SURFACES];
+  /* Source lens each surface was dewarped from, src_fov in degrees. */
+  gdouble surface_focal_length[DEWARPER_CONFIG_MAX_SURFACES];
+  gdouble surface_src_fov[DEWARPER_CONFIG_MAX_SURFACES];
+  /* Lens of the valid surface with the widest src_fov, which rays are mapped
+   * back through. src_fov is SURFACE_DEFAULT_SRC_FOV and focal_length 0 if
+   * no surface is valid. */
+  gdouble focal_length;
+  gdouble src_fov;
+  /* Resolution object coordinates refer to, i.e. the streammux output. */
+  gdouble frame_width;
+  gdouble frame_height;
+} SurfaceSet;
+
+/* Returns the model used for an nvdewarper projection-type. */
+SurfaceModel surface_model_for_projection (guint projection_type);
+
+/* Returns TRUE for the projection types that dewarp a fisheye source, the
+ * only source lens modelled here. */
+gboolean surface_has_fisheye_source (guint projection_type);
+
+/* Returns FALSE for projection types without a model or degenerate angles. */
+gboolean surface_projection_init (SurfaceProjection * projection,
+    const DewarperSurfaceConfig * surface);
+
+/* Maps pixel (u, v) of the surface to a unit ray in the camera frame.
+ * Returns FALSE if the pixel is outside the domain of the projection. */
+gboolean surface_projection_pixel_to_ray (const SurfaceProjection * projection,
+    gdouble u, gdouble v, gdouble ray[3]);
+
+/* Inverse of surface_projection_pixel_to_ray(). The pixel may lie outside
+ * the surface; returns FALSE if the ray has no image. */
+gboolean surface_projection_ray_to_pixel (const SurfaceProjection * projection,
+    const gdouble ray[3], gdouble * u, gdouble * v);
+
+/* Fraction of a grid of pixels over the surface whose rays lie within
+ * src_fov degrees around the optical axis. */
+gdouble surface_projection_coverage (const SurfaceProjection * projection,
+    gdouble src_fov);
+
+/* Loads the surfaces of dewarper_config_file. Surfaces without a model, of
+ * a source that is not a fisheye, or with less than SURFACE_MIN_COVERAGE of
+ * their pixels inside their src-fov are reported and marked invalid. Fails
+ * if two surfaces share a surface-index. */
+gboolean surface_set_load (SurfaceSet * set, const gchar * dewarper_config_file,
+    guint frame_width, guint frame_height);
+
+/* Maps point (x, y) in streammux coordinates of surface surface_index to a
+ * ray in the camera frame. Returns FALSE for points the surface's lens does
+ * not see. */
+gboolean surface_set_point_to_ray (const SurfaceSet * set, guint surface_index,
+    gdouble x, gdouble y, gdouble ray[3]);
+
+/* Equidistant fisheye source with focal_length pixels per radian, centered
+ * at (cx, cy). Returns FALSE for rays outside src_fov degrees. */
+gboolean fisheye_ray_to_pixel (gdouble focal_length, gdouble src_fov,
+    gdouble cx, gdouble cy, const gdouble ray[3], gdouble * u, gdouble * v);
+
+void fisheye_pixel_to_ray (gdouble focal_length, gdouble cx, gdouble cy,
+    gdouble u, gdouble v, gdouble ray[3]);
+
+#endif
@@ -0,0 +1,991 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "roi_analytics.h"
+
+#define ROI_BUFFER_SIZE (1 << 20)
+
+#define ROI_GROUP_ZONE "zone-"
+#define ROI_GROUP_LINE "line-"
+#define ROI_SOURCE_ID "source-id"
+#define ROI_SURFACE_INDEX "surface-index"
+#define ROI_POINTS "points"
+#define ROI_DWELL "dwell-sec"
+
+/* Zones a track is followed in at once, further overlapping zones are
+ * ignored. */
+#define MAX_TRACK_ZONES 8
+/* Lost tracks are looked for every this many batches; their exits still
+ * carry the time they were last seen. */
+#define EXPIRE_INTERVAL 16
+/* Cells per side of a grid at most, larger surfaces get larger cells. */
+#define MAX_GRID_SIDE 1024
+/* Steps across more cells than this test every line of the surface. */
+#define MAX_STEP_CELLS 64
+
+#define CHECK_ERROR(error) \
+  if (error) { \
+    g_printerr ("Error while parsing config file: %s\n", error->message); \
+    goto done; \
+  }
+
+typedef struct _RoiZone
+{
+  gchar *name;
+  guint num_points;
+  /* x, y pairs. */
+  gdouble *points;
+  gint64 dwell_usec;
+  /* Statistics printed at exit. */
+  guint64 num_entries;
+  guint64 num_exits;
+  guint64 num_dwells;
+  gint64 total_dwell_usec;
+  gint occupancy;
+} RoiZone;
+
+typedef struct _RoiLine
+{
+  gchar *name;
+  guint64 num_forward;
+  guint64 num_backward;
+} RoiLine;
+
+typedef struct _RoiSegment
+{
+  guint line;
+  gdouble x0;
+  gdouble y0;
+  gdouble x1;
+  gdouble y1;
+} RoiSegment;
+
+/* A zone overlapping a grid cell. Without edges the whole cell is inside the
+ * zone; otherwise the zone edges that cross the cell decide, counted along
+ * the way from a reference point of the cell that lies on none of them. */
+typedef struct _CellZone
+{
+  guint32 zone;
+  guint32 first_edge;
+  guint32 num_edges;
+  gboolean inside;
+  gfloat ref_x;
+  gfloat ref_y;
+} CellZone;
+
+/* The regions of one surface of one stream. */
+typedef struct _RoiView
+{
+  guint source_id;
+  guint surface_index;
+  GArray *zones;
+  GArray *lines;
+  GArray *segments;
+  /* Grid over the bounding box of all regions, cells in rows. */
+  gdouble origin_x;
+  gdouble origin_y;
+  gdouble cell_size;
+  gint cols;
+  gint rows;
+  /* Entries of cell i are [start[i], start[i + 1]). */
+  guint32 *cell_zone_start;
+  CellZone *cell_zones;
+  /* Edge k of a zone runs from its point k to point k + 1. */
+  guint32 *cell_edges;
+  guint32 *cell_segment_start;
+  guint32 *cell_segments;
+  /* Step a segment was last tested for, so a step across several cells
+   * tests it once. */
+  guint32 *segment_stamps;
+  guint32 stamp;
+} RoiView;
+
+typedef struct _ZoneVisit
+{
+  guint32 zone;
+  gboolean dwell_written;
+  gint64 enter_time;
+} ZoneVisit;
+
+typedef struct _RoiTrack
+{
+  TrackKey key;
+  RoiView *view;
+  guint64 global_id;
+  /* Bottom center of the box in the last batch the track was seen. */
+  gdouble x;
+  gdouble y;
+  guint64 last_seen;
+  gint64 last_time;
+  guint num_visits;
+  ZoneVisit visits[MAX_TRACK_ZONES];
+} RoiTrack;
+
+struct _RoiAnalytics
+{
+  RoiAnalyticsConfig config;
+  FILE *file;
+  /* View per source_id and surface_index, and all views in the order of the
+   * regions file. */
+  GHashTable *views;
+  GPtrArray *view_list;
+  GHashTable *tracks;
+  guint64 num_batches;
+  guint64 batch_num;
+  /* Microseconds since the first batch, kept monotonic across replay loops
+   * and worker restarts. */
+  gboolean started;
+  gint64 first_timestamp;
+  gint64 last_timestamp;
+  gint64 time_offset;
+  gint64 now;
+  /* Statistics printed at exit. */
+  guint64 num_objects;
+  guint64 num_tracks;
+  guint64 num_edge_tests;
+  guint64 num_segment_tests;
+  guint64 num_crossings;
+};
+
+static inline gdouble
+orient (gdouble ax, gdouble ay, gdouble bx, gdouble by, gdouble px,
+    gdouble py)
+{
+  return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+/* Whether segments ab and cd cross. Points on the line of the other segment
+ * count as being on its left, so a path through a vertex shared by two
+ * edges crosses exactly one of them. */
+static inline gboolean
+segments_cross (gdouble ax, gdouble ay, gdouble bx, gdouble by, gdouble cx,
+    gdouble cy, gdouble dx, gdouble dy)
+{
+  return (orient (cx, cy, dx, dy, ax, ay) > 0) !=
+      (orient (cx, cy, dx, dy, bx, by) > 0) &&
+      (orient (ax, ay, bx, by, cx, cy) > 0) !=
+      (orient (ax, ay, bx, by, dx, dy) > 0);
+}
+
+/* Liang-Barsky clipping of a segment against a box, borders included. */
+static gboolean
+segment_hits_box (gdouble x0, gdouble y0, gdouble x1, gdouble y1,
+    gdouble left, gdouble top, gdouble right, gdouble bottom)
+{
+  gdouble p[4] = { x0 - x1, x1 - x0, y0 - y1, y1 - y0 };
+  gdouble q[4] = { x0 - left, right - x0, y0 - top, bottom - y0 };
+  gdouble t0 = 0, t1 = 1;
+  guint i;
+
+  for (i = 0; i < 4; i++) {
+    gdouble t;
+
+    if (p[i] == 0) {
+      if (q[i] < 0)
+        return FALSE;
+      continue;
+    }
+    t = q[i] / p[i];
+    if (p[i] < 0) {
+      if (t > t1)
+        return FALSE;
+      t0 = MAX (t0, t);
+    } else {
+      if (t < t0)
+        return FALSE;
+      t1 = MIN (t1, t);
+    }
+  }
+  return TRUE;
+}
+
+/* Counts crossings from a point outside the zone with the rule of
+ * segments_cross(), so points on an edge fall on the same side as in
+ * find_zones(). */
+static gboolean
+zone_contains (const RoiZone * zone, gdouble x, gdouble y)
+{
+  gdouble min_x = G_MAXDOUBLE, min_y = G_MAXDOUBLE;
+  gdouble max_x = -G_MAXDOUBLE, max_y = -G_MAXDOUBLE;
+  gdouble out_x, out_y;
+  gboolean inside = FALSE;
+  guint i, j;
+
+  for (i = 0; i < zone->num_points; i++) {
+    min_x = MIN (min_x, zone->points[2 * i]);
+    max_x = MAX (max_x, zone->points[2 * i]);
+    min_y = MIN (min_y, zone->points[2 * i + 1]);
+    max_y = MAX (max_y, zone->points[2 * i + 1]);
+  }
+  /* Irrational ratios keep the way out clear of the vertices. */
+  out_x = min_x - 1.6180339887 * (max_x - min_x + 1);
+  out_y = min_y - 1.4142135624 * (max_y - min_y + 1);
+
+  for (i = 0, j = zone->num_points - 1; i < zone->num_points; j = i++) {
+    if (segments_cross (zone->points[2 * j], zone->points[2 * j + 1],
+            zone->points[2 * i], zone->points[2 * i + 1], out_x, out_y, x, y))
+      inside = !inside;
+  }
+  return inside;
+}
+
+/* Picks a point of the cell at left, top off the lines of the edges of
+ * entry, where the inside test along one of them would be ambiguous. */
+static void
+cell_reference (const RoiZone * zone, const guint32 * edges, CellZone * entry,
+    gdouble left, gdouble top, gdouble cell_size)
+{
+  static const gdouble offsets[][2] = {
+    {0.5, 0.5}, {0.3819660113, 0.6180339887}, {0.7071067812, 0.2928932188},
+    {0.2679491924, 0.1339745962}, {0.8660254038, 0.7320508076},
+  };
+  guint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (offsets); i++) {
+    entry->ref_x = left + offsets[i][0] * cell_size;
+    entry->ref_y = top + offsets[i][1] * cell_size;
+    for (j = 0; j < entry->num_edges; j++) {
+      guint a = edges[j];
+      guint b = (a + 1) % zone->num_points;
+
+      if (orient (zone->points[2 * a], zone->points[2 * a + 1],
+              zone->points[2 * b], zone->points[2 * b + 1], entry->ref_x,
+              entry->ref_y) == 0)
+        break;
+    }
+    if (j == entry->num_edges)
+      break;
+  }
+  entry->inside = zone_contains (zone, entry->ref_x, entry->ref_y);
+}
+
+static RoiView *
+get_view (RoiAnalytics * analytics, guint source_id, guint surface_index)
+{
+  gpointer key = GUINT_TO_POINTER ((source_id << 8) | surface_index);
+  RoiView *view = g_hash_table_lookup (analytics->views, key);
+
+  if (view)
+    return view;
+  view = g_new0 (RoiView, 1);
+  view->source_id = source_id;
+  view->surface_index = surface_index;
+  view->zones = g_array_new (FALSE, TRUE, sizeof (RoiZone));
+  view->lines = g_array_new (FALSE, TRUE, sizeof (RoiLine));
+  view->segments = g_array_new (FALSE, TRUE, sizeof (RoiSegment));
+  g_hash_table_insert (analytics->views, key, view);
+  g_ptr_array_add (analytics->view_list, view);
+  return view;
+}
+
+static inline RoiView *
+find_view (RoiAnalytics * analytics, guint source_id, guint surface_index)
+{
+  if (surface_index > 0xff)
+    return NULL;
+  return g_hash_table_lookup (analytics->views,
+      GUINT_TO_POINTER ((source_id << 8) | surface_index));
+}
+
+static void
+view_free (gpointer data)
+{
+  RoiView *view = (RoiView *) data;
+  guint i;
+
+  for (i = 0; i < view->zones->len; i++) {
+    RoiZone *zone = &g_array_index (view->zones, RoiZone, i);
+
+    g_free (zone->name);
+    g_free (zone->points);
+  }
+  for (i = 0; i < view->lines->len; i++)
+    g_free (g_array_index (view->lines, RoiLine, i).name);
+  g_array_free (view->zones, TRUE);
+  g_array_free (view->lines, TRUE);
+  g_array_free (view->segments, TRUE);
+  g_free (view->cell_zone_start);
+  g_free (view->cell_zones);
+  g_free (view->cell_edges);
+  g_free (view->cell_segment_start);
+  g_free (view->cell_segments);
+  g_free (view->segment_stamps);
+  g_free (view);
+}
+
+static inline gint
+cell_column (const RoiView * view, gdouble x)
+{
+  return (gint) floor ((x - view->origin_x) / view->cell_size);
+}
+
+static inline gint
+cell_row (const RoiView * view, gdouble y)
+{
+  return (gint) floor ((y - view->origin_y) / view->cell_size);
+}
+
+/* Range of cells covering [min, max], FALSE if it misses the grid. */
+static gboolean
+cell_range (const RoiView * view, gdouble min_x, gdouble min_y,
+    gdouble max_x, gdouble max_y, gint * col0, gint * row0, gint * col1,
+    gint * row1)
+{
+  *col0 = MAX (cell_column (view, min_x), 0);
+  *row0 = MAX (cell_row (view, min_y), 0);
+  *col1 = MIN (cell_column (view, max_x), view->cols - 1);
+  *row1 = MIN (cell_row (view, max_y), view->rows - 1);
+  return *col0 <= *col1 && *row0 <= *row1;
+}
+
+static void
+build_grid (RoiView * view, guint cell_size)
+{
+  gdouble min_x = G_MAXDOUBLE, min_y = G_MAXDOUBLE;
+  gdouble max_x = -G_MAXDOUBLE, max_y = -G_MAXDOUBLE;
+  GArray **cell_zones, **cell_segments;
+  GArray *edges;
+  guint num_cells, i, j, k, total;
+  gint col, row, col0, row0, col1, row1;
+
+  for (i = 0; i < view->zones->len; i++) {
+    RoiZone *zone = &g_array_index (view->zones, RoiZone, i);
+
+    for (j = 0; j < zone->num_points; j++) {
+      min_x = MIN (min_x, zone->points[2 * j]);
+      max_x = MAX (max_x, zone->points[2 * j]);
+      min_y = MIN (min_y, zone->points[2 * j + 1]);
+      max_y = MAX (max_y, zone->points[2 * j + 1]);
+    }
+  }
+  for (i = 0; i < view->segments->len; i++) {
+    RoiSegment *segment = &g_array_index (view->segments, RoiSegment, i);
+
+    min_x = MIN (min_x, MIN (segment->x0, segment->x1));
+    max_x = MAX (max_x, MAX (segment->x0, segment->x1));
+    min_y = MIN (min_y, MIN (segment->y0, segment->y1));
+    max_y = MAX (max_y, MAX (segment->y0, segment->y1));
+  }
+
+  view->origin_x = min_x;
+  view->origin_y = min_y;
+  view->cell_size = MAX ((gdouble) cell_size,
+      MAX (max_x - min_x, max_y - min_y) / (MAX_GRID_SIDE - 1));
+  view->cols = cell_column (view, max_x) + 1;
+  view->rows = cell_row (view, max_y) + 1;
+  num_cells = view->cols * view->rows;
+
+  cell_zones = g_new0 (GArray *, num_cells);
+  cell_segments = g_new0 (GArray *, num_cells);
+  edges = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  for (i = 0; i < view->zones->len; i++) {
+    RoiZone *zone = &g_array_index (view->zones, RoiZone, i);
+    gdouble zone_min_x = G_MAXDOUBLE, zone_min_y = G_MAXDOUBLE;
+    gdouble zone_max_x = -G_MAXDOUBLE, zone_max_y = -G_MAXDOUBLE;
+
+    for (j = 0; j < zone->num_points; j++) {
+      zone_min_x = MIN (zone_min_x, zone->points[2 * j]);
+      zone_max_x = MAX (zone_max_x, zone->points[2 * j]);
+      zone_min_y = MIN (zone_min_y, zone->points[2 * j + 1]);
+      zone_max_y = MAX (zone_max_y, zone->points[2 * j + 1]);
+    }
+    cell_range (view, zone_min_x, zone_min_y, zone_max_x, zone_max_y, &col0,
+        &row0, &col1, &row1);
+
+    for (row = row0; row <= row1; row++) {
+      for (col = col0; col <= col1; col++) {
+        gdouble left = view->origin_x + col * view->cell_size;
+        gdouble top = view->origin_y + row * view->cell_size;
+        gdouble right = left + view->cell_size;
+        gdouble bottom = top + view->cell_size;
+        CellZone entry;
+
+        entry.zone = i;
+        entry.first_edge = edges->len;
+        for (j = 0; j < zone->num_points; j++) {
+          k = (j + 1) % zone->num_points;
+          if (segment_hits_box (zone->points[2 * j], zone->points[2 * j + 1],
+                  zone->points[2 * k], zone->points[2 * k + 1], left, top,
+                  right, bottom)) {
+            guint32 edge = j;
+
+            g_array_append_val (edges, edge);
+          }
+        }
+        entry.num_edges = edges->len - entry.first_edge;
+        cell_reference (zone, &g_array_index (edges, guint32,
+                entry.first_edge), &entry, left, top, view->cell_size);
+        if (!entry.num_edges && !entry.inside)
+          continue;
+
+        if (!cell_zones[row * view->cols + col])
+          cell_zones[row * view->cols + col] =
+              g_array_new (FALSE, FALSE, sizeof (CellZone));
+        g_array_append_val (cell_zones[row * view->cols + col], entry);
+      }
+    }
+  }
+
+  for (i = 0; i < view->segments->len; i++) {
+    RoiSegment *segment = &g_array_index (view->segments, RoiSegment, i);
+    guint32 index = i;
+
+    cell_range (view, MIN (segment->x0, segment->x1), MIN (segment->y0,
+            segment->y1), MAX (segment->x0, segment->x1),
+        MAX (segment->y0, segment->y1), &col0, &row0, &col1, &row1);
+    for (row = row0; row <= row1; row++) {
+      for (col = col0; col <= col1; col++) {
+        gdouble left = view->origin_x + col * view->cell_size;
+        gdouble top = view->origin_y + row * view->cell_size;
+
+        if (!segment_hits_box (segment->x0, segment->y0, segment->x1,
+                segment->y1, left, top, left + view->cell_size,
+                top + view->cell_size))
+          continue;
+        if (!cell_segments[row * view->cols + col])
+          cell_segments[row * view->cols + col] =
+              g_array_new (FALSE, FALSE, sizeof (guint32));
+        g_array_append_val (cell_segments[row * view->cols + col], index);
+      }
+    }
+  }
+
+  /* Packed into one array per kind, the lists of a cell are adjacent. */
+  view->cell_zone_start = g_new (guint32, num_cells + 1);
+  view->cell_segment_start = g_new (guint32, num_cells + 1);
+  for (i = 0, total = 0; i < num_cells; i++) {
+    view->cell_zone_start[i] = total;
+    total += cell_zones[i] ? cell_zones[i]->len : 0;
+  }
+  view->cell_zone_start[num_cells] = total;
+  view->cell_zones = g_new (CellZone, MAX (total, 1));
+  for (i = 0, total = 0; i < num_cells; i++) {
+    view->cell_segment_start[i] = total;
+    total += cell_segments[i] ? cell_segments[i]->len : 0;
+  }
+  view->cell_segment_start[num_cells] = total;
+  view->cell_segments = g_new (guint32, MAX (total, 1));
+
+  for (i = 0; i < num_cells; i++) {
+    if (cell_zones[i]) {
+      memcpy (&view->cell_zones[view->cell_zone_start[i]],
+          cell_zones[i]->data, cell_zones[i]->len * sizeof (CellZone));
+      g_array_free (cell_zones[i], TRUE);
+    }
+    if (cell_segments[i]) {
+      memcpy (&view->cell_segments[view->cell_segment_start[i]],
+          cell_segments[i]->data, cell_segments[i]->len * sizeof (guint32));
+      g_array_free (cell_segments[i], TRUE);
+    }
+  }
+  view->cell_edges = (guint32 *) g_array_free (edges, FALSE);
+  view->segment_stamps = g_new0 (guint32, MAX (view->segments->len, 1));
+  g_free (cell_zones);
+  g_free (cell_segments);
+}
+
+static gboolean
+load_regions (RoiAnalytics * analytics, const gchar * regions_file)
+{
+  gboolean ret = FALSE;
+  GError *error = NULL;
+  GKeyFile *key_file = g_key_file_new ();
+  gchar **groups = NULL;
+  gchar **group = NULL;
+  gdouble *points = NULL;
+  guint i;
+
+  if (!g_key_file_load_from_file (key_file, regions_file, G_KEY_FILE_NONE,
+          &error)) {
+    g_printerr ("Failed to load regions file %s: %s\n", regions_file,
+        error->message);
+    goto done;
+  }
+
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (group = groups; *group; group++) {
+    gboolean is_zone = g_str_has_prefix (*group, ROI_GROUP_ZONE);
+    guint source_id, surface_index = 0;
+    gsize length = 0;
+    RoiView *view;
+
+    if (!is_zone && !g_str_has_prefix (*group, ROI_GROUP_LINE)) {
+      g_printerr ("Unknown group [%s] in %s\n", *group, regions_file);
+      continue;
+    }
+
+    source_id = g_key_file_get_integer (key_file, *group, ROI_SOURCE_ID,
+        &error);
+    CHECK_ERROR (error);
+    if (g_key_file_has_key (key_file, *group, ROI_SURFACE_INDEX, NULL)) {
+      surface_index = g_key_file_get_integer (key_file, *group,
+          ROI_SURFACE_INDEX, &error);
+      CHECK_ERROR (error);
+    }
+    if (surface_index > 0xff) {
+      g_printerr ("%s must be < 256 in group [%s]\n", ROI_SURFACE_INDEX,
+          *group);
+      goto done;
+    }
+    points = g_key_file_get_double_list (key_file, *group, ROI_POINTS,
+        &length, &error);
+    CHECK_ERROR (error);
+    if (length % 2 || length < (is_zone ? 6 : 4)) {
+      g_printerr ("%s needs x;y pairs of at least %u points in group [%s]\n",
+          ROI_POINTS, is_zone ? 3 : 2, *group);
+      goto done;
+    }
+
+    view = get_view (analytics, source_id, surface_index);
+    if (is_zone) {
+      RoiZone zone = { 0 };
+
+      zone.name = g_strdup (*group + strlen (ROI_GROUP_ZONE));
+      zone.num_points = length / 2;
+      zone.points = points;
+      points = NULL;
+      if (g_key_file_has_key (key_file, *group, ROI_DWELL, NULL)) {
+        zone.dwell_usec = g_key_file_get_double (key_file, *group, ROI_DWELL,
+            &error) * G_USEC_PER_SEC;
+        if (error) {
+          g_free (zone.name);
+          g_free (zone.points);
+        }
+        CHECK_ERROR (error);
+      }
+      g_array_append_val (view->zones, zone);
+    } else {
+      RoiLine line = { 0 };
+
+      line.name = g_strdup (*group + strlen (ROI_GROUP_LINE));
+      g_array_append_val (view->lines, line);
+      for (i = 0; i + 3 < length; i += 2) {
+        RoiSegment segment;
+
+        segment.line = view->lines->len - 1;
+        segment.x0 = points[i];
+        segment.y0 = points[i + 1];
+        segment.x1 = points[i + 2];
+        segment.y1 = points[i + 3];
+        g_array_append_val (view->segments, segment);
+      }
+      g_free (points);
+      points = NULL;
+    }
+  }
+
+  for (i = 0; i < analytics->view_list->len; i++)
+    build_grid (g_ptr_array_index (analytics->view_list, i),
+        analytics->config.cell_size);
+
+  ret = TRUE;
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (groups) {
+    g_strfreev (groups);
+  }
+  g_free (points);
+  g_key_file_free (key_file);
+  return ret;
+}
+
+RoiAnalytics *
+roi_analytics_new (const RoiAnalyticsConfig * config)
+{
+  RoiAnalytics *analytics = g_new0 (RoiAnalytics, 1);
+
+  analytics->config = *config;
+  /* The config strings stay owned by the AppConfig. */
+  analytics->config.file = NULL;
+  analytics->config.regions_file = NULL;
+  analytics->views = g_hash_table_new (g_direct_hash, g_direct_equal);
+  analytics->view_list = g_ptr_array_new_with_free_func (view_free);
+  analytics->tracks = g_hash_table_new_full (track_key_hash, track_key_equal,
+      NULL, g_free);
+
+  if (!load_regions (analytics, config->regions_file)) {
+    roi_analytics_free (analytics);
+    return NULL;
+  }
+
+  analytics->file = fopen (config->file, "w");
+  if (!analytics->file) {
+    g_printerr ("Failed to open ROI event file %s\n", config->file);
+    roi_analytics_free (analytics);
+    return NULL;
+  }
+  setvbuf (analytics->file, NULL, _IOFBF, ROI_BUFFER_SIZE);
+  return analytics;
+}
+
+static void
+write_event (RoiAnalytics * analytics, gchar type, gint64 time,
+    const RoiTrack * track, const gchar * name)
+{
+  fprintf (analytics->file, "%c %" G_GUINT64_FORMAT " %.3f %u %u %"
+      G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %s", type,
+      analytics->batch_num, time / (gdouble) G_USEC_PER_SEC,
+      track->key.source_id, track->key.surface_index, track->key.object_id,
+      track->global_id, name);
+}
+
+static void
+leave_zone (RoiAnalytics * analytics, RoiTrack * track, guint index,
+    gint64 time)
+{
+  ZoneVisit *visit = &track->visits[index];
+  RoiZone *zone = &g_array_index (track->view->zones, RoiZone, visit->zone);
+  gint64 dwell = MAX (time - visit->enter_time, 0);
+
+  write_event (analytics, 'X', time, track, zone->name);
+  fprintf (analytics->file, " %.3f\n", dwell / (gdouble) G_USEC_PER_SEC);
+  zone->num_exits++;
+  zone->total_dwell_usec += dwell;
+  zone->occupancy--;
+  track->visits[index] = track->visits[--track->num_visits];
+}
+
+/* Zones of the view that contain (x, y), at most MAX_TRACK_ZONES. */
+static guint
+find_zones (RoiAnalytics * analytics, const RoiView * view, gdouble x,
+    gdouble y, guint32 * zones)
+{
+  gint col = cell_column (view, x);
+  gint row = cell_row (view, y);
+  guint num_zones = 0;
+  guint cell, i, j;
+
+  if (col < 0 || row < 0 || col >= view->cols || row >= view->rows)
+    return 0;
+  cell = row * view->cols + col;
+
+  for (i = view->cell_zone_start[cell]; i < view->cell_zone_start[cell + 1];
+      i++) {
+    const CellZone *entry = &view->cell_zones[i];
+    const RoiZone *zone = &g_array_index (view->zones, RoiZone, entry->zone);
+    gboolean inside = entry->inside;
+
+    for (j = 0; j < entry->num_edges; j++) {
+      guint a = view->cell_edges[entry->first_edge + j];
+      guint b = (a + 1) % zone->num_points;
+
+      if (segments_cross (zone->points[2 * a], zone->points[2 * a + 1],
+              zone->points[2 * b], zone->points[2 * b + 1], entry->ref_x,
+              entry->ref_y, x, y))
+        inside = !inside;
+    }
+    analytics->num_edge_tests += entry->num_edges;
+    if (inside && num_zones < MAX_TRACK_ZONES)
+      zones[num_zones++] = entry->zone;
+  }
+  return num_zones;
+}
+
+static void
+update_zones (RoiAnalytics * analytics, RoiTrack * track, gdouble x,
+    gdouble y)
+{
+  guint32 zones[MAX_TRACK_ZONES];
+  guint num_zones = find_zones (analytics, track->view, x, y, zones);
+  guint i, j;
+
+  for (i = 0; i < track->num_visits;) {
+    for (j = 0; j < num_zones && zones[j] != track->visits[i].zone; j++);
+    if (j == num_zones)
+      leave_zone (analytics, track, i, analytics->now);
+    else
+      i++;
+  }
+
+  for (j = 0; j < num_zones; j++) {
+    RoiZone *zone = &g_array_index (track->view->zones, RoiZone, zones[j]);
+    ZoneVisit *visit = NULL;
+
+    for (i = 0; i < track->num_visits; i++) {
+      if (track->visits[i].zone == zones[j]) {
+        visit = &track->visits[i];
+        break;
+      }
+    }
+
+    if (!visit) {
+      visit = &track->visits[track->num_visits++];
+      visit->zone = zones[j];
+      visit->dwell_written = FALSE;
+      visit->enter_time = analytics->now;
+      write_event (analytics, 'E', analytics->now, track, zone->name);
+      fputc ('\n', analytics->file);
+      zone->num_entries++;
+      zone->occupancy++;
+    }
+
+    if (zone->dwell_usec > 0 && !visit->dwell_written &&
+        analytics->now - visit->enter_time >= zone->dwell_usec) {
+      write_event (analytics, 'W', analytics->now, track, zone->name);
+      fprintf (analytics->file, " %.3f\n",
+          (analytics->now - visit->enter_time) / (gdouble) G_USEC_PER_SEC);
+      visit->dwell_written = TRUE;
+      zone->num_dwells++;
+    }
+  }
+}
+
+static void
+test_segment (RoiAnalytics * analytics, RoiTrack * track, guint index,
+    gdouble x, gdouble y)
+{
+  RoiView *view = track->view;
+  const RoiSegment *segment =
+      &g_array_index (view->segments, RoiSegment, index);
+  RoiLine *line;
+  gboolean right;
+
+  if (view->segment_stamps[index] == view->stamp)
+    return;
+  view->segment_stamps[index] = view->stamp;
+  analytics->num_segment_tests++;
+
+  if (!segments_cross (track->x, track->y, x, y, segment->x0, segment->y0,
+          segment->x1, segment->y1))
+    return;
+
+  /* With y pointing down, positive is to the right of the segment. */
+  right = orient (segment->x0, segment->y0, segment->x1, segment->y1, x,
+      y) > 0;
+  line = &g_array_index (view->lines, RoiLine, segment->line);
+  if (right)
+    line->num_forward++;
+  else
+    line->num_backward++;
+  analytics->num_crossings++;
+  write_event (analytics, 'C', analytics->now, track, line->name);
+  fprintf (analytics->file, " %d\n", right ? 1 : -1);
+}
+
+static void
+update_lines (RoiAnalytics * analytics, RoiTrack * track, gdouble x,
+    gdouble y)
+{
+  RoiView *view = track->view;
+  gint col, row, col0, row0, col1, row1;
+  guint i;
+
+  if (!view->segments->len ||
+      !cell_range (view, MIN (track->x, x), MIN (track->y, y),
+          MAX (track->x, x), MAX (track->y, y), &col0, &row0, &col1, &row1))
+    return;
+
+  if (++view->stamp == 0) {
+    memset (view->segment_stamps, 0, view->segments->len * sizeof (guint32));
+    view->stamp = 1;
+  }
+
+  if ((col1 - col0 + 1) * (row1 - row0 + 1) > MAX_STEP_CELLS) {
+    for (i = 0; i < view->segments->len; i++)
+      test_segment (analytics, track, i, x, y);
+    return;
+  }
+
+  for (row = row0; row <= row1; row++) {
+    for (col = col0; col <= col1; col++) {
+      guint cell = row * view->cols + col;
+
+      for (i = view->cell_segment_start[cell];
+          i < view->cell_segment_start[cell + 1]; i++)
+        test_segment (analytics, track, view->cell_segments[i], x, y);
+    }
+  }
+}
+
+static void
+process_object (RoiAnalytics * analytics, RoiView * view,
+    const FrameRecord * record, const ObjectRecord * object,
+    GlobalTracker * global_tracker)
+{
+  gdouble x = object->left + object->width / 2;
+  gdouble y = object->top + object->height;
+  gboolean seen = TRUE;
+  RoiTrack *track;
+  TrackKey key;
+
+  key.object_id = object->object_id;
+  key.source_id = record->source_id;
+  key.surface_index = record->surface_index;
+
+  track = (RoiTrack *) g_hash_table_lookup (analytics->tracks, &key);
+  if (!track) {
+    track = g_new0 (RoiTrack, 1);
+    track->key = key;
+    track->view = view;
+    g_hash_table_insert (analytics->tracks, &track->key, track);
+    analytics->num_tracks++;
+    seen = FALSE;
+  }
+  /* A new track may only get its global id a few batches later. */
+  if (global_tracker && !track->global_id)
+    track->global_id = global_tracker_lookup (global_tracker, &key);
+
+  update_zones (analytics, track, x, y);
+  if (seen)
+    update_lines (analytics, track, x, y);
+
+  track->x = x;
+  track->y = y;
+  track->last_seen = analytics->num_batches;
+  track->last_time = analytics->now;
+}
+
+static void
+expire_tracks (RoiAnalytics * analytics)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, analytics->tracks);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    RoiTrack *track = (RoiTrack *) value;
+
+    if (analytics->num_batches - track->last_seen <=
+        analytics->config.max_missed_batches)
+      continue;
+    while (track->num_visits)
+      leave_zone (analytics, track, 0, track->last_time);
+    g_hash_table_iter_remove (&iter);
+  }
+}
+
+gboolean
+roi_analytics_process_batch (RoiAnalytics * analytics,
+    const FrameRecordBatch * batch, GlobalTracker * global_tracker)
+{
+  guint i, j;
+
+  if (!analytics->started) {
+    analytics->started = TRUE;
+    analytics->first_timestamp = batch->timestamp;
+    analytics->last_timestamp = batch->timestamp;
+  }
+  if (batch->timestamp < analytics->last_timestamp)
+    analytics->time_offset += analytics->last_timestamp - batch->timestamp;
+  analytics->last_timestamp = batch->timestamp;
+  analytics->now = batch->timestamp + analytics->time_offset -
+      analytics->first_timestamp;
+  analytics->batch_num = batch->batch_num;
+
+  for (i = 0; i < batch->num_frames; i++) {
+    const FrameRecord *record = batch->frames[i];
+    RoiView *view = find_view (analytics, record->source_id,
+        record->surface_index);
+
+    if (!view)
+      continue;
+    for (j = 0; j < record->num_objects; j++) {
+      const ObjectRecord *object = &record->objects[j];
+
+      if (object->object_id == UNTRACKED_OBJECT_ID ||
+          (analytics->config.class_id >= 0 &&
+              object->class_id != analytics->config.class_id))
+        continue;
+      analytics->num_objects++;
+      process_object (analytics, view, record, object, global_tracker);
+    }
+  }
+
+  analytics->num_batches++;
+  if (analytics->num_batches % EXPIRE_INTERVAL == 0)
+    expire_tracks (analytics);
+
+  return !ferror (analytics->file);
+}
+
+void
+roi_analytics_print_stats (RoiAnalytics * analytics)
+{
+  guint i, j;
+
+  g_print ("ROI analytics: %" G_GUINT64_FORMAT " objects of %"
+      G_GUINT64_FORMAT " tracks, %.2f zone edges and %.2f line segments "
+      "tested per object, %" G_GUINT64_FORMAT " line crossings\n",
+      analytics->num_objects, analytics->num_tracks,
+      analytics->num_objects ?
+      (gdouble) analytics->num_edge_tests / analytics->num_objects : 0.0,
+      analytics->num_objects ?
+      (gdouble) analytics->num_segment_tests / analytics->num_objects : 0.0,
+      analytics->num_crossings);
+
+  for (i = 0; i < analytics->view_list->len; i++) {
+    RoiView *view = g_ptr_array_index (analytics->view_list, i);
+
+    for (j = 0; j < view->zones->len; j++) {
+      RoiZone *zone = &g_array_index (view->zones, RoiZone, j);
+
+      g_print ("ROI zone %s (source %u surface %u): %" G_GUINT64_FORMAT
+          " entries, %" G_GUINT64_FORMAT " exits, %" G_GUINT64_FORMAT
+          " dwells, %.1f s mean dwell, %d inside\n", zone->name,
+          view->source_id, view->surface_index, zone->num_entries,
+          zone->num_exits, zone->num_dwells, zone->num_exits ?
+          zone->total_dwell_usec / (gdouble) G_USEC_PER_SEC /
+          zone->num_exits : 0.0, zone->occupancy);
+    }
+    for (j = 0; j < view->lines->len; j++) {
+      RoiLine *line = &g_array_index (view->lines, RoiLine, j);
+
+      g_print ("ROI line %s (source %u surface %u): %" G_GUINT64_FORMAT
+          " forward, %" G_GUINT64_FORMAT " backward\n", line->name,
+          view->source_id, view->surface_index, line->num_forward,
+          line->num_backward);
+    }
+  }
+}
+
+void
+roi_analytics_free (RoiAnalytics * analytics)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  if (!analytics)
+    return;
+
+  if (analytics->file) {
+    g_hash_table_iter_init (&iter, analytics->tracks);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+      RoiTrack *track = (RoiTrack *) value;
+
+      while (track->num_visits)
+        leave_zone (analytics, track, 0, track->last_time);
+    }
+    fclose (analytics->file);
+  }
+  g_hash_table_destroy (analytics->tracks);
+  g_hash_table_destroy (analytics->views);
+  g_ptr_array_free (analytics->view_list, TRUE);
+  g_free (analytics);
+}
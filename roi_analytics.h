@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __ROI_ANALYTICS_H__
+#define __ROI_ANALYTICS_H__
+
+#include <glib.h>
+
+#include "app_config.h"
+#include "frame_record.h"
+#include "global_tracker.h"
+
+/* Zone and line counting on the tracker output. Regions are given in the
+ * streammux coordinates of one dewarped surface of one stream, named by the
+ * surface-index it has in the dewarper config of the stream, one group per
+ * region in regions-file:
+ *
+ *   [zone-<name>]                [line-<name>]
+ *   source-id=0                  source-id=0
+ *   surface-index=0              surface-index=1
+ *   points=x0;y0;x1;y1;x2;y2...  points=x0;y0;x1;y1...
+ *   dwell-sec=30
+ *
+ * A zone is a simple polygon, a line a polyline. Every track is followed by
+ * the bottom center of its box, and every batch only the regions stored in
+ * the cells of a grid over the surface that the point, or its step since the
+ * last batch, touches are tested. Events are written one per line:
+ *
+ *   E <batch> <time> <source> <surface> <id> <global id> <zone>
+ *   X <batch> <time> <source> <surface> <id> <global id> <zone> <dwell>
+ *   W <batch> <time> <source> <surface> <id> <global id> <zone> <dwell>
+ *   C <batch> <time> <source> <surface> <id> <global id> <line> <direction>
+ *
+ * E and X are a track entering and leaving a zone; a track that is lost
+ * leaves at the time it was last seen. W is written once a track stayed
+ * dwell-sec in a zone. C is a crossing of a line, direction 1 from its left
+ * to its right side looking from its first to its last point on the
+ * surface, -1 the other way. Times and dwell are in seconds since the first
+ * batch; the global id is 0 without [global-tracking]. */
+
+typedef struct _RoiAnalytics RoiAnalytics;
+
+RoiAnalytics *roi_analytics_new (const RoiAnalyticsConfig * config);
+
+/* global_tracker may be NULL. */
+gboolean roi_analytics_process_batch (RoiAnalytics * analytics,
+    const FrameRecordBatch * batch, GlobalTracker * global_tracker);
+
+void roi_analytics_print_stats (RoiAnalytics * analytics);
+
+/* Writes the exits of the tracks still in a zone before closing the file. */
+void roi_analytics_free (RoiAnalytics * analytics);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <sys/mman.h>
+
+#include "shm_ring.h"
+
+#define CACHE_LINE_SIZE 64
+#define SLOT_ALIGN 64
+
+/* head and tail are free running counters, each written by one side only.
+ * They are unsigned so that they wrap, and head - tail stays the number of
+ * committed slots across the wrap. They live on separate cache lines so the
+ * two processes do not false-share while polling. beats is written by the
+ * producer only and shares the line of head. */
+struct _ShmRingHeader
+{
+  guint num_slots;
+  guint slot_size;
+  guint dropped;
+  guint head __attribute__ ((aligned (CACHE_LINE_SIZE)));
+  guint beats;
+  guint tail __attribute__ ((aligned (CACHE_LINE_SIZE)));
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+ShmRing *
+shm_ring_new (guint num_slots, gsize slot_size)
+{
+  ShmRing *ring;
+  guint slots = 1;
+  gsize aligned_slot_size = (slot_size + SLOT_ALIGN - 1) & ~(gsize) (SLOT_ALIGN - 1);
+  gsize map_size;
+  gpointer map;
+
+  while (slots < num_slots)
+    slots <<= 1;
+
+  map_size = sizeof (ShmRingHeader) + (gsize) slots * aligned_slot_size;
+  map = mmap (NULL, map_size, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED) {
+    g_printerr ("Failed to map %" G_GSIZE_FORMAT " bytes of shared memory\n",
+        map_size);
+    return NULL;
+  }
+
+  ring = g_new0 (ShmRing, 1);
+  ring->header = (ShmRingHeader *) map;
+  ring->slots = (guint8 *) map + sizeof (ShmRingHeader);
+  ring->map_size = map_size;
+  ring->header->num_slots = slots;
+  ring->header->slot_size = aligned_slot_size;
+
+  return ring;
+}
+
+static inline guint8 *
+shm_ring_slot (ShmRing * ring, guint counter)
+{
+  return ring->slots + (gsize) (counter & (ring->header->num_slots - 1)) *
+      ring->header->slot_size;
+}
+
+gpointer
+shm_ring_reserve (ShmRing * ring)
+{
+  guint head = ring->header->head;
+  guint tail = g_atomic_int_get (&ring->header->tail);
+
+  if (head - tail >= ring->header->num_slots) {
+    g_atomic_int_add (&ring->header->dropped, 1);
+    return NULL;
+  }
+  return shm_ring_slot (ring, head);
+}
+
+void
+shm_ring_commit (ShmRing * ring)
+{
+  /* Publishing the new head is the release point for the slot contents. */
+  g_atomic_int_set (&ring->header->head, ring->header->head + 1u);
+}
+
+gconstpointer
+shm_ring_peek (ShmRing * ring)
+{
+  guint tail = ring->header->tail;
+  guint head = g_atomic_int_get (&ring->header->head);
+
+  if (head == tail)
+    return NULL;
+  return shm_ring_slot (ring, tail);
+}
+
+void
+shm_ring_release (ShmRing * ring)
+{
+  g_atomic_int_set (&ring->header->tail, ring->header->tail + 1u);
+}
+
+gconstpointer
+shm_ring_peek_at (ShmRing * ring, guint offset)
+{
+  guint tail = ring->header->tail;
+  guint head = g_atomic_int_get (&ring->header->head);
+
+  if (head - tail <= offset)
+    return NULL;
+  return shm_ring_slot (ring, tail + offset);
+}
+
+void
+shm_ring_release_n (ShmRing * ring, guint count)
+{
+  g_atomic_int_set (&ring->header->tail, ring->header->tail + count);
+}
+
+void
+shm_ring_beat (ShmRing * ring)
+{
+  g_atomic_int_set (&ring->header->beats, ring->header->beats + 1u);
+}
+
+guint
+shm_ring_beats (ShmRing * ring)
+{
+  return g_atomic_int_get (&ring->header->beats);
+}
+
+guint
+shm_ring_capacity (ShmRing * ring)
+{
+  return ring->header->num_slots;
+}
+
+guint
+shm_ring_dropped (ShmRing * ring)
+{
+  return g_atomic_int_get (&ring->header->dropped);
+}
+
+void
+shm_ring_free (ShmRing * ring)
+{
+  if (!ring)
+    return;
+  munmap (ring->header, ring->map_size);
+  g_free (ring);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SHM_RING_H__
+#define __SHM_RING_H__
+
+#include <glib.h>
+
+/* Single producer / single consumer ring of fixed size slots placed in
+ * shared memory. The ring must be created before fork() so that both the
+ * producer and the consumer process map the same pages. Slots are written and
+ * read in place, so a record is never copied between processes.
+ *
+ * The producer never blocks: when the ring is full the record is dropped and
+ * counted, so a slow consumer cannot stall a pipeline. */
+
+typedef struct _ShmRingHeader ShmRingHeader;
+
+typedef struct _ShmRing
+{
+  ShmRingHeader *header;
+  guint8 *slots;
+  gsize map_size;
+} ShmRing;
+
+/* num_slots is rounded up to a power of two. */
+ShmRing *shm_ring_new (guint num_slots, gsize slot_size);
+
+/* Producer side. Returns a slot to fill or NULL if the ring is full. */
+gpointer shm_ring_reserve (ShmRing * ring);
+void shm_ring_commit (ShmRing * ring);
+
+/* Consumer side. Returns the oldest committed slot or NULL if empty. */
+gconstpointer shm_ring_peek (ShmRing * ring);
+void shm_ring_release (ShmRing * ring);
+
+/* Returns the committed slot offset places after the oldest one, or NULL.
+ * Lets the consumer look at several slots before releasing them together
+ * with shm_ring_release_n(). */
+gconstpointer shm_ring_peek_at (ShmRing * ring, guint offset);
+void shm_ring_release_n (ShmRing * ring, guint count);
+
+/* Heartbeat of the producer, a free running counter it bumps whenever it
+ * makes progress, whether or not a slot was free. The consumer only compares
+ * successive values, so the two processes need no common clock. */
+void shm_ring_beat (ShmRing * ring);
+guint shm_ring_beats (ShmRing * ring);
+
+guint shm_ring_capacity (ShmRing * ring);
+
+guint shm_ring_dropped (ShmRing * ring);
+
+void shm_ring_free (ShmRing * ring);
+
+#endif
@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gst/gst.h>
+
+#include "source_health.h"
+
+#define WATCHDOG_INTERVAL_MSEC 1000
+
+static gboolean retry_source (gpointer data);
+
+SourceHealth *
+source_health_new (guint num_sources, const SourceReconnectConfig * config)
+{
+  SourceHealth *health = g_new0 (SourceHealth, 1);
+  guint i;
+
+  health->config = *config;
+  health->num_sources = num_sources;
+  health->sources = g_new0 (SourceState, num_sources);
+  for (i = 0; i < num_sources; i++) {
+    health->sources[i].health = health;
+    health->sources[i].index = i;
+  }
+  g_mutex_init (&health->lock);
+  return health;
+}
+
+static GstPadProbeReturn
+source_buffer_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  SourceState *state = (SourceState *) u_data;
+  SourceHealth *health = state->health;
+  gint64 now = g_get_monotonic_time ();
+
+  g_mutex_lock (&health->lock);
+  state->last_buffer = now;
+  /* Buffers still in flight when the bin was stopped do not count. */
+  if (state->down && state->attempt_start) {
+    gint64 outage = now - state->down_since;
+
+    state->total_outage_usec += outage;
+    state->max_outage_usec = MAX (state->max_outage_usec, outage);
+    state->total_reconnect_usec += now - state->attempt_start;
+    state->down = FALSE;
+    state->attempt_start = 0;
+    state->failed_attempts = 0;
+    g_print ("Source %u: reconnected after %.1f s\n", state->index,
+        outage / 1e6);
+  }
+  g_mutex_unlock (&health->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Returns FALSE if the source has no attempts left. Called with the lock
+ * held. */
+static gboolean
+schedule_retry (SourceState * state)
+{
+  SourceHealth *health = state->health;
+  guint64 delay;
+
+  if (health->config.max_retries &&
+      state->failed_attempts >= health->config.max_retries)
+    return FALSE;
+
+  delay = (guint64) health->config.initial_delay_msec <<
+      MIN (state->failed_attempts, 16);
+  delay = MIN (delay, health->config.max_delay_msec);
+  state->retry_timer_id = g_timeout_add (delay, retry_source, state);
+  g_print ("Source %u: reconnecting in %" G_GUINT64_FORMAT " ms\n",
+      state->index, delay);
+  return TRUE;
+}
+
+/* Ends the stream of the source downstream so the pipeline can still reach
+ * end of stream; the bin itself stays in NULL. */
+static void
+give_up (SourceState * state)
+{
+  GstPad *src_pad = gst_element_get_static_pad (state->bin, "src");
+  GstPad *peer = gst_pad_get_peer (src_pad);
+
+  g_printerr ("Source %u: giving up after %u failed attempts\n", state->index,
+      state->failed_attempts);
+  if (peer) {
+    gst_pad_send_event (peer, gst_event_new_eos ());
+    gst_object_unref (peer);
+  }
+  gst_object_unref (src_pad);
+}
+
+/* Takes the bin of a failed source, or of a failed reconnect attempt, to
+ * NULL and schedules the next attempt. Runs in the main thread. */
+static void
+stop_source (SourceState * state, const gchar * reason)
+{
+  SourceHealth *health = state->health;
+  gboolean retry;
+
+  g_mutex_lock (&health->lock);
+  /* Stopped already and waiting for the next attempt. */
+  if (state->ended || state->given_up || state->retry_timer_id) {
+    g_mutex_unlock (&health->lock);
+    return;
+  }
+  if (!state->down) {
+    state->down = TRUE;
+    state->down_since = g_get_monotonic_time ();
+    state->num_outages++;
+    g_printerr ("Source %u: %s, disconnected\n", state->index, reason);
+  } else {
+    state->failed_attempts++;
+    g_printerr ("Source %u: reconnect attempt failed: %s\n", state->index,
+        reason);
+  }
+  state->attempt_start = 0;
+  g_mutex_unlock (&health->lock);
+
+  gst_element_set_state (state->bin, GST_STATE_NULL);
+
+  g_mutex_lock (&health->lock);
+  retry = schedule_retry (state);
+  state->given_up = !retry;
+  g_mutex_unlock (&health->lock);
+
+  if (!retry)
+    give_up (state);
+}
+
+static gboolean
+retry_source (gpointer data)
+{
+  SourceState *state = (SourceState *) data;
+  SourceHealth *health = state->health;
+
+  g_mutex_lock (&health->lock);
+  state->retry_timer_id = 0;
+  state->attempt_start = g_get_monotonic_time ();
+  state->num_attempts++;
+  g_mutex_unlock (&health->lock);
+
+  /* Errors of the attempt arrive on the bus, a silent failure is caught by
+   * the watchdog. */
+  if (gst_element_set_state (state->bin, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE)
+    stop_source (state, "state change failed");
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+source_eos_idle (gpointer data)
+{
+  stop_source ((SourceState *) data, "end of stream");
+  return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn
+source_event_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  SourceState *state = (SourceState *) u_data;
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_EOS)
+    return GST_PAD_PROBE_OK;
+
+  if (!state->live) {
+    g_mutex_lock (&state->health->lock);
+    state->ended = TRUE;
+    g_mutex_unlock (&state->health->lock);
+    return GST_PAD_PROBE_OK;
+  }
+
+  /* Streammux must not see the end of a stream that will come back. State
+   * changes are not allowed from the streaming thread. */
+  g_idle_add (source_eos_idle, state);
+  return GST_PAD_PROBE_DROP;
+}
+
+gboolean
+source_health_add_source (SourceHealth * health, guint index,
+    GstElement * source_bin, const gchar * uri)
+{
+  SourceState *state;
+  GstPad *src_pad;
+
+  if (index >= health->num_sources)
+    return FALSE;
+  src_pad = gst_element_get_static_pad (source_bin, "src");
+  if (!src_pad)
+    return FALSE;
+
+  state = &health->sources[index];
+  state->bin = source_bin;
+  state->live = !g_str_has_prefix (uri, "file://");
+  gst_pad_add_probe (src_pad, GST_PAD_PROBE_TYPE_BUFFER, source_buffer_probe,
+      state, NULL);
+  gst_pad_add_probe (src_pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      source_event_probe, state, NULL);
+  gst_object_unref (src_pad);
+  return TRUE;
+}
+
+static gboolean
+source_health_watchdog (gpointer data)
+{
+  SourceHealth *health = (SourceHealth *) data;
+  gint64 stall_usec = (gint64) health->config.stall_timeout_sec *
+      G_USEC_PER_SEC;
+  gint64 now = g_get_monotonic_time ();
+  guint i;
+
+  for (i = 0; i < health->num_sources; i++) {
+    SourceState *state = &health->sources[i];
+    gboolean stalled;
+
+    if (!state->bin)
+      continue;
+
+    g_mutex_lock (&health->lock);
+    if (state->ended || state->given_up)
+      stalled = FALSE;
+    else if (state->down)
+      stalled = state->attempt_start && now - state->attempt_start > stall_usec;
+    else
+      stalled = now - state->last_buffer > stall_usec;
+    g_mutex_unlock (&health->lock);
+
+    if (stalled)
+      stop_source (state, "no buffers within stall-timeout-sec");
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+void
+source_health_start (SourceHealth * health)
+{
+  gint64 now = g_get_monotonic_time ();
+  guint i;
+
+  /* A source that never delivers a buffer is caught as well. */
+  g_mutex_lock (&health->lock);
+  for (i = 0; i < health->num_sources; i++)
+    health->sources[i].last_buffer = now;
+  g_mutex_unlock (&health->lock);
+
+  if (health->config.stall_timeout_sec)
+    health->watchdog_timer_id = g_timeout_add (WATCHDOG_INTERVAL_MSEC,
+        source_health_watchdog, health);
+}
+
+gboolean
+source_health_handle_error (SourceHealth * health, GstMessage * msg)
+{
+  guint i;
+
+  for (i = 0; i < health->num_sources; i++) {
+    SourceState *state = &health->sources[i];
+
+    if (state->bin && gst_object_has_as_ancestor (GST_MESSAGE_SRC (msg),
+            GST_OBJECT (state->bin))) {
+      stop_source (state, "error");
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+void
+source_health_print_stats (SourceHealth * health)
+{
+  gint64 now = g_get_monotonic_time ();
+  guint i;
+
+  g_mutex_lock (&health->lock);
+  for (i = 0; i < health->num_sources; i++) {
+    SourceState *state = &health->sources[i];
+    gint64 total_outage = state->total_outage_usec;
+    guint64 num_reconnects = state->num_outages - (state->down ? 1 : 0);
+
+    if (!state->bin)
+      continue;
+    if (state->down)
+      total_outage += now - state->down_since;
+
+    g_print ("Source %u: %" G_GUINT64_FORMAT " outages, %.1f s down in total,"
+        " longest outage %.1f s, %" G_GUINT64_FORMAT " reconnect attempts, "
+        "%.2f s from successful attempt to first buffer on average%s\n",
+        state->index, state->num_outages, total_outage / 1e6,
+        state->max_outage_usec / 1e6, state->num_attempts,
+        num_reconnects ?
+        state->total_reconnect_usec / 1e6 / num_reconnects : 0.0,
+        state->given_up ? ", given up" : state->down ? ", down at exit" : "");
+  }
+  g_mutex_unlock (&health->lock);
+}
+
+void
+source_health_free (SourceHealth * health)
+{
+  guint i;
+
+  if (!health)
+    return;
+  if (health->watchdog_timer_id)
+    g_source_remove (health->watchdog_timer_id);
+  for (i = 0; i < health->num_sources; i++)
+    if (health->sources[i].retry_timer_id)
+      g_source_remove (health->sources[i].retry_timer_id);
+  g_mutex_clear (&health->lock);
+  g_free (health->sources);
+  g_free (health);
+}
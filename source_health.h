@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SOURCE_HEALTH_H__
+#define __SOURCE_HEALTH_H__
+
+#include <gst/gst.h>
+
+#include "app_config.h"
+
+/* Keeps one failing source from stopping the pipeline. An error posted by an
+ * element of a source bin, an end of stream from a live source or a source
+ * that stops delivering buffers for stall-timeout-sec takes only that source
+ * bin to NULL; streammux keeps forming batches from the other sources in the
+ * meantime, as its batched-push-timeout does not wait for a missing source.
+ * The bin is set back to PLAYING after a delay that doubles with every failed
+ * attempt. The outage ends with the first buffer the source delivers again.
+ * A source that runs out of attempts gets an end of stream, so the pipeline
+ * still ends once all other sources have ended. */
+
+typedef struct _SourceState
+{
+  struct _SourceHealth *health;
+  guint index;
+  GstElement *bin;
+  /* End of stream of a live source means it lost its connection. */
+  gboolean live;
+
+  /* Guarded by the lock of SourceHealth. */
+  gint64 last_buffer;
+  gboolean down;
+  gboolean ended;
+  gboolean given_up;
+  gint64 down_since;
+  /* Start of the current attempt, 0 while waiting for the next one. */
+  gint64 attempt_start;
+  guint failed_attempts;
+  guint retry_timer_id;
+
+  guint64 num_outages;
+  guint64 num_attempts;
+  gint64 total_outage_usec;
+  gint64 max_outage_usec;
+  /* Time from the successful attempt to the first buffer. */
+  gint64 total_reconnect_usec;
+} SourceState;
+
+typedef struct _SourceHealth
+{
+  SourceReconnectConfig config;
+  guint num_sources;
+  SourceState *sources;
+  GMutex lock;
+  guint watchdog_timer_id;
+} SourceHealth;
+
+SourceHealth *source_health_new (guint num_sources,
+    const SourceReconnectConfig * config);
+
+/* Watches source_bin, the bin created for uri at streammux pad index. */
+gboolean source_health_add_source (SourceHealth * health, guint index,
+    GstElement * source_bin, const gchar * uri);
+
+/* Starts the stall watchdog, call once the pipeline is playing. */
+void source_health_start (SourceHealth * health);
+
+/* Returns TRUE if msg is an error posted from within a watched source bin;
+ * the source is then reconnected and the error must not stop the
+ * pipeline. */
+gboolean source_health_handle_error (SourceHealth * health, GstMessage * msg);
+
+void source_health_print_stats (SourceHealth * health);
+
+void source_health_free (SourceHealth * health);
+
+#endif
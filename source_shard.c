@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "metadata_dump.h"
+#include "source_shard.h"
+
+/* Command line layout: <app> <sink> <tracking> followed by one
+ * <uri> <source id> <config> triple per source. */
+#define FIRST_SOURCE_ARG 3
+#define ARGS_PER_SOURCE 3
+
+#define SUPERVISOR_IDLE_USEC 1000
+#define MAX_RESTART_BACKOFF_SHIFT 10
+
+typedef struct _ShardState
+{
+  guint index;
+  pid_t pid;
+  ShmRing *ring;
+  guint num_sources;
+  guint *source_map;
+  guint restarts;
+  /* Monotonic time of the next restart attempt, 0 if none is pending. */
+  gint64 restart_at;
+  /* Hang detection: heartbeat of the ring when last looked at, monotonic
+   * time it last changed or the worker was started, whether it changed at
+   * all since the start, and whether the worker was killed for hanging. */
+  guint beats;
+  gint64 last_progress;
+  gboolean progressed;
+  gboolean killed;
+  gboolean done;
+  guint64 num_records;
+  /* Frames of the batch being assembled, pointing into ring slots. */
+  FrameRecordBatch *batch;
+} ShardState;
+
+typedef struct _ShardSupervisor
+{
+  const ShardingConfig *config;
+  ShardState *shards;
+  guint num_shards;
+  FrameRecordBatchFunc func;
+  gpointer user_data;
+  /* Monotonic time SIGINT was forwarded to the workers, 0 before. */
+  gint64 stop_at;
+  gboolean failed;
+} ShardSupervisor;
+
+static const gchar *synthetic_labels[METADATA_DUMP_NUM_CLASSES] = {
+  "Person", "Bag", "Face"
+};
+
+/* In the supervisor set on SIGINT and SIGTERM, in a synthetic worker on the
+ * SIGINT forwarded by the supervisor. */
+static volatile sig_atomic_t stop_requested = 0;
+
+static void
+supervisor_signal_handler (int signum)
+{
+  stop_requested = 1;
+}
+
+static gint
+shard_run_synthetic (ShardWorker * worker, const ShardingConfig * config)
+{
+  gint64 frame_usec = G_USEC_PER_SEC / config->synthetic_fps;
+  guint num_objects = MIN (config->synthetic_objects, FRAME_RECORD_MAX_OBJECTS);
+  gint64 next = g_get_monotonic_time ();
+  guint frame, s, k;
+
+  for (frame = 0; frame < config->synthetic_frames && !stop_requested;
+      frame++) {
+    gint64 now;
+
+    if (config->synthetic_crash_after && worker->shard_index == 0 &&
+        worker->generation == 0 && frame == config->synthetic_crash_after)
+      abort ();
+    /* Like a decoder that stopped delivering: alive, but silent and deaf
+     * to SIGINT. */
+    if (config->synthetic_hang_after && worker->shard_index == 0 &&
+        worker->generation == 0 && frame == config->synthetic_hang_after) {
+      while (TRUE)
+        pause ();
+    }
+
+    for (s = 0; s < worker->num_sources; s++) {
+      FrameRecord *record = shard_worker_reserve (worker);
+
+      if (!record)
+        continue;
+
+      record->batch_num = frame;
+      record->pts = frame * frame_usec * 1000;
+      record->source_id = worker->source_map[s];
+      record->surface_index = 0;
+      record->surface_type = 0;
+      record->frame_num = frame;
+      record->end_of_batch = (s == worker->num_sources - 1);
+      record->num_objects = num_objects;
+      record->num_truncated = 0;
+      for (k = 0; k < num_objects; k++) {
+        ObjectRecord *object = &record->objects[k];
+        object->object_id = record->source_id * 1000 + k;
+        object->left = (k * 37 + frame * (1 + k % 3)) % 900;
+        object->top = (k * 53) % 650;
+        object->width = 40;
+        object->height = 90;
+        object->confidence = 0.9;
+        object->class_id = k % METADATA_DUMP_NUM_CLASSES;
+        g_strlcpy (object->label, synthetic_labels[object->class_id],
+            OBJECT_RECORD_LABEL_LEN);
+      }
+      shard_worker_commit (worker);
+    }
+
+    next += frame_usec;
+    now = g_get_monotonic_time ();
+    if (next > now)
+      g_usleep (next - now);
+  }
+
+  return 0;
+}
+
+static void
+shard_become_worker (ShardState * shard, gint * argc, gchar *** argv,
+    ShardWorker ** worker)
+{
+  gchar **worker_argv = g_new0 (gchar *,
+      FIRST_SOURCE_ARG + shard->num_sources * ARGS_PER_SOURCE + 1);
+  ShardWorker *w = g_new0 (ShardWorker, 1);
+  guint i, j;
+
+  for (i = 0; i < FIRST_SOURCE_ARG; i++)
+    worker_argv[i] = (*argv)[i];
+  for (i = 0; i < shard->num_sources; i++) {
+    for (j = 0; j < ARGS_PER_SOURCE; j++)
+      worker_argv[FIRST_SOURCE_ARG + i * ARGS_PER_SOURCE + j] =
+          (*argv)[FIRST_SOURCE_ARG + shard->source_map[i] * ARGS_PER_SOURCE +
+          j];
+  }
+
+  w->shard_index = shard->index;
+  w->generation = shard->restarts;
+  w->ring = shard->ring;
+  w->num_sources = shard->num_sources;
+  w->source_map = shard->source_map;
+
+  *argc = FIRST_SOURCE_ARG + shard->num_sources * ARGS_PER_SOURCE;
+  *argv = worker_argv;
+  *worker = w;
+}
+
+/* Closes every descriptor but stdin, stdout and stderr. Files the supervisor
+ * opened for the metadata stages, before the first fork or before a restart,
+ * are then never held or written by a worker. */
+static void
+close_inherited_fds (void)
+{
+  DIR *dir = opendir ("/proc/self/fd");
+  struct dirent *entry;
+
+  if (!dir)
+    return;
+  while ((entry = readdir (dir))) {
+    gint fd = atoi (entry->d_name);
+
+    if (fd > STDERR_FILENO && fd != dirfd (dir))
+      close (fd);
+  }
+  closedir (dir);
+}
+
+/* Forks the worker process of shard. Returns TRUE in the worker. */
+static gboolean
+shard_start (ShardSupervisor * sup, ShardState * shard, gint * argc,
+    gchar *** argv, ShardWorker ** worker)
+{
+  pid_t pid;
+
+  /* Buffered output would otherwise be written by both processes. */
+  fflush (NULL);
+
+  pid = fork ();
+  if (pid < 0) {
+    g_printerr ("Failed to start worker %u: %s\n", shard->index,
+        g_strerror (errno));
+    shard->done = TRUE;
+    sup->failed = TRUE;
+    return FALSE;
+  }
+
+  if (pid > 0) {
+    shard->pid = pid;
+    shard->beats = shm_ring_beats (shard->ring);
+    shard->last_progress = g_get_monotonic_time ();
+    shard->progressed = FALSE;
+    shard->killed = FALSE;
+    g_print ("Started worker %u (pid %d) with %u sources\n", shard->index,
+        (gint) pid, shard->num_sources);
+    return FALSE;
+  }
+
+  /* SIGINT keeps the handler of the supervisor until the worker installs its
+   * own, a synthetic worker checks stop_requested. */
+  signal (SIGTERM, SIG_DFL);
+  /* Workers must not outlive the supervisor. */
+  prctl (PR_SET_PDEATHSIG, SIGTERM);
+  close_inherited_fds ();
+
+  shard_become_worker (shard, argc, argv, worker);
+  if (sup->config->synthetic)
+    exit (shard_run_synthetic (*worker, sup->config));
+
+  return TRUE;
+}
+
+/* Hands every complete batch in the ring of shard to the batch function.
+ * The records stay in their ring slots until the function returned. With
+ * flush set a trailing incomplete batch is delivered too, used once the
+ * worker is gone. */
+static guint
+shard_drain (ShardSupervisor * sup, ShardState * shard, gboolean flush)
+{
+  FrameRecordBatch *batch = shard->batch;
+  guint num_records = 0;
+
+  while (TRUE) {
+    const FrameRecord *record;
+    gboolean complete = FALSE;
+    guint pending = 0;
+
+    while ((record = (const FrameRecord *) shm_ring_peek_at (shard->ring,
+                pending))) {
+      if (pending && record->batch_num != batch->batch_num) {
+        complete = TRUE;
+        break;
+      }
+      batch->batch_num = record->batch_num;
+      batch->frames[pending++] = record;
+      if (record->end_of_batch || pending == batch->max_frames) {
+        complete = TRUE;
+        break;
+      }
+    }
+
+    if (!pending || (!complete && !flush))
+      break;
+
+    batch->num_frames = pending;
+    batch->timestamp = g_get_monotonic_time ();
+    sup->func (batch, sup->user_data);
+    shm_ring_release_n (shard->ring, pending);
+    num_records += pending;
+  }
+
+  shard->num_records += num_records;
+  return num_records;
+}
+
+/* Kills the worker of shard if it published no frame for hang-timeout-msec,
+ * no first frame for startup-timeout-msec, or did not exit hang-timeout-msec
+ * after it was asked to stop. shard_reap() then restarts it like a worker
+ * that crashed. */
+static void
+shard_watch (ShardSupervisor * sup, ShardState * shard, gint64 now)
+{
+  const ShardingConfig *config = sup->config;
+  const gchar *reason;
+  guint beats, timeout_msec;
+  gint64 since;
+
+  if (shard->pid <= 0 || shard->killed)
+    return;
+
+  beats = shm_ring_beats (shard->ring);
+  if (beats != shard->beats) {
+    shard->beats = beats;
+    shard->last_progress = now;
+    shard->progressed = TRUE;
+  }
+
+  if (sup->stop_at) {
+    since = sup->stop_at;
+    timeout_msec = config->hang_timeout_msec;
+    reason = "did not stop";
+  } else if (shard->progressed) {
+    since = shard->last_progress;
+    timeout_msec = config->hang_timeout_msec;
+    reason = "published no frame";
+  } else {
+    since = shard->last_progress;
+    timeout_msec = config->startup_timeout_msec;
+    reason = "published no first frame";
+  }
+  if (!timeout_msec || now - since < (gint64) timeout_msec * 1000)
+    return;
+
+  g_printerr ("Worker %u (pid %d) %s for %u ms, killing it\n", shard->index,
+      (gint) shard->pid, reason, timeout_msec);
+  kill (shard->pid, SIGKILL);
+  shard->killed = TRUE;
+}
+
+static void
+shard_reap (ShardSupervisor * sup)
+{
+  pid_t pid;
+  gint status;
+  guint i;
+
+  while ((pid = waitpid (-1, &status, WNOHANG)) > 0) {
+    ShardState *shard = NULL;
+    guint shift;
+    guint delay_msec;
+
+    for (i = 0; i < sup->num_shards; i++) {
+      if (sup->shards[i].pid == pid)
+        shard = &sup->shards[i];
+    }
+    if (!shard)
+      continue;
+
+    shard->pid = 0;
+    shard_drain (sup, shard, TRUE);
+
+    if (WIFEXITED (status) && WEXITSTATUS (status) == 0) {
+      g_print ("Worker %u finished\n", shard->index);
+      shard->done = TRUE;
+      continue;
+    }
+
+    if (WIFSIGNALED (status))
+      g_printerr ("Worker %u (pid %d) killed by signal %d\n", shard->index,
+          (gint) pid, WTERMSIG (status));
+    else
+      g_printerr ("Worker %u (pid %d) exited with status %d\n", shard->index,
+          (gint) pid, WEXITSTATUS (status));
+
+    /* Asked to stop, however it went: not a failure of the run. */
+    if (stop_requested) {
+      shard->done = TRUE;
+      continue;
+    }
+    if (shard->restarts >= sup->config->max_restarts) {
+      g_printerr ("Worker %u is not restarted\n", shard->index);
+      shard->done = TRUE;
+      sup->failed = TRUE;
+      continue;
+    }
+
+    shift = MIN (shard->restarts, MAX_RESTART_BACKOFF_SHIFT);
+    delay_msec = sup->config->restart_delay_msec << shift;
+    shard->restart_at = g_get_monotonic_time () + (gint64) delay_msec * 1000;
+    g_printerr ("Restarting worker %u in %u ms\n", shard->index, delay_msec);
+  }
+}
+
+gint
+shard_supervisor_run (const ShardingConfig * config, gint * argc,
+    gchar *** argv, FrameRecordBatchFunc func, gpointer user_data,
+    ShardWorker ** worker)
+{
+  ShardSupervisor sup;
+  struct sigaction action;
+  guint num_sources = (*argc - FIRST_SOURCE_ARG) / ARGS_PER_SOURCE;
+  guint i, s;
+
+  *worker = NULL;
+  memset (&sup, 0, sizeof (sup));
+  sup.config = config;
+  sup.func = func;
+  sup.user_data = user_data;
+  sup.num_shards = MIN (config->num_workers, num_sources);
+  if (sup.num_shards == 0) {
+    g_printerr ("No sources to distribute over workers\n");
+    return -1;
+  }
+
+  sup.shards = g_new0 (ShardState, sup.num_shards);
+  for (i = 0; i < sup.num_shards; i++) {
+    ShardState *shard = &sup.shards[i];
+
+    shard->index = i;
+    shard->source_map = g_new0 (guint, num_sources);
+    for (s = i; s < num_sources; s += sup.num_shards)
+      shard->source_map[shard->num_sources++] = s;
+    shard->ring = shm_ring_new (config->ring_slots, sizeof (FrameRecord));
+    if (!shard->ring)
+      return -1;
+    shard->batch = frame_record_batch_new (shm_ring_capacity (shard->ring),
+        FALSE);
+  }
+
+  memset (&action, 0, sizeof (action));
+  action.sa_handler = supervisor_signal_handler;
+  sigaction (SIGINT, &action, NULL);
+  sigaction (SIGTERM, &action, NULL);
+
+  for (i = 0; i < sup.num_shards; i++) {
+    if (shard_start (&sup, &sup.shards[i], argc, argv, worker))
+      return 0;
+  }
+
+  while (TRUE) {
+    guint num_records = 0;
+    guint active = 0;
+    gint64 now;
+
+    if (stop_requested && !sup.stop_at) {
+      for (i = 0; i < sup.num_shards; i++) {
+        if (sup.shards[i].pid > 0)
+          kill (sup.shards[i].pid, SIGINT);
+      }
+      sup.stop_at = g_get_monotonic_time ();
+    }
+
+    for (i = 0; i < sup.num_shards; i++)
+      num_records += shard_drain (&sup, &sup.shards[i], FALSE);
+
+    now = g_get_monotonic_time ();
+    for (i = 0; i < sup.num_shards; i++)
+      shard_watch (&sup, &sup.shards[i], now);
+
+    shard_reap (&sup);
+
+    now = g_get_monotonic_time ();
+    for (i = 0; i < sup.num_shards; i++) {
+      ShardState *shard = &sup.shards[i];
+
+      if (!shard->done && shard->pid == 0 && stop_requested)
+        shard->done = TRUE;
+      if (!shard->done && shard->pid == 0 && now >= shard->restart_at) {
+        shard->restarts++;
+        shard->restart_at = 0;
+        if (shard_start (&sup, shard, argc, argv, worker))
+          return 0;
+      }
+      if (!shard->done)
+        active++;
+    }
+
+    if (!active)
+      break;
+    if (!num_records)
+      g_usleep (SUPERVISOR_IDLE_USEC);
+  }
+
+  for (i = 0; i < sup.num_shards; i++) {
+    ShardState *shard = &sup.shards[i];
+
+    g_print ("Worker %u: records %" G_GUINT64_FORMAT ", dropped %u, "
+        "restarts %u\n", shard->index, shard->num_records,
+        shm_ring_dropped (shard->ring), shard->restarts);
+    frame_record_batch_free (shard->batch);
+    shm_ring_free (shard->ring);
+    g_free (shard->source_map);
+  }
+  g_free (sup.shards);
+
+  return sup.failed ? -1 : 0;
+}
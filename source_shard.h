@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __SOURCE_SHARD_H__
+#define __SOURCE_SHARD_H__
+
+#include <glib.h>
+
+#include "app_config.h"
+#include "frame_record.h"
+#include "shm_ring.h"
+
+/* Splits the <uri> <source id> <config> triples of the command line over
+ * several worker processes. Each worker builds the usual pipeline for its
+ * subset of sources and publishes a FrameRecord per frame into its own shared
+ * memory ring. The supervising process reassembles the batches of every ring
+ * for the metadata stages and restarts workers that exit, or that publish no
+ * frame for hang-timeout-msec and are killed, so a decoder hang or crash only
+ * affects the sources of one worker.
+ *
+ * SIGINT or SIGTERM to the supervisor is forwarded to the workers as SIGINT,
+ * on which a worker ends its streams and exits; a worker that has not exited
+ * hang-timeout-msec later is killed. */
+
+typedef struct _ShardWorker
+{
+  guint shard_index;
+  /* Number of times this worker has been restarted. */
+  guint generation;
+  ShmRing *ring;
+  guint num_sources;
+  /* Maps the streammux pad index in the worker to the stream index on the
+   * original command line. */
+  guint *source_map;
+} ShardWorker;
+
+/* Must be called before gst_init(). The worker process must handle SIGINT
+ * by ending its pipeline. In the supervisor func is called for
+ * every batch a worker produced; the call returns once all workers are done,
+ * with *worker set to NULL and the process exit code as return value. Returns
+ * in every worker process with *worker set and argc and argv reduced to the
+ * sources of that worker; the caller then builds its pipeline as usual.
+ * Workers start with only stdin, stdout and stderr open, whatever the
+ * supervisor had open when it forked them. */
+gint shard_supervisor_run (const ShardingConfig * config, gint * argc,
+    gchar *** argv, FrameRecordBatchFunc func, gpointer user_data,
+    ShardWorker ** worker);
+
+/* Returns the record to fill for the next frame, or NULL if the ring is
+ * full and the frame has to be dropped. Either way the frame counts as
+ * progress for the hang detection of the supervisor. */
+static inline FrameRecord *
+shard_worker_reserve (ShardWorker * worker)
+{
+  shm_ring_beat (worker->ring);
+  return (FrameRecord *) shm_ring_reserve (worker->ring);
+}
+
+static inline void
+shard_worker_commit (ShardWorker * worker)
+{
+  shm_ring_commit (worker->ring);
+}
+
+static inline guint
+shard_worker_source_id (ShardWorker * worker, guint pad_index)
+{
+  return pad_index < worker->num_sources ?
+      worker->source_map[pad_index] : pad_index;
+}
+
+#endif
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+
+#include "startup_profile.h"
+
+typedef struct _StartupSpan
+{
+  /* 0 until the span began or ended. */
+  gint64 begin;
+  gint64 end;
+} StartupSpan;
+
+typedef struct _StartupSource
+{
+  StartupSpan created;
+  gint64 first_decoded;
+  gint64 first_dewarped;
+} StartupSource;
+
+struct _StartupProfile
+{
+  /* Guards everything below; probes run on streaming threads. */
+  GMutex lock;
+  gint64 start_time;
+  StartupSpan phases[STARTUP_NUM_PHASES];
+  guint num_sources;
+  StartupSource *sources;
+  gint64 first_muxed;
+  gint64 first_inferred;
+  gboolean printed;
+};
+
+/* Probe data, owned by the probe. */
+typedef struct _StartupProbe
+{
+  StartupProfile *profile;
+  gint64 *time;
+  /* Print the profile after recording the buffer. */
+  gboolean print;
+} StartupProbe;
+
+static const gchar *phase_names[STARTUP_NUM_PHASES] = {
+  "app config",
+  "metadata stages",
+  "gst_init",
+  "source chains",
+  "pipeline elements",
+  "tracker config",
+  "inference engine load",
+  "tracker load",
+  "pipeline assembly",
+  "set to playing",
+};
+
+StartupProfile *
+startup_profile_new (guint num_sources, gint64 start_time)
+{
+  StartupProfile *profile = g_new0 (StartupProfile, 1);
+
+  g_mutex_init (&profile->lock);
+  profile->start_time = start_time;
+  profile->num_sources = num_sources;
+  profile->sources = g_new0 (StartupSource, MAX (num_sources, 1));
+  return profile;
+}
+
+void
+startup_profile_begin (StartupProfile * profile, StartupPhase phase)
+{
+  if (!profile)
+    return;
+  g_mutex_lock (&profile->lock);
+  profile->phases[phase].begin = g_get_monotonic_time ();
+  g_mutex_unlock (&profile->lock);
+}
+
+void
+startup_profile_end (StartupProfile * profile, StartupPhase phase)
+{
+  if (!profile)
+    return;
+  g_mutex_lock (&profile->lock);
+  profile->phases[phase].end = g_get_monotonic_time ();
+  g_mutex_unlock (&profile->lock);
+}
+
+void
+startup_profile_add_phase (StartupProfile * profile, StartupPhase phase,
+    gint64 begin, gint64 end)
+{
+  if (!profile)
+    return;
+  g_mutex_lock (&profile->lock);
+  profile->phases[phase].begin = begin;
+  profile->phases[phase].end = end;
+  g_mutex_unlock (&profile->lock);
+}
+
+void
+startup_profile_begin_source (StartupProfile * profile, guint index)
+{
+  if (!profile || index >= profile->num_sources)
+    return;
+  g_mutex_lock (&profile->lock);
+  profile->sources[index].created.begin = g_get_monotonic_time ();
+  g_mutex_unlock (&profile->lock);
+}
+
+void
+startup_profile_end_source (StartupProfile * profile, guint index)
+{
+  if (!profile || index >= profile->num_sources)
+    return;
+  g_mutex_lock (&profile->lock);
+  profile->sources[index].created.end = g_get_monotonic_time ();
+  g_mutex_unlock (&profile->lock);
+}
+
+static gint
+compare_time (const void *a, const void *b)
+{
+  gint64 x = *(const gint64 *) a, y = *(const gint64 *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Milliseconds since start, or "-" for what did not happen. */
+static const gchar *
+format_time (StartupProfile * profile, gint64 time, gchar * buf, gsize size)
+{
+  if (!time)
+    return "-";
+  g_snprintf (buf, size, "%.1f", (time - profile->start_time) / 1000.0);
+  return buf;
+}
+
+/* Milliseconds from begin to end, or "-" for spans that did not end. */
+static const gchar *
+format_duration (const StartupSpan * span, gchar * buf, gsize size)
+{
+  if (!span->end)
+    return "-";
+  g_snprintf (buf, size, "%.1f", (span->end - span->begin) / 1000.0);
+  return buf;
+}
+
+/* Called with the lock held. */
+static void
+print_profile (StartupProfile * profile)
+{
+  gint64 set_playing = profile->phases[STARTUP_PHASE_SET_PLAYING].begin;
+  gint64 *preroll = g_new (gint64, MAX (profile->num_sources, 1));
+  guint num_prerolled = 0, slowest = 0;
+  gchar begin[32], end[32], first[32], second[32];
+  guint i;
+
+  g_print ("Startup profile, ms since start:\n");
+  g_print ("  %-22s %10s %10s %10s\n", "phase", "begin", "end", "duration");
+  for (i = 0; i < STARTUP_NUM_PHASES; i++) {
+    StartupSpan *span = &profile->phases[i];
+
+    if (!span->begin)
+      continue;
+    g_print ("  %-22s %10s %10s %10s\n", phase_names[i],
+        format_time (profile, span->begin, begin, sizeof (begin)),
+        format_time (profile, span->end, end, sizeof (end)),
+        format_duration (span, first, sizeof (first)));
+  }
+
+  g_print ("  %-8s %10s %10s %10s\n", "source", "created", "decoded",
+      "dewarped");
+  for (i = 0; i < profile->num_sources; i++) {
+    StartupSource *source = &profile->sources[i];
+
+    g_print ("  %-8u %10s %10s %10s\n", i,
+        format_duration (&source->created, begin, sizeof (begin)),
+        format_time (profile, source->first_decoded, first, sizeof (first)),
+        format_time (profile, source->first_dewarped, second,
+            sizeof (second)));
+
+    if (source->first_dewarped && set_playing) {
+      if (!num_prerolled ||
+          source->first_dewarped > profile->sources[slowest].first_dewarped)
+        slowest = i;
+      preroll[num_prerolled++] = source->first_dewarped - set_playing;
+    }
+  }
+
+  if (num_prerolled) {
+    qsort (preroll, num_prerolled, sizeof (gint64), compare_time);
+    g_print ("Sources prerolled %u/%u, first dewarped frame after set to "
+        "playing: min %.1f ms, median %.1f ms, max %.1f ms (source %u)\n",
+        num_prerolled, profile->num_sources, preroll[0] / 1000.0,
+        preroll[num_prerolled / 2] / 1000.0,
+        preroll[num_prerolled - 1] / 1000.0, slowest);
+  } else {
+    g_print ("Sources prerolled 0/%u\n", profile->num_sources);
+  }
+  g_print ("First batch muxed at %s ms, inferred at %s ms\n",
+      format_time (profile, profile->first_muxed, first, sizeof (first)),
+      format_time (profile, profile->first_inferred, second,
+          sizeof (second)));
+
+  profile->printed = TRUE;
+  g_free (preroll);
+}
+
+static GstPadProbeReturn
+first_buffer_probe (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  StartupProbe *probe = (StartupProbe *) u_data;
+  StartupProfile *profile = probe->profile;
+
+  g_mutex_lock (&profile->lock);
+  if (!*probe->time)
+    *probe->time = g_get_monotonic_time ();
+  if (probe->print && !profile->printed)
+    print_profile (profile);
+  g_mutex_unlock (&profile->lock);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+static void
+watch_pad (StartupProfile * profile, GstPad * pad, gint64 * time,
+    gboolean print)
+{
+  StartupProbe *probe;
+
+  if (!pad)
+    return;
+  probe = g_new0 (StartupProbe, 1);
+  probe->profile = profile;
+  probe->time = time;
+  probe->print = print;
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, first_buffer_probe,
+      probe, g_free);
+}
+
+void
+startup_profile_watch_source (StartupProfile * profile, guint index,
+    GstPad * decoded_pad, GstPad * dewarped_pad)
+{
+  if (!profile || index >= profile->num_sources)
+    return;
+  watch_pad (profile, decoded_pad, &profile->sources[index].first_decoded,
+      FALSE);
+  watch_pad (profile, dewarped_pad, &profile->sources[index].first_dewarped,
+      FALSE);
+}
+
+void
+startup_profile_watch_batches (StartupProfile * profile, GstPad * muxed_pad,
+    GstPad * inferred_pad)
+{
+  if (!profile)
+    return;
+  watch_pad (profile, muxed_pad, &profile->first_muxed, FALSE);
+  watch_pad (profile, inferred_pad, &profile->first_inferred, TRUE);
+}
+
+void
+startup_profile_print (StartupProfile * profile)
+{
+  if (!profile)
+    return;
+  g_mutex_lock (&profile->lock);
+  if (!profile->printed)
+    print_profile (profile);
+  g_mutex_unlock (&profile->lock);
+}
+
+void
+startup_profile_free (StartupProfile * profile)
+{
+  if (!profile)
+    return;
+  g_mutex_clear (&profile->lock);
+  g_free (profile->sources);
+  g_free (profile);
+}
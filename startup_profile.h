@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __STARTUP_PROFILE_H__
+#define __STARTUP_PROFILE_H__
+
+#include <gst/gst.h>
+
+/* Where the time to the first batch goes. Phases of main are timed by the
+ * thread running them, possibly overlapping with parallel-init, the first
+ * buffer of every source chain and of the pipeline by probes that remove
+ * themselves, so nothing is left on the pads once the pipeline runs. The
+ * profile is printed when the first batch leaves inference, or at exit if
+ * that never happened. Every function accepts a NULL profile, so call
+ * sites need no checks when profiling is disabled. */
+
+typedef enum
+{
+  STARTUP_PHASE_APP_CONFIG,
+  STARTUP_PHASE_METADATA_SINK,
+  STARTUP_PHASE_GST_INIT,
+  STARTUP_PHASE_SOURCE_CHAINS,
+  STARTUP_PHASE_ELEMENTS,
+  STARTUP_PHASE_TRACKER_CONFIG,
+  STARTUP_PHASE_ENGINE_LOAD,
+  STARTUP_PHASE_TRACKER_LOAD,
+  STARTUP_PHASE_ASSEMBLY,
+  STARTUP_PHASE_SET_PLAYING,
+  STARTUP_NUM_PHASES
+} StartupPhase;
+
+typedef struct _StartupProfile StartupProfile;
+
+/* start_time is the g_get_monotonic_time() all times are relative to,
+ * normally taken first thing in main. */
+StartupProfile *startup_profile_new (guint num_sources, gint64 start_time);
+
+/* A phase may be begun and ended once, from any thread. */
+void startup_profile_begin (StartupProfile * profile, StartupPhase phase);
+
+void startup_profile_end (StartupProfile * profile, StartupPhase phase);
+
+/* Records a phase timed before the profile existed, e.g. parsing the app
+ * config that enables it. */
+void startup_profile_add_phase (StartupProfile * profile, StartupPhase phase,
+    gint64 begin, gint64 end);
+
+/* Times the creation of the chain of source index, from the thread
+ * creating it. */
+void startup_profile_begin_source (StartupProfile * profile, guint index);
+
+void startup_profile_end_source (StartupProfile * profile, guint index);
+
+/* Records the first buffer of source index on decoded_pad, the output of
+ * its source bin, and on dewarped_pad, the output of its dewarper. */
+void startup_profile_watch_source (StartupProfile * profile, guint index,
+    GstPad * decoded_pad, GstPad * dewarped_pad);
+
+/* Records the first batch on muxed_pad, the streammux output, and on
+ * inferred_pad, the nvinfer output, where the profile is printed. */
+void startup_profile_watch_batches (StartupProfile * profile,
+    GstPad * muxed_pad, GstPad * inferred_pad);
+
+/* Prints the profile unless it was printed at the first batch. */
+void startup_profile_print (StartupProfile * profile);
+
+/* Pads may outlive the profile. */
+void startup_profile_free (StartupProfile * profile);
+
+#endif
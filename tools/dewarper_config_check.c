@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Checks nvdewarper config files before they are deployed and estimates
+ * what the dewarping of each camera costs. With --cache-dir it also computes
+ * the panorama remap tables of the [panorama] group of the app config, so
+ * the app loads them at startup instead of computing them on the first
+ * frame.
+ *
+ * Every config file given stands for one camera, as on the command line of
+ * the app. The exit status is 1 if a config has errors, or warnings with
+ * --strict. */
+
+#include <glib.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "app_config.h"
+#include "dewarper_config.h"
+#include "nvds_dewarper_meta.h"
+#include "panorama.h"
+#include "projection.h"
+
+/* Same as MUXER_OUTPUT_WIDTH and MUXER_OUTPUT_HEIGHT of the app. */
+#define DEFAULT_MUXER_SIZE "960x752"
+#define DEFAULT_FPS 30.0
+#define BYTES_PER_PIXEL 4
+#define MB (1024.0 * 1024.0)
+
+typedef struct _CheckOptions
+{
+  guint muxer_width;
+  guint muxer_height;
+  guint source_width;
+  guint source_height;
+  gdouble fps;
+  gboolean strict;
+  const gchar *cache_dir;
+  AppConfig app_config;
+} CheckOptions;
+
+typedef struct _CheckResult
+{
+  guint num_errors;
+  guint num_warnings;
+  /* Sums over all cameras. */
+  gdouble dewarped_pixels;
+  gdouble muxer_pixels;
+  gdouble bytes;
+} CheckResult;
+
+static void
+report (CheckResult * result, gboolean error, const gchar * format, ...)
+{
+  va_list args;
+  gchar *message;
+
+  va_start (args, format);
+  message = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  g_print ("  %s: %s\n", error ? "error" : "warning", message);
+  if (error)
+    result->num_errors++;
+  else
+    result->num_warnings++;
+  g_free (message);
+}
+
+static gboolean
+parse_size (const gchar * text, guint * width, guint * height)
+{
+  gchar tail;
+
+  return sscanf (text, "%ux%u%c", width, height, &tail) == 2 &&
+      *width > 0 && *height > 0;
+}
+
+static void
+check_surface (const DewarperConfig * config, guint n,
+    const CheckOptions * options, CheckResult * result)
+{
+  const DewarperSurfaceConfig *surface = &config->surfaces[n];
+  SurfaceProjection projection;
+  guint i;
+
+  if (surface->group_number != n)
+    report (result, FALSE, "[surface%u] is surface %u of the batch, number "
+        "the groups from 0 without gaps", surface->group_number, n);
+
+  if (surface->projection_type < NVDS_META_SURFACE_FISH_PUSHBROOM ||
+      surface->projection_type > NVDS_META_SURFACE_EQUIRECT_VERTCYLINDER) {
+    report (result, TRUE, "[surface%u] projection-type=%u is not a "
+        "NvDsSurfaceType (%d..%d)", surface->group_number,
+        surface->projection_type, NVDS_META_SURFACE_FISH_PUSHBROOM,
+        NVDS_META_SURFACE_EQUIRECT_VERTCYLINDER);
+    return;
+  }
+  if (surface->width == 0 || surface->height == 0) {
+    report (result, TRUE, "[surface%u] needs width and height",
+        surface->group_number);
+    return;
+  }
+
+  /* The app keys surfaces by their surface-index and refuses to start when
+   * the indices of a camera are not distinct. */
+  if (surface->surface_index >= DEWARPER_CONFIG_MAX_SURFACES)
+    report (result, TRUE, "[surface%u] surface-index=%u is out of range, "
+        "the app handles 0..%d", surface->group_number,
+        surface->surface_index, DEWARPER_CONFIG_MAX_SURFACES - 1);
+  for (i = 0; i < n; i++) {
+    if (config->surfaces[i].surface_index == surface->surface_index) {
+      report (result, TRUE, "[surface%u] surface-index=%u is also used by "
+          "[surface%u], the surface metadata cannot tell them apart",
+          surface->group_number, surface->surface_index,
+          config->surfaces[i].group_number);
+      break;
+    }
+  }
+
+  if (!surface_has_fisheye_source (surface->projection_type)) {
+    report (result, FALSE, "[surface%u] projection-type=%u does not dewarp a "
+        "fisheye; heatmap, global tracking and panorama outlines skip its "
+        "objects", surface->group_number, surface->projection_type);
+  } else {
+    gdouble src_fov = surface->src_fov;
+
+    if (src_fov <= 0 || src_fov > 360) {
+      report (result, FALSE, "[surface%u] src-fov=%g, the app assumes %g",
+          surface->group_number, src_fov, SURFACE_DEFAULT_SRC_FOV);
+      src_fov = SURFACE_DEFAULT_SRC_FOV;
+    }
+    if (surface->focal_length <= 0)
+      report (result, FALSE, "[surface%u] focal-length=%g must be > 0",
+          surface->group_number, surface->focal_length);
+
+    if (!surface_projection_init (&projection, surface)) {
+      report (result, FALSE, "[surface%u] has no usable geometry, check "
+          "top-angle=%g and bottom-angle=%g; heatmap, global tracking and "
+          "panorama outlines skip its objects", surface->group_number,
+          surface->top_angle, surface->bottom_angle);
+    } else {
+      gdouble coverage = surface_projection_coverage (&projection, src_fov);
+
+      if (coverage < SURFACE_MIN_COVERAGE)
+        report (result, FALSE, "[surface%u] looks outside src-fov=%g at "
+            "%.0f%% of its pixels, check the angles and rot-axes; heatmap, "
+            "global tracking and panorama outlines skip its objects",
+            surface->group_number, src_fov, 100 * (1 - coverage));
+      else
+        g_print ("  note: [surface%u] looks into the fisheye at %.0f%% of "
+            "its pixels\n", surface->group_number, 100 * coverage);
+    }
+  }
+
+  if ((config->output_width && surface->width > config->output_width) ||
+      (config->output_height && surface->height > config->output_height))
+    report (result, FALSE, "[surface%u] is %ux%u, larger than the %ux%u "
+        "output-width and output-height of [property]",
+        surface->group_number, surface->width, surface->height,
+        config->output_width, config->output_height);
+  if (surface->width > options->muxer_width ||
+      surface->height > options->muxer_height)
+    report (result, FALSE, "[surface%u] is %ux%u, streammux scales it down "
+        "to %ux%u; dewarping at that size does %.1fx less work",
+        surface->group_number, surface->width, surface->height,
+        options->muxer_width, options->muxer_height,
+        (gdouble) surface->width * surface->height /
+        ((gdouble) MIN (surface->width, options->muxer_width) *
+            MIN (surface->height, options->muxer_height)));
+  if (surface->num_unknown_keys)
+    g_print ("  note: [surface%u] has %u keys this tool does not know\n",
+        surface->group_number, surface->num_unknown_keys);
+}
+
+static void
+write_map_cache (const gchar * config_file, const CheckOptions * options,
+    GHashTable * written)
+{
+  const PanoramaConfig *panorama = &options->app_config.panorama;
+  SurfaceSet surfaces;
+  PanoramaView view;
+  PanoramaMap map = { 0 };
+  gchar *name, *file;
+  gint64 start, elapsed;
+
+  /* The app samples the fisheye with the lens of the surface set. */
+  if (!surface_set_load (&surfaces, config_file, options->muxer_width,
+          options->muxer_height))
+    return;
+
+  panorama_view_init (&view, panorama->width, panorama->height,
+      panorama->ceiling, surfaces.src_fov);
+  name = panorama_map_cache_name (&view, options->source_width,
+      options->source_height, surfaces.focal_length, surfaces.src_fov);
+  if (g_hash_table_contains (written, name)) {
+    g_free (name);
+    return;
+  }
+  file = g_build_filename (options->cache_dir, name, NULL);
+
+  start = g_get_monotonic_time ();
+  panorama_map_init (&map, &view, options->source_width,
+      options->source_height, options->source_width * BYTES_PER_PIXEL,
+      surfaces.focal_length, surfaces.src_fov);
+  elapsed = g_get_monotonic_time () - start;
+  if (panorama_map_save (&map, file))
+    g_print ("  wrote %s, saves %.0f ms on the first frame\n", file,
+        elapsed / 1000.0);
+  panorama_map_clear (&map);
+
+  g_hash_table_add (written, name);
+  g_free (file);
+}
+
+static void
+check_config (const gchar * file, const CheckOptions * options,
+    CheckResult * result, GHashTable * written)
+{
+  DewarperConfig config;
+  gdouble dewarped_pixels = 0, muxer_pixels, bytes;
+  guint i;
+
+  g_print ("%s:\n", file);
+  if (!parse_dewarper_config (&config, file)) {
+    report (result, TRUE, "cannot be parsed");
+    return;
+  }
+
+  if (config.num_ignored_surfaces)
+    report (result, TRUE, "%u [surfaceN] groups beyond the first %u were not "
+        "checked", config.num_ignored_surfaces, DEWARPER_CONFIG_MAX_SURFACES);
+  if (config.num_surfaces == 0) {
+    report (result, TRUE, "no [surfaceN] group");
+    return;
+  }
+  if (config.num_batch_buffers != config.num_surfaces)
+    report (result, TRUE, "num-batch-buffers=%u does not match the %u "
+        "[surfaceN] groups", config.num_batch_buffers, config.num_surfaces);
+  if (config.num_batch_buffers > MAX_DEWARPED_VIEWS ||
+      config.num_surfaces > MAX_DEWARPED_VIEWS)
+    report (result, TRUE, "more than %d surfaces, the surface metadata "
+        "holds only %d", MAX_DEWARPED_VIEWS, MAX_DEWARPED_VIEWS);
+
+  for (i = 0; i < config.num_surfaces; i++) {
+    check_surface (&config, i, options, result);
+    dewarped_pixels +=
+        (gdouble) config.surfaces[i].width * config.surfaces[i].height;
+  }
+
+  /* One streammux frame per surface. */
+  muxer_pixels = (gdouble) config.num_surfaces * options->muxer_width *
+      options->muxer_height;
+  bytes = (dewarped_pixels + muxer_pixels) * BYTES_PER_PIXEL;
+  g_print ("  %u surfaces: %.1f Mpixel dewarped and %.1f Mpixel batched per "
+      "frame, %.0f and %.0f Mpixel/s at %g fps\n", config.num_surfaces,
+      dewarped_pixels / 1e6, muxer_pixels / 1e6,
+      dewarped_pixels * options->fps / 1e6,
+      muxer_pixels * options->fps / 1e6, options->fps);
+  g_print ("  memory per frame (RGBA): %.1f MB dewarped, %.1f MB batched",
+      dewarped_pixels * BYTES_PER_PIXEL / MB,
+      muxer_pixels * BYTES_PER_PIXEL / MB);
+  if (options->source_width) {
+    gdouble source_bytes = (gdouble) options->source_width *
+        options->source_height * BYTES_PER_PIXEL;
+
+    g_print (", %.1f MB source", source_bytes / MB);
+    bytes += source_bytes;
+  }
+  if (options->app_config.panorama.enable) {
+    gdouble panorama_pixels = (gdouble) options->app_config.panorama.width *
+        options->app_config.panorama.height;
+    gdouble panorama_bytes = panorama_pixels * sizeof (PanoramaMapEntry);
+
+    g_print (", %.1f MB panorama map", panorama_bytes / MB);
+    bytes += panorama_bytes;
+  }
+  g_print ("\n");
+
+  result->dewarped_pixels += dewarped_pixels;
+  result->muxer_pixels += muxer_pixels;
+  result->bytes += bytes;
+
+  if (options->cache_dir)
+    write_map_cache (file, options, written);
+}
+
+int
+main (int argc, char *argv[])
+{
+  CheckOptions options = { 0 };
+  CheckResult result = { 0 };
+  gchar *app_config_file = NULL;
+  gchar *muxer_size = NULL;
+  gchar *source_size = NULL;
+  gchar *cache_dir = NULL;
+  gdouble fps = DEFAULT_FPS;
+  gboolean strict = FALSE;
+  GOptionEntry entries[] = {
+    {"app-config", 'a', 0, G_OPTION_ARG_FILENAME, &app_config_file,
+        "App config for the [panorama] group (default " APP_CONFIG_FILE
+          " if present)", "FILE"},
+    {"muxer-size", 'm', 0, G_OPTION_ARG_STRING, &muxer_size,
+        "Streammux output resolution (default " DEFAULT_MUXER_SIZE ")",
+        "WxH"},
+    {"source-size", 's', 0, G_OPTION_ARG_STRING, &source_size,
+        "Resolution of the fisheye sources", "WxH"},
+    {"fps", 'r', 0, G_OPTION_ARG_DOUBLE, &fps, "Frame rate per camera",
+        "FPS"},
+    {"cache-dir", 'c', 0, G_OPTION_ARG_FILENAME, &cache_dir,
+        "Write the panorama remap tables to DIR, needs --source-size", "DIR"},
+    {"strict", 'W', 0, G_OPTION_ARG_NONE, &strict,
+        "Fail on warnings too", NULL},
+    {NULL}
+  };
+  GOptionContext *context;
+  GHashTable *written;
+  GError *error = NULL;
+  int ret = 2;
+  gint i;
+
+  context = g_option_context_new ("CONFIG_FILE... - check nvdewarper "
+      "config files");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_error_free (error);
+    goto done;
+  }
+  if (argc < 2) {
+    g_printerr ("No config file given, see --help\n");
+    goto done;
+  }
+
+  if (!parse_size (muxer_size ? muxer_size : DEFAULT_MUXER_SIZE,
+          &options.muxer_width, &options.muxer_height) ||
+      (source_size && !parse_size (source_size, &options.source_width,
+              &options.source_height)) || fps <= 0) {
+    g_printerr ("Sizes must be given as WxH and fps must be > 0\n");
+    goto done;
+  }
+  if (cache_dir && (!source_size || options.source_width < 2 ||
+          options.source_height < 2)) {
+    g_printerr ("--cache-dir needs --source-size\n");
+    goto done;
+  }
+  if (cache_dir && g_mkdir_with_parents (cache_dir, 0755) != 0) {
+    g_printerr ("Failed to create %s\n", cache_dir);
+    goto done;
+  }
+  options.fps = fps;
+  options.strict = strict;
+  options.cache_dir = cache_dir;
+
+  app_config_set_defaults (&options.app_config);
+  if (!app_config_file && g_file_test (APP_CONFIG_FILE, G_FILE_TEST_EXISTS))
+    app_config_file = g_strdup (APP_CONFIG_FILE);
+  if (app_config_file &&
+      !parse_app_config (&options.app_config, app_config_file)) {
+    app_config_clear (&options.app_config);
+    goto done;
+  }
+
+  written = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (i = 1; i < argc; i++)
+    check_config (argv[i], &options, &result, written);
+  g_hash_table_unref (written);
+
+  g_print ("%d cameras: %.0f Mpixel/s dewarped, %.0f Mpixel/s batched, "
+      "%.1f MB per set of frames; %u errors, %u warnings\n", argc - 1,
+      result.dewarped_pixels * options.fps / 1e6,
+      result.muxer_pixels * options.fps / 1e6, result.bytes / MB,
+      result.num_errors, result.num_warnings);
+
+  ret = result.num_errors || (strict && result.num_warnings) ? 1 : 0;
+  app_config_clear (&options.app_config);
+done:
+  g_option_context_free (context);
+  g_free (app_config_file);
+  g_free (muxer_size);
+  g_free (source_size);
+  g_free (cache_dir);
+  return ret;
+}
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "track_log.h"
+
+#define TRACK_LOG_BUFFER_SIZE (1 << 20)
+
+/* Frames of one surface of one source. Tracks only miss frames of their own
+ * surface: a batch can lack it, when streammux pushed a partial batch, the
+ * source is reconnecting or, with sharding, the batch came from another
+ * worker. */
+typedef struct _TrackFrameState
+{
+  /* source_id << 32 | surface_index. */
+  guint64 key;
+  /* Frames of the surface seen by the log, and the log batch of the last. */
+  guint64 num_frames;
+  guint64 last_batch;
+} TrackFrameState;
+
+typedef struct _TrackState
+{
+  TrackKey key;
+  /* Last written state. */
+  gfloat left;
+  gfloat top;
+  gfloat width;
+  gfloat height;
+  gfloat confidence;
+  gint class_id;
+  gchar label[OBJECT_RECORD_LABEL_LEN];
+  TrackFrameState *frame;
+  /* Index of the last frame of its surface the track was seen in, counted by
+   * the log since frame numbers restart with every replay loop or shard
+   * worker. */
+  guint64 last_seen;
+  gint last_frame_num;
+  /* An M line was written since the track was last seen. */
+  gboolean missing;
+} TrackState;
+
+TrackLog *
+track_log_new (const TrackLogConfig * config)
+{
+  TrackLog *log;
+  FILE *file = fopen (config->file, "w");
+
+  if (!file) {
+    g_printerr ("Failed to open track log %s\n", config->file);
+    return NULL;
+  }
+  setvbuf (file, NULL, _IOFBF, TRACK_LOG_BUFFER_SIZE);
+
+  log = g_new0 (TrackLog, 1);
+  log->file = file;
+  log->config = *config;
+  /* The config strings stay owned by the AppConfig. */
+  log->config.file = NULL;
+  log->tracks = g_hash_table_new_full (track_key_hash, track_key_equal, NULL,
+      g_free);
+  log->frames = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL,
+      g_free);
+  return log;
+}
+
+static void
+write_track_state (TrackLog * log, gchar type, guint64 batch_num,
+    const TrackState * track)
+{
+  fprintf (log->file,
+      "%c %" G_GUINT64_FORMAT " %u %u %" G_GUINT64_FORMAT
+      " %d %s %.1f %.1f %.1f %.1f %.3f\n", type, batch_num,
+      track->key.source_id, track->key.surface_index, track->key.object_id,
+      track->class_id, track->label, track->left, track->top, track->width,
+      track->height, track->confidence);
+}
+
+static void
+write_miss (TrackLog * log, guint64 batch_num, const TrackState * track)
+{
+  fprintf (log->file, "M %" G_GUINT64_FORMAT " %u %u %" G_GUINT64_FORMAT
+      "\n", batch_num, track->key.source_id, track->key.surface_index,
+      track->key.object_id);
+}
+
+static void
+write_death (TrackLog * log, guint64 batch_num, const TrackState * track)
+{
+  fprintf (log->file, "D %" G_GUINT64_FORMAT " %u %u %" G_GUINT64_FORMAT
+      " %d\n", batch_num, track->key.source_id, track->key.surface_index,
+      track->key.object_id, track->last_frame_num);
+  log->num_deaths++;
+}
+
+static inline gboolean
+track_moved (const TrackLog * log, const TrackState * track,
+    const ObjectRecord * object)
+{
+  gdouble threshold = log->config.position_threshold;
+
+  return fabs (object->left - track->left) > threshold ||
+      fabs (object->top - track->top) > threshold ||
+      fabs (object->left + object->width - track->left - track->width) >
+      threshold ||
+      fabs (object->top + object->height - track->top - track->height) >
+      threshold ||
+      fabs (object->confidence - track->confidence) >
+      log->config.confidence_threshold;
+}
+
+static void
+set_track_state (TrackState * track, const ObjectRecord * object)
+{
+  track->left = object->left;
+  track->top = object->top;
+  track->width = object->width;
+  track->height = object->height;
+  track->confidence = object->confidence;
+}
+
+/* Counts a frame of the surface of record, present in the current batch. */
+static TrackFrameState *
+log_frame (TrackLog * log, const FrameRecord * record)
+{
+  guint64 key = ((guint64) record->source_id << 32) | record->surface_index;
+  TrackFrameState *frame;
+
+  frame = (TrackFrameState *) g_hash_table_lookup (log->frames, &key);
+  if (!frame) {
+    frame = g_new0 (TrackFrameState, 1);
+    frame->key = key;
+    g_hash_table_insert (log->frames, &frame->key, frame);
+  }
+  frame->num_frames++;
+  frame->last_batch = log->num_batches;
+  return frame;
+}
+
+static void
+log_object (TrackLog * log, guint64 batch_num, const FrameRecord * record,
+    TrackFrameState * frame, const ObjectRecord * object)
+{
+  TrackKey key;
+  TrackState *track;
+
+  key.object_id = object->object_id;
+  key.source_id = record->source_id;
+  key.surface_index = record->surface_index;
+
+  track = (TrackState *) g_hash_table_lookup (log->tracks, &key);
+  if (!track) {
+    track = g_new0 (TrackState, 1);
+    track->key = key;
+    track->frame = frame;
+    track->class_id = object->class_id;
+    g_strlcpy (track->label, object->label, sizeof (track->label));
+    set_track_state (track, object);
+    g_hash_table_insert (log->tracks, &track->key, track);
+    write_track_state (log, 'B', batch_num, track);
+    log->num_births++;
+  } else if (track->missing || track_moved (log, track, object)) {
+    set_track_state (track, object);
+    fprintf (log->file, "U %" G_GUINT64_FORMAT " %u %u %" G_GUINT64_FORMAT
+        " %.1f %.1f %.1f %.1f %.3f\n", batch_num, key.source_id,
+        key.surface_index, key.object_id, track->left, track->top,
+        track->width, track->height, track->confidence);
+    log->num_updates++;
+  }
+
+  track->last_seen = frame->num_frames;
+  track->last_frame_num = record->frame_num;
+  track->missing = FALSE;
+}
+
+static void
+expire_tracks (TrackLog * log, guint64 batch_num)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, log->tracks);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    TrackState *track = (TrackState *) value;
+    const TrackFrameState *frame = track->frame;
+
+    /* Not a miss if the batch has no frame of the track's surface. */
+    if (frame->last_batch != log->num_batches)
+      continue;
+    if (frame->num_frames - track->last_seen > log->config.max_missed_batches) {
+      write_death (log, batch_num, track);
+      g_hash_table_iter_remove (&iter);
+    } else if (track->last_seen != frame->num_frames && !track->missing) {
+      write_miss (log, batch_num, track);
+      track->missing = TRUE;
+      log->num_misses++;
+    }
+  }
+}
+
+static void
+write_keyframe (TrackLog * log, guint64 batch_num)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  fprintf (log->file, "K %" G_GUINT64_FORMAT "\n", batch_num);
+  g_hash_table_iter_init (&iter, log->tracks);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    TrackState *track = (TrackState *) value;
+
+    write_track_state (log, 'S', batch_num, track);
+    if (track->missing)
+      write_miss (log, batch_num, track);
+  }
+  log->num_keyframes++;
+}
+
+gboolean
+track_log_write_batch (TrackLog * log, const FrameRecordBatch * batch)
+{
+  guint i, j;
+
+  for (i = 0; i < batch->num_frames; i++) {
+    const FrameRecord *record = batch->frames[i];
+    TrackFrameState *frame = log_frame (log, record);
+
+    for (j = 0; j < record->num_objects; j++) {
+      const ObjectRecord *object = &record->objects[j];
+
+      log->num_objects++;
+      /* Without nvtracker there is no identity to follow. */
+      if (object->object_id == UNTRACKED_OBJECT_ID) {
+        log->num_untracked++;
+        continue;
+      }
+      log_object (log, batch->batch_num, record, frame, object);
+    }
+  }
+
+  expire_tracks (log, batch->batch_num);
+  if (log->num_batches % log->config.keyframe_interval == 0)
+    write_keyframe (log, batch->batch_num);
+  log->num_batches++;
+  log->last_batch_num = batch->batch_num;
+
+  return !ferror (log->file);
+}
+
+void
+track_log_print_stats (TrackLog * log)
+{
+  guint64 records = log->num_births + log->num_updates + log->num_misses +
+      log->num_deaths;
+
+  g_print ("Track log: %" G_GUINT64_FORMAT " objects in %" G_GUINT64_FORMAT
+      " batches, %" G_GUINT64_FORMAT " births %" G_GUINT64_FORMAT
+      " updates %" G_GUINT64_FORMAT " misses %" G_GUINT64_FORMAT " deaths %"
+      G_GUINT64_FORMAT " keyframes, %.1f objects per record\n",
+      log->num_objects, log->num_batches, log->num_births, log->num_updates,
+      log->num_misses, log->num_deaths, log->num_keyframes,
+      records ? (gdouble) (log->num_objects - log->num_untracked) / records :
+      0.0);
+  if (log->num_untracked)
+    g_print ("Track log: %" G_GUINT64_FORMAT
+        " untracked objects skipped, enable tracking to log them\n",
+        log->num_untracked);
+}
+
+void
+track_log_free (TrackLog * log)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  if (!log)
+    return;
+
+  g_hash_table_iter_init (&iter, log->tracks);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    TrackState *track = (TrackState *) value;
+    write_death (log, log->last_batch_num, track);
+  }
+
+  g_hash_table_destroy (log->tracks);
+  g_hash_table_destroy (log->frames);
+  fclose (log->file);
+  g_free (log);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2019-2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __TRACK_LOG_H__
+#define __TRACK_LOG_H__
+
+#include <glib.h>
+#include <stdio.h>
+
+#include "app_config.h"
+#include "frame_record.h"
+
+/* Delta encoded log of the tracker output. Instead of every object of every
+ * frame it writes one line per track event:
+ *
+ *   B <batch> <source> <surface> <id> <class> <label> <left> <top> <width> <height> <confidence>
+ *   U <batch> <source> <surface> <id> <left> <top> <width> <height> <confidence>
+ *   M <batch> <source> <surface> <id>
+ *   D <batch> <source> <surface> <id> <last frame_num>
+ *   K <batch>
+ *   S <batch> <source> <surface> <id> <class> <label> <left> <top> <width> <height> <confidence>
+ *
+ * B is a new track, U an update once the track moved beyond the configured
+ * thresholds, M a track missing from a frame of its source and surface and D
+ * a track that was missing from max-missed-batches such frames. Batches
+ * without a frame of the track's surface, partial or from another shard
+ * worker, do not count. A track is present with the state of its last B, U
+ * or S line until an M or D line, so every frame can be reconstructed with
+ * an error bounded by the thresholds. A missing track that comes back always
+ * gets a U line. Every keyframe-interval batches a K line is followed by an
+ * S line per live track, and an M line after it for a track missing from
+ * its last frame, so a reader can start at any K line. */
+
+typedef struct _TrackLog
+{
+  FILE *file;
+  GHashTable *tracks;
+  /* TrackFrameState per source and surface. */
+  GHashTable *frames;
+  TrackLogConfig config;
+  guint64 num_batches;
+  guint64 last_batch_num;
+  /* Statistics printed at exit. */
+  guint64 num_objects;
+  guint64 num_untracked;
+  guint64 num_births;
+  guint64 num_updates;
+  guint64 num_misses;
+  guint64 num_deaths;
+  guint64 num_keyframes;
+} TrackLog;
+
+TrackLog *track_log_new (const TrackLogConfig * config);
+
+gboolean track_log_write_batch (TrackLog * log,
+    const FrameRecordBatch * batch);
+
+void track_log_print_stats (TrackLog * log);
+
+/* Writes the death of every live track before closing the file. */
+void track_log_free (TrackLog * log);
+
+#endif